@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Lex.h"
+#include "LexSession.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace CommonLexer
+{
+	class Lexer;
+	class ISource;
+
+	struct BatchLexFileStats
+	{
+	public:
+		[[nodiscard]] double getBytesPerSecond() const;
+
+	public:
+		std::size_t              m_Bytes  = 0;
+		std::size_t              m_Worker = 0;
+		std::chrono::nanoseconds m_Duration { 0 };
+	};
+
+	struct BatchLexStats
+	{
+	public:
+		// Throughput over wall clock time, i.e. what the whole batch achieved
+		[[nodiscard]] double getBytesPerSecond() const;
+		[[nodiscard]] double getFilesPerSecond() const;
+
+	public:
+		std::size_t              m_Files   = 0;
+		std::size_t              m_Bytes   = 0;
+		std::size_t              m_Threads = 0;
+		std::chrono::nanoseconds m_WallTime { 0 };
+		// Sum of the per file durations, compare against m_WallTime * m_Threads to see how busy the workers were
+		std::chrono::nanoseconds m_LexTime { 0 };
+	};
+
+	struct BatchLexResult
+	{
+	public:
+		// Sources opened by the batch, kept alive for as long as the lexes refer to them
+		std::vector<std::unique_ptr<ISource>> m_Sources;
+
+		std::vector<Lex>               m_Lexes;
+		std::vector<BatchLexFileStats> m_FileStats;
+		BatchLexStats                  m_Stats;
+	};
+
+	// Lexes many sources in parallel against one shared lexer, the results are in the same order as the inputs.
+	// The lexer must not be modified while a batch is running, one that is not finalized yet is finalized by the first lex.
+	class BatchLexer
+	{
+	public:
+		// A thread count of 0 uses one worker per hardware thread
+		explicit BatchLexer(const Lexer& lexer, std::size_t threadCount = 0);
+
+		BatchLexResult lexSources(std::span<ISource* const> sources);
+		BatchLexResult lexFiles(std::span<const std::filesystem::path> filepaths, MappedFileFlags flags = EMappedFileFlags::Default);
+
+		// Lexes a single source in parallel by splitting it at the points found with the lexer's SplitOptions.
+		// The result is identical to a serial lex, when a split point turns out to be wrong or the lex is incomplete the source is lexed serially.
+		Lex lexSplit(ISource* source);
+		Lex lexSplit(ISource* source, SourceSpan span);
+
+		[[nodiscard]] auto getLexer() const { return m_Lexer; }
+		[[nodiscard]] auto getThreadCount() const { return m_Pool.getThreadCount(); }
+
+	private:
+		void lexBatch(BatchLexResult& result, std::span<ISource* const> sources, std::span<const std::filesystem::path> filepaths, MappedFileFlags flags);
+
+	private:
+		const Lexer* m_Lexer;
+
+		ThreadPool              m_Pool;
+		std::vector<LexSession> m_Sessions;
+		LexSession              m_SerialSession;
+	};
+} // namespace CommonLexer
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+
+#define BUILD_CONFIG_UNKNOWN 0
+#define BUILD_CONFIG_DEBUG   1
+#define BUILD_CONFIG_RELEASE 2
+#define BUILD_CONFIG_DIST    3
+
+#define BUILD_SYSTEM_UNKNOWN 0
+#define BUILD_SYSTEM_WINDOWS 1
+#define BUILD_SYSTEM_MACOSX  2
+#define BUILD_SYSTEM_LINUX   3
+
+#define BUILD_TOOLSET_UNKNOWN 0
+#define BUILD_TOOLSET_MSVC    1
+#define BUILD_TOOLSET_CLANG   2
+#define BUILD_TOOLSET_GCC     3
+
+#define BUILD_PLATFORM_UNKNOWN 0
+#define BUILD_PLATFORM_X86     1
+#define BUILD_PLATFORM_AMD64   2
+#define BUILD_PLATFORM_ARM     3
+#define BUILD_PLATFORM_ARM64   4
+
+#ifndef BUILD_CONFIG
+	#define BUILD_CONFIG BUILD_CONFIG_UNKNOWN
+#endif
+
+#ifndef BUILD_SYSTEM
+	#define BUILD_SYSTEM BUILD_SYSTEM_UNKNOWN
+#endif
+
+#ifndef BUILD_TOOLSET
+	#define BUILD_TOOLSET BUILD_TOOLSET_UNKNOWN
+#endif
+
+#ifndef BUILD_PLATFORM
+	#define BUILD_PLATFORM BUILD_PLATFORM_UNKNOWN
+#endif
+
+#define BUILD_IS_CONFIG_DEBUG (BUILD_CONFIG == BUILD_CONFIG_DEBUG)
+#define BUILD_IS_CONFIG_DIST  (BUILD_CONFIG == BUILD_CONFIG_DIST)
+
+#define BUILD_IS_SYSTEM_WINDOWS (BUILD_SYSTEM == BUILD_SYSTEM_WINDOWS)
+#define BUILD_IS_SYSTEM_MACOSX  (BUILD_SYSTEM == BUILD_SYSTEM_MACOSX)
+#define BUILD_IS_SYSTEM_LINUX   (BUILD_SYSTEM == BUILD_SYSTEM_LINUX)
+#define BUILD_IS_SYSTEM_UNIX    (BUILD_IS_SYSTEM_MACOSX || BUILD_IS_SYSTEM_LINUX)
+
+#define BUILD_IS_TOOLSET_MSVC (BUILD_TOOLSET == BUILD_TOOLSET_MSVC)
+
+#define BUILD_IS_PLATFORM_X86   (BUILD_PLATFORM == BUILD_PLATFORM_X86)
+#define BUILD_IS_PLATFORM_AMD64 (BUILD_PLATFORM == BUILD_PLATFORM_AMD64)
+#define BUILD_IS_PLATFORM_ARM   (BUILD_PLATFORM == BUILD_PLATFORM_ARM)
+#define BUILD_IS_PLATFORM_ARM64 (BUILD_PLATFORM == BUILD_PLATFORM_ARM64)
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+
+#include <bitset>
+#include <string_view>
+#include <vector>
+
+namespace CommonLexer
+{
+	class Lexer;
+	class IMatcher;
+
+	// Bytes a match can start with, a matcher that isn't nullable fails at any other byte after reading only that byte
+	struct FirstSet
+	{
+	public:
+		static FirstSet Any();
+		static FirstSet Regex(std::string_view pattern);
+
+		[[nodiscard]] bool isAny() const { return m_Nullable && m_Bytes.all(); }
+		// Whether the matcher may do anything but fail at the byte
+		[[nodiscard]] bool accepts(std::uint8_t byte) const { return m_Nullable || m_Bytes.test(byte); }
+
+		FirstSet& operator|=(const FirstSet& other)
+		{
+			m_Bytes |= other.m_Bytes;
+			m_Nullable = m_Nullable || other.m_Nullable;
+			return *this;
+		}
+		bool operator==(const FirstSet& other) const { return m_Bytes == other.m_Bytes && m_Nullable == other.m_Nullable; }
+
+	public:
+		std::bitset<256> m_Bytes;
+		// Whether the matcher may succeed or skip without consuming anything
+		bool m_Nullable = false;
+	};
+
+	// FIRST sets of the rules of a finalized lexer, references take the set of the rule they reach.
+	class FirstSetAnalysis
+	{
+	public:
+		explicit FirstSetAnalysis(const Lexer& lexer);
+
+		[[nodiscard]] const FirstSet& getRuleSet(std::uint32_t ruleID) const { return m_RuleSets[ruleID]; }
+		[[nodiscard]] FirstSet        getMatcherSet(const IMatcher& matcher) const;
+
+	private:
+		std::vector<FirstSet> m_RuleSets;
+	};
+} // namespace CommonLexer
\ No newline at end of file
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "SourceSpan.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace CommonLexer
+{
+	struct Node;
+	class FlatTree;
+
+	// Handle to a node of a FlatTree, only valid as long as the tree is
+	class FlatNode
+	{
+	public:
+		class ChildIterator
+		{
+		public:
+			ChildIterator(const FlatTree* tree, std::uint32_t index) : m_Tree(tree), m_Index(index) {}
+
+			[[nodiscard]] FlatNode operator*() const { return { m_Tree, m_Index }; }
+
+			ChildIterator& operator++();
+
+			[[nodiscard]] bool operator==(const ChildIterator& other) const { return m_Index == other.m_Index; }
+			[[nodiscard]] bool operator!=(const ChildIterator& other) const { return m_Index != other.m_Index; }
+
+		private:
+			const FlatTree* m_Tree;
+			std::uint32_t   m_Index;
+		};
+
+		struct ChildRange
+		{
+		public:
+			[[nodiscard]] auto begin() const { return m_Begin; }
+			[[nodiscard]] auto end() const { return m_End; }
+
+		public:
+			ChildIterator m_Begin;
+			ChildIterator m_End;
+		};
+
+	public:
+		FlatNode(const FlatTree* tree, std::uint32_t index) : m_Tree(tree), m_Index(index) {}
+
+		[[nodiscard]] auto          getIndex() const { return m_Index; }
+		[[nodiscard]] std::uint32_t getRule() const;
+		[[nodiscard]] SourceSpan    getSpan() const;
+		[[nodiscard]] bool          hasChildren() const;
+		[[nodiscard]] ChildRange    getChildren() const;
+		// Counting and indexing children walks the siblings, iterate getChildren() instead where possible
+		[[nodiscard]] std::size_t             getChildCount() const;
+		[[nodiscard]] std::optional<FlatNode> getChild(std::size_t index) const;
+
+	private:
+		const FlatTree* m_Tree;
+		std::uint32_t   m_Index;
+	};
+
+	// Stores a node tree contiguously in preorder with one array per field, using 32 bit offsets.
+	// The children of a node directly follow it, the subtree of node i covers the indices [i, getSubtreeEnd(i)).
+	class FlatTree
+	{
+	public:
+		static constexpr std::size_t FieldCount = 4;
+
+	public:
+		FlatTree() = default;
+		// Views an arena of FieldCount * nodeCount values laid out like getArena(), the arena has to outlive the tree
+		explicit FlatTree(std::span<const std::uint32_t> arena);
+
+		// Flattens the tree under root, fails when the tree has more nodes or spans further than 32 bit offsets can hold
+		[[nodiscard]] bool build(const Node& root);
+		// Copies the node at index and its subtree into node, the reverse of build
+		void               toNode(Node& node, std::uint32_t index = 0) const;
+		void               clear();
+		// Checks that the subtree ends nest like a preorder tree and the spans are ordered, arenas viewed from outside have to pass this before they are walked
+		[[nodiscard]] bool isValid() const;
+
+		[[nodiscard]] std::size_t   getNodeCount() const { return m_NodeCount; }
+		[[nodiscard]] bool          empty() const { return m_NodeCount == 0; }
+		[[nodiscard]] FlatNode      getRoot() const { return { this, 0 }; }
+		[[nodiscard]] FlatNode      getNode(std::uint32_t index) const { return { this, index }; }
+		[[nodiscard]] std::uint32_t getRule(std::uint32_t index) const { return getRules()[index]; }
+		[[nodiscard]] SourceSpan    getSpan(std::uint32_t index) const { return { getStarts()[index], getEnds()[index] }; }
+		[[nodiscard]] std::uint32_t getSubtreeEnd(std::uint32_t index) const { return getSubtreeEnds()[index]; }
+
+		[[nodiscard]] std::span<const std::uint32_t> getRules() const { return field(0); }
+		[[nodiscard]] std::span<const std::uint32_t> getStarts() const { return field(1); }
+		[[nodiscard]] std::span<const std::uint32_t> getEnds() const { return field(2); }
+		[[nodiscard]] std::span<const std::uint32_t> getSubtreeEnds() const { return field(3); }
+		// Rules, starts, ends and subtree ends, each getNodeCount() values long
+		[[nodiscard]] std::span<const std::uint32_t> getArena() const { return { data(), m_NodeCount * FieldCount }; }
+		[[nodiscard]] std::size_t                    getMemoryUsage() const { return m_Arena.capacity() * sizeof(std::uint32_t); }
+
+	private:
+		[[nodiscard]] const std::uint32_t*           data() const { return m_External ? m_External : m_Arena.data(); }
+		[[nodiscard]] std::span<const std::uint32_t> field(std::size_t field) const { return { data() + field * m_NodeCount, m_NodeCount }; }
+
+	private:
+		std::vector<std::uint32_t> m_Arena;
+		const std::uint32_t*       m_External  = nullptr;
+		std::size_t                m_NodeCount = 0;
+	};
+} // namespace CommonLexer
\ No newline at end of file
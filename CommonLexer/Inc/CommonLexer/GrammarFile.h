@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+
+#include <filesystem>
+#include <span>
+#include <vector>
+
+namespace CommonLexer
+{
+	class Lexer;
+
+	static constexpr std::uint32_t GrammarFileMagic   = 0x52474C43; // "CLGR"
+	static constexpr std::uint32_t GrammarFileVersion = 2;
+
+	// A grammar file is the magic and version as little endian values followed by the canonical form from Lexer::writeGrammar.
+	// Loading one skips building the grammar in code, and regexes are only compiled once they are first matched.
+	bool WriteGrammar(const Lexer& lexer, std::vector<char>& data);
+	bool WriteGrammarFile(const Lexer& lexer, const std::filesystem::path& filepath);
+	// Replaces the lexer's rules and options, returns false when the data is not a grammar file of this version or fails to finalize
+	bool ReadGrammar(Lexer& lexer, std::span<const char> data);
+	bool ReadGrammarFile(Lexer& lexer, const std::filesystem::path& filepath);
+} // namespace CommonLexer
\ No newline at end of file
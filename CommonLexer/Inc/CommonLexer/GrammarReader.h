@@ -0,0 +1,38 @@
+#pragma once
+
+#include "GrammarWriter.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <span>
+#include <string>
+
+namespace CommonLexer
+{
+	// Reads the canonical binary form written by GrammarWriter.
+	// Reading past the end or an invalid value marks the reader as invalid and returns zero values, so callers check isValid() once at the end.
+	class GrammarReader
+	{
+	public:
+		explicit GrammarReader(std::span<const char> data) : m_Data(data), m_Offset(0), m_Valid(true) {}
+
+		std::uint8_t  readU8();
+		std::uint32_t readU32();
+		std::uint64_t readU64();
+		bool          readBool();
+		EMatcherKind  readKind();
+		std::string   readString();
+
+		void fail() { m_Valid = false; }
+
+		[[nodiscard]] auto isValid() const { return m_Valid; }
+		[[nodiscard]] auto isAtEnd() const { return m_Offset == m_Data.size(); }
+		[[nodiscard]] auto getRemaining() const { return m_Data.size() - m_Offset; }
+
+	private:
+		std::span<const char> m_Data;
+		std::size_t           m_Offset;
+		bool                  m_Valid;
+	};
+} // namespace CommonLexer
\ No newline at end of file
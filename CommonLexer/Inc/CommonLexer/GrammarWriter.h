@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Matcher.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace CommonLexer
+{
+	// Builds the canonical binary form of a grammar, values are little endian and strings are length prefixed.
+	// Two lexers with the same canonical form lex every source the same way.
+	class GrammarWriter
+	{
+	public:
+		void writeU8(std::uint8_t value) { m_Data.push_back(static_cast<char>(value)); }
+		void writeU32(std::uint32_t value);
+		void writeU64(std::uint64_t value);
+		void writeBool(bool value) { writeU8(value ? 1 : 0); }
+		void writeKind(EMatcherKind kind) { writeU8(static_cast<std::uint8_t>(kind)); }
+		void writeString(std::string_view value);
+
+		[[nodiscard]] auto& getData() const { return m_Data; }
+		[[nodiscard]] auto  takeData() && { return std::move(m_Data); }
+
+	private:
+		std::vector<char> m_Data;
+	};
+} // namespace CommonLexer
\ No newline at end of file
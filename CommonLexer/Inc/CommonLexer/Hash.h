@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <string_view>
+
+namespace CommonLexer
+{
+	// Fast non cryptographic 64 bit hash, input is consumed in 8 byte words and may be split over any number of updates
+	class Hasher
+	{
+	public:
+		explicit Hasher(std::uint64_t seed = 0) : m_State(seed ^ 0x9E3779B97F4A7C15ULL), m_Length(0), m_Word(0), m_WordBytes(0) {}
+
+		void update(const void* data, std::size_t size);
+		void update(std::string_view data) { update(data.data(), data.size()); }
+
+		[[nodiscard]] std::uint64_t finish() const;
+
+	private:
+		void mix(std::uint64_t word);
+
+	private:
+		std::uint64_t m_State;
+		std::uint64_t m_Length;
+		std::uint64_t m_Word;
+		std::size_t   m_WordBytes;
+	};
+
+	[[nodiscard]] std::uint64_t Hash(std::string_view data, std::uint64_t seed = 0);
+} // namespace CommonLexer
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "FlatTree.h"
 #include "Message.h"
 #include "Node.h"
 
@@ -11,12 +12,39 @@ namespace CommonLexer
 	class Lexer;
 	class ISource;
 
+	struct NodeLocation
+	{
+	public:
+		SourceLocation m_Start;
+		SourceLocation m_End;
+	};
+
+	// A top level item matched through the lexer's split rule, kept so LexSession::relex can reuse it
+	struct LexItem
+	{
+	public:
+		SourceSpan  m_Span { 0, 0 };
+		SourcePoint m_ReadEnd;
+
+		std::size_t m_FirstChild = 0;
+		std::size_t m_ChildCount = 0;
+
+		// Shifted along with the item when it is reused, so they never refer to an older source
+		std::vector<Message> m_Messages;
+	};
+
 	struct Lex
 	{
 	public:
-		Lex(Lexer& lexer, ISource* source) : m_Lexer(&lexer), m_Source(source), m_Root(*this) {}
+		Lex(const Lexer& lexer, ISource* source) : m_Lexer(&lexer), m_Source(source), m_Root(*this) {}
+		Lex(Lex&& move) noexcept;
+		Lex& operator=(Lex&& move) noexcept;
+
+		Lex(const Lex&) = delete;
+		Lex& operator=(const Lex&) = delete;
 
 		void setMessages(std::vector<Message>&& messages) { m_Messages = std::move(messages); }
+		void setItems(std::vector<LexItem>&& items) { m_Items = std::move(items); }
 
 		[[nodiscard]] auto  getLexer() const { return m_Lexer; }
 		[[nodiscard]] auto  getSource() const { return m_Source; }
@@ -24,12 +52,20 @@ namespace CommonLexer
 		[[nodiscard]] auto& getRoot() const { return m_Root; }
 		[[nodiscard]] auto& getMessages() { return m_Messages; }
 		[[nodiscard]] auto& getMessages() const { return m_Messages; }
+		[[nodiscard]] auto& getItems() { return m_Items; }
+		[[nodiscard]] auto& getItems() const { return m_Items; }
+
+		// Resolves the start and end locations of every node in preorder, starting with the root
+		[[nodiscard]] std::vector<NodeLocation> resolveNodeLocations(bool utf8Columns = false) const;
+		// Copies the node tree into preorder arrays, the result is empty when the tree does not fit 32 bit offsets
+		[[nodiscard]] FlatTree flatten() const;
 
 	private:
-		Lexer*   m_Lexer;
-		ISource* m_Source;
-		Node     m_Root;
+		const Lexer* m_Lexer;
+		ISource*     m_Source;
+		Node         m_Root;
 
 		std::vector<Message> m_Messages;
+		std::vector<LexItem> m_Items;
 	};
 } // namespace CommonLexer
\ No newline at end of file
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "Lex.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace CommonLexer
+{
+	class Lexer;
+	class ISource;
+
+	struct LexCacheOptions
+	{
+	public:
+		// Upper bound for the serialized lexes kept in memory, the least recently used lexes are evicted first
+		std::size_t m_MemoryLimit = 64 << 20;
+		// Lexes are also stored as lex files in this directory when it is set, so they survive the process.
+		// Files that do not match their key or checksum are treated as misses and overwritten.
+		std::filesystem::path m_Directory;
+	};
+
+	struct LexCacheStats
+	{
+	public:
+		[[nodiscard]] std::size_t getHits() const { return m_MemoryHits + m_DiskHits; }
+
+	public:
+		std::size_t m_MemoryHits = 0;
+		std::size_t m_DiskHits   = 0;
+		std::size_t m_Misses     = 0;
+		std::size_t m_Evictions  = 0;
+		std::size_t m_Entries    = 0;
+		std::size_t m_Memory     = 0;
+	};
+
+	struct LexCacheKey
+	{
+	public:
+		[[nodiscard]] bool operator==(const LexCacheKey& other) const = default;
+
+	public:
+		std::uint64_t m_Grammar = 0;
+		std::uint64_t m_Source  = 0;
+		std::uint64_t m_Size    = 0;
+	};
+
+	static constexpr std::uint32_t LexCacheFileMagic   = 0x43584C43; // "CLXC"
+	static constexpr std::uint32_t LexCacheFileVersion = 1;
+
+	// A cache file is this header followed by a lex file written by WriteLex, the checksum is the Hash of that lex file
+	struct LexCacheFileHeader
+	{
+	public:
+		std::uint32_t m_Magic;
+		std::uint32_t m_Version;
+		LexCacheKey   m_Key;
+		std::uint64_t m_PayloadSize;
+		std::uint64_t m_Checksum;
+	};
+
+	// Caches lexes by the hash of the lexer's canonical grammar and the hash of the source bytes, so lexing an unchanged source skips matching.
+	// The lexer must not change while the cache is used. Lexers with rules that can't be written, like callback rules, are lexed without caching.
+	// A cache can be shared between threads.
+	class LexCache
+	{
+	public:
+		explicit LexCache(const Lexer& lexer, LexCacheOptions options = {});
+
+		Lex  lexSource(ISource* source);
+		void clear();
+
+		[[nodiscard]] LexCacheKey   getKey(ISource* source) const;
+		[[nodiscard]] auto          isEnabled() const { return m_Enabled; }
+		[[nodiscard]] auto          getGrammarHash() const { return m_GrammarHash; }
+		[[nodiscard]] auto&         getOptions() const { return m_Options; }
+		[[nodiscard]] LexCacheStats getStats() const;
+
+	private:
+		using Blob = std::shared_ptr<const std::vector<char>>;
+
+		struct Entry
+		{
+		public:
+			LexCacheKey m_Key;
+			Blob        m_Data;
+		};
+
+		struct KeyHash
+		{
+		public:
+			[[nodiscard]] std::size_t operator()(const LexCacheKey& key) const { return static_cast<std::size_t>(key.m_Source ^ (key.m_Grammar * 0x9E3779B97F4A7C15ULL) ^ key.m_Size); }
+		};
+
+	private:
+		[[nodiscard]] Blob findMemory(const LexCacheKey& key);
+		void               insertMemory(const LexCacheKey& key, Blob data);
+		[[nodiscard]] Blob loadDisk(const LexCacheKey& key) const;
+		void               storeDisk(const LexCacheKey& key, const std::vector<char>& data) const;
+		[[nodiscard]] bool loadLex(Lex& lex, const std::vector<char>& data) const;
+
+		[[nodiscard]] std::filesystem::path getPath(const LexCacheKey& key) const;
+
+	private:
+		const Lexer*    m_Lexer;
+		LexCacheOptions m_Options;
+		bool            m_Enabled;
+		std::uint64_t   m_GrammarHash;
+
+		mutable std::mutex                                                   m_Mutex;
+		std::list<Entry>                                                     m_Entries;
+		std::unordered_map<LexCacheKey, std::list<Entry>::iterator, KeyHash> m_Index;
+		LexCacheStats                                                        m_Stats;
+	};
+} // namespace CommonLexer
\ No newline at end of file
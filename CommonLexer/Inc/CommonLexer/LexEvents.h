@@ -0,0 +1,25 @@
+#pragma once
+
+#include "NodeStack.h"
+#include "SourceSpan.h"
+
+#include <cstdint>
+
+#include <span>
+
+namespace CommonLexer
+{
+	// Receives the nodes of a lex as they are committed, in preorder.
+	// Nodes with children are reported through enterRule and exitRule around their children, nodes without children through token.
+	class ILexEventSink
+	{
+	public:
+		virtual ~ILexEventSink() = default;
+
+		virtual void enterRule(std::uint32_t rule, SourcePoint start) = 0;
+		virtual void exitRule(std::uint32_t rule, SourceSpan span)    = 0;
+		virtual void token(std::uint32_t rule, SourceSpan span)       = 0;
+	};
+
+	void EmitLexEvents(std::span<const StackNode> nodes, ILexEventSink& sink);
+} // namespace CommonLexer
\ No newline at end of file
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "FlatTree.h"
+#include "MappedFile.h"
+#include "Message.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace CommonLexer
+{
+	struct Lex;
+	class Lexer;
+
+	static constexpr std::uint32_t LexFileMagic   = 0x58454C43; // "CLEX"
+	static constexpr std::uint32_t LexFileVersion = 2;
+
+	// A lex file is a header followed by sections at 8 byte aligned offsets, all values use the byte order of the writer.
+	// The node section is a FlatTree arena, so a mapped file is viewed without parsing it.
+	struct LexFileHeader
+	{
+	public:
+		std::uint32_t m_Magic;
+		std::uint32_t m_Version;
+		std::uint32_t m_NodeCount;
+		std::uint32_t m_RuleCount;
+		std::uint32_t m_MessageCount;
+		std::uint32_t m_Reserved;
+		std::uint64_t m_SourceSize;
+		std::uint64_t m_NodesOffset;
+		std::uint64_t m_RulesOffset;
+		std::uint64_t m_MessagesOffset;
+		std::uint64_t m_StringsOffset;
+		std::uint64_t m_StringsSize;
+	};
+
+	// Rule names are indexed by rule ID and point into the string section
+	struct LexFileRule
+	{
+	public:
+		std::uint32_t m_NameOffset;
+		std::uint32_t m_NameLength;
+	};
+
+	struct LexFileMessage
+	{
+	public:
+		std::uint64_t m_Point;
+		std::uint64_t m_SpanStart;
+		std::uint64_t m_SpanEnd;
+		std::uint64_t m_ExpectedCount;
+		std::uint64_t m_GotCount;
+		std::uint32_t m_RuleID;
+		// Custom messages store their text, other kinds store the expected text
+		std::uint32_t m_TextOffset;
+		std::uint32_t m_TextLength;
+		// Where the expected text lies within the writer's lexer, InvalidLiteral when the message owned it
+		std::uint32_t m_Literal;
+		std::uint32_t m_LiteralOffset;
+		std::uint8_t  m_Kind;
+		std::uint8_t  m_Severity;
+		std::uint8_t  m_GotEOF;
+		char          m_Got;
+	};
+
+	// Serializes the nodes, the lexer's rule names and the messages of lex into data.
+	// Returns false when the node, rule or message counts or the strings do not fit 32 bits.
+	[[nodiscard]] bool WriteLex(const Lex& lex, std::vector<char>& data);
+	[[nodiscard]] bool WriteLexFile(const Lex& lex, const std::filesystem::path& filepath);
+
+	// Read only view of a serialized lex, opening validates every record once so the accessors can trust the data.
+	// Nodes, rule names and the expected text of messages point directly into the viewed data.
+	class LexView
+	{
+	public:
+		LexView() = default;
+
+		LexView(LexView&& move) noexcept;
+		LexView& operator=(LexView&& move) noexcept;
+
+		LexView(const LexView&) = delete;
+		LexView& operator=(const LexView&) = delete;
+
+		// Accessors of a view that is not open return 0, empty names and no messages.
+		// Maps the file and views it, the mapping lives as long as the view
+		bool open(const std::filesystem::path& filepath);
+		// Views data written by WriteLex, data has to be 8 byte aligned and outlive the view.
+		// Fails when any section, string, message or node is out of bounds.
+		bool openMemory(std::span<const char> data);
+		void close();
+
+		[[nodiscard]] bool                   isOpen() const { return m_Header != nullptr; }
+		[[nodiscard]] auto&                  getTree() const { return m_Tree; }
+		[[nodiscard]] std::size_t            getSourceSize() const { return m_Header ? m_Header->m_SourceSize : 0; }
+		[[nodiscard]] std::size_t            getRuleCount() const { return m_Header ? m_Header->m_RuleCount : 0; }
+		[[nodiscard]] std::string_view       getRuleName(std::uint32_t ruleID) const;
+		[[nodiscard]] std::size_t            getMessageCount() const { return m_Header ? m_Header->m_MessageCount : 0; }
+		// With the lexer the lex was written with the expected text is borrowed from its literals instead, so the message outlives the view.
+		// Fails when the index is out of range or the lexer does not have the literal.
+		[[nodiscard]] std::optional<Message> getMessage(std::size_t index, const Lexer* lexer = nullptr) const;
+
+	private:
+		// Offsets are validated when opening, so this only indexes
+		[[nodiscard]] std::string_view getString(std::uint32_t offset, std::uint32_t length) const { return { m_Strings + offset, length }; }
+
+	private:
+		MappedFile m_File;
+
+		const LexFileHeader*  m_Header   = nullptr;
+		const LexFileRule*    m_Rules    = nullptr;
+		const LexFileMessage* m_Messages = nullptr;
+		const char*           m_Strings  = nullptr;
+		FlatTree              m_Tree;
+	};
+} // namespace CommonLexer
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Lex.h"
+#include "Memo.h"
+#include "NodeStack.h"
+#include "TokenStream.h"
+
+#include <cstddef>
+
+#include <span>
+
+namespace CommonLexer
+{
+	class Lexer;
+	class ISource;
+	class ILexEventSink;
+
+	// Replaces m_OldLength characters at m_Start with m_NewLength characters, m_Start is an offset into the text before any of the edits
+	struct TextEdit
+	{
+	public:
+		std::size_t m_Start;
+		std::size_t m_OldLength;
+		std::size_t m_NewLength;
+	};
+
+	// Holds all mutable state of a lex, the lexer is only read so any number of sessions can lex against one lexer concurrently.
+	// A session itself is not thread safe, use one session per thread and reuse it to keep the memo table allocations.
+	class LexSession
+	{
+	public:
+		explicit LexSession(const Lexer& lexer);
+
+		Lex lexSource(ISource* source);
+		Lex lexSource(ISource* source, SourceSpan span);
+		// Lexes like lexSource but writes the nodes as a flat list of tokens without building a tree, tokens is cleared first and can be reused between lexes
+		void lexTokens(ISource* source, TokenStream& tokens, ETokenFilter filter = ETokenFilter::Leaves);
+		void lexTokens(ISource* source, SourceSpan span, TokenStream& tokens, ETokenFilter filter = ETokenFilter::Leaves);
+		// Lexes like lexSource but reports the nodes to sink instead of building a tree and returns the messages.
+		// Each iteration of a repetition that nothing can roll back anymore, like the top level repetition of a file, is reported as soon as it matched and then dropped.
+		// Memory only stays bounded with EErrorReporting::FarthestFailure, accumulated messages are kept until the lex ends since they are only reported when it is incomplete.
+		std::vector<Message> lexEvents(ISource* source, ILexEventSink& sink);
+		std::vector<Message> lexEvents(ISource* source, SourceSpan span, ILexEventSink& sink);
+		// Lexes the split items from start up to end into the root of lex, the items still see all of span like in a serial lex of span.
+		// Returns false when the items do not line up with end, messages are not kept since a failed split is lexed serially.
+		bool lexChunk(Lex& lex, ISource* source, SourceSpan span, SourcePoint start, SourcePoint end);
+		// Lexes like lexSource and returns every or match where the first and the longest matching alternative differ, ordered by point.
+		// An empty result on a corpus means EChoice::First lexes it like EChoice::Longest. Alternatives are counted after Lexer::optimize spliced nested ors.
+		std::vector<ChoiceDivergence> findChoiceDivergences(ISource* source);
+		std::vector<ChoiceDivergence> findChoiceDivergences(ISource* source, SourceSpan span);
+
+		// Lexes the whole source item by item through the lexer's split rule and keeps the items, so the result can be passed to relex.
+		Lex lexIncremental(ISource* source);
+		// Lexes source, the text of previous after applying the non overlapping edits, and only rematches the split items an edit can affect.
+		// Items are reused when the edits lie past everything they looked at, or when rematching reaches an item start behind the last edit.
+		// Reused nodes and messages are moved out of previous and shifted, messages borrow their text from the lexer so previous and its source can go away once this returns.
+		// Falls back to lexSource when the lexer has no split rule.
+		Lex relex(Lex&& previous, ISource* source, std::span<const TextEdit> edits);
+
+		[[nodiscard]] auto  getLexer() const { return m_Lexer; }
+		[[nodiscard]] auto& getMemoStats() const { return m_Memo.getStats(); }
+
+	private:
+		// Matches the main rule over span onto m_Nodes, returns false when nothing was matched
+		bool        matchSource(Lex* lex, ISource* source, SourceSpan span, std::vector<Message>& messages, ILexEventSink* sink = nullptr, std::vector<ChoiceDivergence>* divergences = nullptr);
+		MatchResult matchItem(MatcherState& state, const IRule* rule, Lex& lex, SourceSpan span, LexItem& item);
+
+	private:
+		const Lexer* m_Lexer;
+
+		MemoTable   m_Memo;
+		PrefixCache m_Prefixes;
+		NodeStack   m_Nodes;
+	};
+} // namespace CommonLexer
\ No newline at end of file
@@ -1,43 +1,123 @@
 #pragma once
 
 #include "Lex.h"
+#include "Optimizer.h"
 #include "Rule.h"
+#include "Split.h"
+#include "TokenStream.h"
 
+#include <atomic>
 #include <memory>
-#include <random>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 namespace CommonLexer
 {
 	class ISource;
+	class GrammarReader;
+	class GrammarWriter;
+
+	static constexpr std::uint32_t InvalidLiteral = ~0U;
+
+	// Where a borrowed expected text lies within the literals of a lexer
+	struct LiteralReference
+	{
+	public:
+		std::uint32_t m_Literal;
+		std::uint32_t m_Offset;
+	};
 
 	class Lexer
 	{
 	public:
 		Lexer();
 
-		Lex lexSource(ISource* source);
-		Lex lexSource(ISource* source, SourceSpan span);
+		// Lexing only reads the lexer, so a lexer can be shared between threads as long as it is not modified.
+		// Each call uses a temporary LexSession, use a LexSession directly to reuse the per lex state.
+		Lex lexSource(ISource* source) const;
+		Lex lexSource(ISource* source, SourceSpan span) const;
+		// Lexes like lexSource but writes the nodes as a flat list of tokens without building a tree, see LexSession::lexTokens
+		void lexTokens(ISource* source, TokenStream& tokens, ETokenFilter filter = ETokenFilter::Leaves) const;
+		void lexTokens(ISource* source, SourceSpan span, TokenStream& tokens, ETokenFilter filter = ETokenFilter::Leaves) const;
 
+		// Resolves every rule reference up front, returns false and fills getFinalizeErrors() when rules are missing
+		// Should be called after the last rule is registered, lexing a lexer that is not finalized finalizes it first
+		bool finalize();
+		// Finalizes the lexer unless it already is, lexes from several threads finalize it only once
+		void ensureFinalized() const;
+		// Writes the canonical form of the rules and options, returns false when a rule can't be written like callback rules
+		bool writeGrammar(GrammarWriter& writer) const;
+		// Replaces the rules and options with a canonical form from writeGrammar and finalizes, returns false when the data is invalid
+		bool readGrammar(GrammarReader& reader);
+		// Rewrites the matchers of the rules so lexing takes fewer match calls, lexes stay identical.
+		// Must be called after the last change to the rules and memoization, since inlined rules are copied into the rules referencing them
+		OptimizeStats optimize(const OptimizeOptions& options = {});
+
+		// A rule with the name of a registered rule replaces it and takes over its ID
 		template <Rule Rule>
 		void registerRule(Rule&& rule);
 		void registerRule(std::unique_ptr<IRule>&& rule);
+		void clearRules();
 		void setMainRule(const std::string& rule);
+		// Rules using named groups, callbacks or custom matchers are always matched again, since a replay could not repeat what they do
+		void setMemoization(bool enabled, std::size_t memoryLimit = ~0ULL);
+		void setRuleMemoization(const std::string& rule, bool memoized);
+		void setErrorReporting(EErrorReporting errorReporting) { m_ErrorReporting = errorReporting; }
+		// Choice of the ors that don't set their own, EChoice::First only lexes the same when every or lists longer matches first
+		void setChoice(EChoice choice) { m_Choice = choice; }
+		void setSplitOptions(const SplitOptions& splitOptions);
 
 		[[nodiscard]] std::uint32_t getRuleID(const std::string& rule) const;
-		[[nodiscard]] IRule*        getRule(std::uint32_t ruleID);
-		[[nodiscard]] IRule*        getRule(const std::string& rule) { return getRule(getRuleID(rule)); }
+		[[nodiscard]] const IRule*  getRule(std::uint32_t ruleID) const { return ruleID < m_Rules.size() ? m_Rules[ruleID].get() : nullptr; }
+		[[nodiscard]] const IRule*  getRule(const std::string& rule) const { return getRule(getRuleID(rule)); }
+		[[nodiscard]] auto          getMainRuleID() const { return m_MainRuleID; }
+		[[nodiscard]] std::size_t   getRuleCount() const { return m_Rules.size(); }
+		[[nodiscard]] bool          isFinalized() const { return m_Finalized.load(std::memory_order_acquire); }
+		[[nodiscard]] auto&         getFinalizeErrors() const { return m_FinalizeErrors; }
+		[[nodiscard]] auto          isMemoizing() const { return m_Memoization; }
+		[[nodiscard]] auto          getMemoLimit() const { return m_MemoLimit; }
+		[[nodiscard]] auto          getErrorReporting() const { return m_ErrorReporting; }
+		[[nodiscard]] auto          getChoice() const { return m_Choice; }
+		[[nodiscard]] auto&         getSplitOptions() const { return m_SplitOptions; }
+		[[nodiscard]] auto          getSplitRuleID() const { return m_SplitRuleID; }
+		// Texts and rule names of the matchers in the order linking found them, the same grammar always has the same literals
+		[[nodiscard]] std::string_view getLiteral(std::uint32_t literal) const { return literal < m_Literals.size() ? m_Literals[literal] : std::string_view {}; }
+		[[nodiscard]] std::size_t      getLiteralCount() const { return m_Literals.size(); }
+		// Finds the literal text points into, messages borrowed from the lexer are written this way so they can be borrowed again when read
+		[[nodiscard]] std::optional<LiteralReference> findLiteral(std::string_view text) const;
 
 	private:
-		std::uint32_t newRuleID();
+		// Links every rule and collects the literals again, the matchers may have been replaced since the last link
+		void linkRules(std::vector<std::string>& errors);
 
 	private:
-		std::mt19937 m_RNG;
+		std::string   m_MainRule;
+		std::uint32_t m_MainRuleID;
+
+		bool        m_Memoization;
+		std::size_t m_MemoLimit;
+
+		EErrorReporting m_ErrorReporting;
+		EChoice         m_Choice;
+
+		SplitOptions  m_SplitOptions;
+		std::uint32_t m_SplitRuleID;
+
+		std::vector<std::unique_ptr<IRule>>            m_Rules;
+		std::unordered_map<std::string, std::uint32_t> m_RuleIDs;
 
-		std::string m_MainRule;
+		std::vector<std::string_view> m_Literals;
+		// Literal indices ordered by address, to find the literal a text points into
+		std::vector<std::uint32_t> m_LiteralOrder;
 
-		std::unordered_map<std::uint32_t, std::unique_ptr<IRule>> m_Rules;
+		std::atomic<bool>        m_Finalized;
+		mutable std::mutex       m_FinalizeMutex;
+		std::vector<std::string> m_FinalizeErrors;
 	};
 
 	//--------------------------
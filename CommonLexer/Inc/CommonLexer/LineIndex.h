@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+
+#include <string_view>
+#include <vector>
+
+namespace CommonLexer
+{
+	// Immutable once built, so lookups can run from any number of threads
+	class LineIndex
+	{
+	public:
+		void build(std::string_view str);
+		void clear();
+
+		[[nodiscard]] bool        isBuilt() const { return !m_LineToIndex.empty(); }
+		[[nodiscard]] std::size_t getNumLines() const { return m_LineToIndex.size(); }
+		[[nodiscard]] std::size_t getIndexFromLine(std::size_t line) const { return line > 0 && line <= m_LineToIndex.size() ? m_LineToIndex[line - 1] : ~0ULL; }
+		[[nodiscard]] std::size_t getLineFromIndex(std::size_t index) const;
+		// Same as getLineFromIndex, cursor is the line of the caller's last lookup so monotonic queries mostly hit it or the line after it
+		[[nodiscard]] std::size_t getLineFromIndex(std::size_t index, std::size_t& cursor) const;
+		[[nodiscard]] std::size_t getColumnFromIndex(std::size_t index) const;
+
+		[[nodiscard]] auto& getLineStarts() const { return m_LineToIndex; }
+
+	private:
+		std::vector<std::size_t> m_LineToIndex;
+	};
+} // namespace CommonLexer
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Flags.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <filesystem>
+#include <string_view>
+
+namespace CommonLexer
+{
+	using MappedFileFlags = Flags<std::uint8_t>;
+
+	namespace EMappedFileFlags
+	{
+		static constexpr MappedFileFlags None       = 0;
+		static constexpr MappedFileFlags Sequential = 1;
+		static constexpr MappedFileFlags HugePages  = 2;
+		static constexpr MappedFileFlags Default    = Sequential;
+	} // namespace EMappedFileFlags
+
+	class MappedFile
+	{
+	public:
+		MappedFile();
+		explicit MappedFile(const std::filesystem::path& filepath, MappedFileFlags flags = EMappedFileFlags::Default);
+		MappedFile(MappedFile&& move) noexcept;
+		MappedFile& operator=(MappedFile&& move) noexcept;
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool open(const std::filesystem::path& filepath, MappedFileFlags flags = EMappedFileFlags::Default);
+		void close();
+
+		[[nodiscard]] auto             isOpen() const { return m_Open; }
+		[[nodiscard]] auto             getData() const { return m_Data; }
+		[[nodiscard]] auto             getSize() const { return m_Size; }
+		[[nodiscard]] std::string_view getView() const { return { m_Data, m_Size }; }
+
+	private:
+		bool        m_Open;
+		const char* m_Data;
+		std::size_t m_Size;
+
+		void* m_FileHandle;
+		void* m_MappingHandle;
+	};
+} // namespace CommonLexer
\ No newline at end of file
@@ -3,7 +3,12 @@
 #include "Message.h"
 #include "SourceSpan.h"
 
+#include <cstddef>
+#include <cstdint>
+
+#include <memory>
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <unordered_map>
 #include <vector>
@@ -11,15 +16,100 @@
 namespace CommonLexer
 {
 	struct Lex;
+	class Lexer;
 	class IRule;
-	struct Node;
+	class NodeStack;
+	class MemoTable;
+	class PrefixCache;
+	class ILexEventSink;
+	class GrammarWriter;
+	struct MatcherScopedState;
+	struct OptimizeState;
+
+	// Written in front of every matcher in the canonical form of a grammar
+	enum class EMatcherKind : std::uint8_t
+	{
+		Combination,
+		Or,
+		Range,
+		Optional,
+		Negative,
+		Space,
+		NamedGroup,
+		NamedGroupReference,
+		Reference,
+		Text,
+		Regex,
+		// An or with its own EChoice, written as the choice followed by the alternatives
+		ChoiceOr,
+
+		// Never written, they only tell matchers apart when optimizing
+		InlineRule,
+		SharedPrefix,
+		MatcherRule,
+		CallbackRule,
+		Custom
+	};
+
+	enum class EErrorReporting
+	{
+		// Every failed attempt adds its messages to the enclosing scope
+		Accumulate,
+		// Only the expectations at the farthest failure position are kept, they are reported when the lex is incomplete
+		FarthestFailure
+	};
+
+	enum class EChoice : std::uint8_t
+	{
+		// Every alternative of an or is tried and the longest match wins, ties go to the earlier alternative
+		Longest,
+		// The first alternative that matches wins like a PEG ordered choice, the ones after it are never tried
+		First
+	};
+
+	// An or match where the first and the longest matching alternative differ, so the two choices lex it differently
+	struct ChoiceDivergence
+	{
+	public:
+		// Rule the or was matched in
+		std::uint32_t m_RuleID;
+		SourcePoint   m_Point;
+
+		std::size_t m_FirstAlternative;
+		std::size_t m_LongestAlternative;
+		SourceSpan  m_FirstSpan;
+		SourceSpan  m_LongestSpan;
+	};
+
+	struct FarthestFailure
+	{
+	public:
+		void record(Message&& message);
+
+	public:
+		SourcePoint          m_Point;
+		std::vector<Message> m_Expectations;
+	};
 
 	struct MatcherState
 	{
 	public:
-		MatcherState(Lex* lex, ISource* source, SourceSpan sourceSpan) : m_Lex(lex), m_Source(source), m_SourceSpan(sourceSpan), m_CurrentRule(nullptr) {}
+		MatcherState(Lex* lex, ISource* source, SourceSpan sourceSpan, NodeStack* nodes, MemoTable* memo = nullptr) : m_Lex(lex), m_Source(source), m_SourceSpan(sourceSpan), m_Nodes(nodes), m_CurrentRule(nullptr), m_Memo(memo), m_ReadEnd(sourceSpan.m_Start) {}
+
+		void setCurrentRule(const IRule* rule, SourcePoint begin);
+		// Records that matching looked at the source up to end, reaching the end of the span is recorded as m_SourceSpan.m_End + 1
+		void markRead(SourcePoint end)
+		{
+			if (end > m_ReadEnd)
+				m_ReadEnd = end;
+		}
 
-		void setCurrentRule(IRule* rule, SourcePoint begin);
+		// Hands the nodes matched so far to the event sink and drops them, unless a matcher may still roll them back.
+		// Matching continues at point, so the memo entries in front of it are dropped as well.
+		void commitNodes(SourcePoint point);
+
+		template <class... Ts>
+		void addMessage(MatcherScopedState& scopedState, Ts&&... args);
 
 		void setGroupedValue(const std::string& name, SourceSpan span);
 		void setGroupedValue(std::string&& name, SourceSpan span);
@@ -29,20 +119,43 @@ namespace CommonLexer
 	public:
 		std::unordered_map<std::string, SourceSpan> m_GroupedValues;
 
+		// Null when lexing without a Lex, like into a token stream
 		Lex* m_Lex;
 
 		ISource*   m_Source;
 		SourceSpan m_SourceSpan;
 
-		IRule*      m_CurrentRule;
-		SourcePoint m_RuleBegin;
+		// Matched nodes, a lex builds its tree from them once matching is done
+		NodeStack* m_Nodes;
+		// Receives committed nodes when lexing into events instead of a tree
+		ILexEventSink* m_EventSink = nullptr;
+		// Number of enclosing matchers that may roll back nodes, nodes are only committed while this is zero
+		std::size_t m_Speculation = 0;
+
+		const IRule* m_CurrentRule;
+		SourcePoint  m_RuleBegin;
+
+		MemoTable* m_Memo;
+		// Last match of every prefix shared by Lexer::optimize, null matches shared prefixes like any other matcher
+		PrefixCache* m_Prefixes = nullptr;
+
+		// Farthest point looked at while matching, used to tell which nodes an edit can affect
+		SourcePoint m_ReadEnd;
+		// Regex matchers only track their exact reads when set, since it slows them down
+		bool m_TrackReads = false;
+
+		EErrorReporting m_ErrorReporting = EErrorReporting::Accumulate;
+		FarthestFailure m_FarthestFailure;
+
+		// Choice of the ors that don't set their own
+		EChoice m_Choice = EChoice::Longest;
+		// Receives every or match where the choices differ when set, which costs matching the alternatives a first match skips
+		std::vector<ChoiceDivergence>* m_ChoiceDivergences = nullptr;
 	};
 
 	struct MatcherScopedState
 	{
 	public:
-		explicit MatcherScopedState(Node* parentNode) : m_ParentNode(parentNode) {}
-
 		template <class... Ts>
 		void addMessage(Ts&&... args)
 		{
@@ -56,8 +169,6 @@ namespace CommonLexer
 
 	public:
 		std::vector<Message> m_Messages;
-
-		Node* m_ParentNode;
 	};
 
 	enum class EMatchStatus
@@ -74,14 +185,47 @@ namespace CommonLexer
 		SourceSpan   m_Span;
 	};
 
+	struct LinkState
+	{
+	public:
+		IRule*                         m_Rule;
+		std::vector<std::string>&      m_Errors;
+		// Texts messages may borrow their expected text from, matchers add every string they report in a message
+		std::vector<std::string_view>& m_Literals;
+	};
+
 	class IMatcher
 	{
 	public:
 		virtual ~IMatcher() = default;
 
-		virtual MatchResult match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) = 0;
+		virtual MatchResult match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const = 0;
+
+		// Resolves references to other rules and adds the literals, called once per rule by Lexer::finalize and again after Lexer::optimize
+		virtual void link([[maybe_unused]] const Lexer& lexer, [[maybe_unused]] LinkState& linkState) {}
+		// Writes the canonical form of the matcher, returns false for matchers that can't be described that way like callbacks
+		virtual bool write([[maybe_unused]] GrammarWriter& writer) const { return false; }
+		// Optimizes the matcher in place, returns a matcher that replaces it or nullptr to keep it, called by Lexer::optimize
+		virtual std::unique_ptr<IMatcher> optimize([[maybe_unused]] OptimizeState& state) { return nullptr; }
+		// Returns a deep copy sharing the linked rules, or nullptr for matchers that can't be copied like callbacks
+		[[nodiscard]] virtual std::unique_ptr<IMatcher> clone() const { return nullptr; }
+
+		[[nodiscard]] virtual EMatcherKind getKind() const { return EMatcherKind::Custom; }
 	};
 
 	template <class T>
 	concept Matcher = std::is_base_of_v<IMatcher, T>;
+
+	//--------------------------
+	// Template Implementations
+	//--------------------------
+
+	template <class... Ts>
+	void MatcherState::addMessage(MatcherScopedState& scopedState, Ts&&... args)
+	{
+		if (m_ErrorReporting == EErrorReporting::FarthestFailure)
+			m_FarthestFailure.record(Message { std::forward<Ts>(args)... });
+		else
+			scopedState.addMessage(std::forward<Ts>(args)...);
+	}
 } // namespace CommonLexer
\ No newline at end of file
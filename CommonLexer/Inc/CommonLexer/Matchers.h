@@ -4,7 +4,10 @@
 #include "Matcher.h"
 #include "Tuple.h"
 
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <regex>
 #include <string>
 #include <utility>
@@ -12,6 +15,8 @@
 
 namespace CommonLexer
 {
+	class GrammarReader;
+
 	//---------
 	// Depth 2
 	//---------
@@ -26,10 +31,31 @@ namespace CommonLexer
 		CombinationMatcher(std::vector<std::unique_ptr<IMatcher>>&& matchers);
 		CombinationMatcher(CombinationMatcher&& move) noexcept;
 
-		virtual MatchResult match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) override;
+		virtual MatchResult               match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const override;
+		virtual void                      link(const Lexer& lexer, LinkState& linkState) override;
+		virtual bool                      write(GrammarWriter& writer) const override;
+		virtual std::unique_ptr<IMatcher> optimize(OptimizeState& state) override;
+		virtual std::unique_ptr<IMatcher> clone() const override;
+		virtual EMatcherKind              getKind() const override { return EMatcherKind::Combination; }
+
+		[[nodiscard]] auto& getMatchers() const { return m_Matchers; }
+
+	private:
+		// Flattened combinations keep which matchers started one of the nested combinations, only whole nested combinations count towards the span of a failure
+		enum EElementFlags : std::uint8_t
+		{
+			GroupStart = 1,
+			FusedText  = 2
+		};
+
+	private:
+		MatchResult matchGroups(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const;
+		bool        writeGroups(GrammarWriter& writer) const;
 
 	private:
 		std::vector<std::unique_ptr<IMatcher>> m_Matchers;
+		// Empty unless the combination was optimized, then it holds the EElementFlags of every matcher
+		std::vector<std::uint8_t> m_Flags;
 	};
 
 	class OrMatcher final : public IMatcher
@@ -42,10 +68,29 @@ namespace CommonLexer
 		OrMatcher(std::vector<std::unique_ptr<IMatcher>>&& matchers);
 		OrMatcher(OrMatcher&& move) noexcept;
 
-		virtual MatchResult match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) override;
+		virtual MatchResult               match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const override;
+		virtual void                      link(const Lexer& lexer, LinkState& linkState) override;
+		virtual bool                      write(GrammarWriter& writer) const override;
+		virtual std::unique_ptr<IMatcher> optimize(OptimizeState& state) override;
+		virtual std::unique_ptr<IMatcher> clone() const override;
+		virtual EMatcherKind              getKind() const override { return EMatcherKind::Or; }
+
+		// Overrides the choice of the lexer for this or, std::nullopt follows the lexer again
+		void setChoice(std::optional<EChoice> choice) { m_Choice = choice; }
+
+		[[nodiscard]] auto& getMatchers() const { return m_Matchers; }
+		[[nodiscard]] auto& getDispatch() const { return m_Dispatch; }
+		[[nodiscard]] auto  getChoice() const { return m_Choice; }
+
+	private:
+		// Matches the alternatives after first in place of a longest choice and records a ChoiceDivergence when one of them matches more
+		void checkChoice(MatcherState& state, SourceSpan span, std::uint32_t ruleID, std::size_t first, SourceSpan firstSpan) const;
 
 	private:
 		std::vector<std::unique_ptr<IMatcher>> m_Matchers;
+		// Mask of the alternatives to try for each byte at the start of the span, empty to try them all
+		std::vector<std::uint64_t> m_Dispatch;
+		std::optional<EChoice>     m_Choice;
 	};
 
 	//---------
@@ -60,7 +105,16 @@ namespace CommonLexer
 		RangeMatcher(std::unique_ptr<IMatcher>&& matcher, std::size_t lowerBounds = 0, std::size_t upperBounds = ~0ULL);
 		RangeMatcher(RangeMatcher&& move) noexcept;
 
-		virtual MatchResult match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) override;
+		virtual MatchResult               match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const override;
+		virtual void                      link(const Lexer& lexer, LinkState& linkState) override;
+		virtual bool                      write(GrammarWriter& writer) const override;
+		virtual std::unique_ptr<IMatcher> optimize(OptimizeState& state) override;
+		virtual std::unique_ptr<IMatcher> clone() const override;
+		virtual EMatcherKind              getKind() const override { return EMatcherKind::Range; }
+
+		[[nodiscard]] auto& getMatcher() const { return m_Matcher; }
+		[[nodiscard]] auto  getLowerBounds() const { return m_LowerBounds; }
+		[[nodiscard]] auto  getUpperBounds() const { return m_UpperBounds; }
 
 	private:
 		std::unique_ptr<IMatcher> m_Matcher;
@@ -77,7 +131,14 @@ namespace CommonLexer
 		OptionalMatcher(std::unique_ptr<IMatcher>&& matcher);
 		OptionalMatcher(OptionalMatcher&& move) noexcept;
 
-		virtual MatchResult match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) override;
+		virtual MatchResult               match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const override;
+		virtual void                      link(const Lexer& lexer, LinkState& linkState) override;
+		virtual bool                      write(GrammarWriter& writer) const override;
+		virtual std::unique_ptr<IMatcher> optimize(OptimizeState& state) override;
+		virtual std::unique_ptr<IMatcher> clone() const override;
+		virtual EMatcherKind              getKind() const override { return EMatcherKind::Optional; }
+
+		[[nodiscard]] auto& getMatcher() const { return m_Matcher; }
 
 	private:
 		std::unique_ptr<IMatcher> m_Matcher;
@@ -91,7 +152,14 @@ namespace CommonLexer
 		NegativeMatcher(std::unique_ptr<IMatcher>&& matcher);
 		NegativeMatcher(NegativeMatcher&& move) noexcept;
 
-		virtual MatchResult match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) override;
+		virtual MatchResult               match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const override;
+		virtual void                      link(const Lexer& lexer, LinkState& linkState) override;
+		virtual bool                      write(GrammarWriter& writer) const override;
+		virtual std::unique_ptr<IMatcher> optimize(OptimizeState& state) override;
+		virtual std::unique_ptr<IMatcher> clone() const override;
+		virtual EMatcherKind              getKind() const override { return EMatcherKind::Negative; }
+
+		[[nodiscard]] auto& getMatcher() const { return m_Matcher; }
 
 	private:
 		std::unique_ptr<IMatcher> m_Matcher;
@@ -125,10 +193,20 @@ namespace CommonLexer
 		SpaceMatcher(std::unique_ptr<IMatcher>&& matcher, bool forced = false, SpaceDirectionFlags direction = ESpaceDirection::Right, ESpaceMethod method = ESpaceMethod::Normal);
 		SpaceMatcher(SpaceMatcher&& move) noexcept;
 
-		virtual MatchResult match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) override;
+		virtual MatchResult               match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const override;
+		virtual void                      link(const Lexer& lexer, LinkState& linkState) override;
+		virtual bool                      write(GrammarWriter& writer) const override;
+		virtual std::unique_ptr<IMatcher> optimize(OptimizeState& state) override;
+		virtual std::unique_ptr<IMatcher> clone() const override;
+		virtual EMatcherKind              getKind() const override { return EMatcherKind::Space; }
+
+		[[nodiscard]] auto& getMatcher() const { return m_Matcher; }
+		[[nodiscard]] auto  isForced() const { return m_Forced; }
+		[[nodiscard]] auto  getDirection() const { return m_Direction; }
+		[[nodiscard]] auto  getMethod() const { return m_Method; }
 
-		MatchResult matchNormalSpaces(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span);
-		MatchResult matchWhitespaceSpaces(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span);
+		MatchResult matchNormalSpaces(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const;
+		MatchResult matchWhitespaceSpaces(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const;
 
 	private:
 		std::unique_ptr<IMatcher> m_Matcher;
@@ -153,7 +231,14 @@ namespace CommonLexer
 		NamedGroupMatcher(std::string&& name, std::unique_ptr<IMatcher>&& matcher);
 		NamedGroupMatcher(NamedGroupMatcher&& move) noexcept;
 
-		virtual MatchResult match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) override;
+		virtual MatchResult               match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const override;
+		virtual void                      link(const Lexer& lexer, LinkState& linkState) override;
+		virtual bool                      write(GrammarWriter& writer) const override;
+		virtual std::unique_ptr<IMatcher> optimize(OptimizeState& state) override;
+		virtual std::unique_ptr<IMatcher> clone() const override;
+		virtual EMatcherKind              getKind() const override { return EMatcherKind::NamedGroup; }
+
+		[[nodiscard]] auto& getMatcher() const { return m_Matcher; }
 
 	private:
 		std::string m_Name;
@@ -168,7 +253,10 @@ namespace CommonLexer
 		NamedGroupReferenceMatcher(std::string&& name);
 		NamedGroupReferenceMatcher(NamedGroupReferenceMatcher&& move) noexcept;
 
-		virtual MatchResult match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) override;
+		virtual MatchResult               match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const override;
+		virtual bool                      write(GrammarWriter& writer) const override;
+		virtual std::unique_ptr<IMatcher> clone() const override;
+		virtual EMatcherKind              getKind() const override { return EMatcherKind::NamedGroupReference; }
 
 	private:
 		std::string m_Name;
@@ -181,25 +269,137 @@ namespace CommonLexer
 		ReferenceMatcher(std::string&& name);
 		ReferenceMatcher(ReferenceMatcher&& move) noexcept;
 
-		virtual MatchResult match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) override;
+		virtual MatchResult               match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const override;
+		virtual void                      link(const Lexer& lexer, LinkState& linkState) override;
+		virtual bool                      write(GrammarWriter& writer) const override;
+		virtual std::unique_ptr<IMatcher> optimize(OptimizeState& state) override;
+		virtual std::unique_ptr<IMatcher> clone() const override;
+		virtual EMatcherKind              getKind() const override { return EMatcherKind::Reference; }
+
+		[[nodiscard]] auto getRule() const { return m_Rule; }
 
 	private:
 		std::string m_Name;
 
-		IRule* m_Rule;
+		const IRule* m_Rule;
+	};
+
+	// Matches the matcher of a nodeless rule in place of a reference to it, made by Lexer::optimize.
+	// It is written as the reference it replaced.
+	class InlineRuleMatcher final : public IMatcher
+	{
+	public:
+		InlineRuleMatcher(const IRule* rule, std::unique_ptr<IMatcher>&& matcher);
+		InlineRuleMatcher(InlineRuleMatcher&& move) noexcept;
+
+		virtual MatchResult               match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const override;
+		virtual void                      link(const Lexer& lexer, LinkState& linkState) override;
+		virtual bool                      write(GrammarWriter& writer) const override;
+		virtual std::unique_ptr<IMatcher> optimize(OptimizeState& state) override;
+		virtual std::unique_ptr<IMatcher> clone() const override;
+		virtual EMatcherKind              getKind() const override { return EMatcherKind::InlineRule; }
+
+		[[nodiscard]] auto  getRule() const { return m_Rule; }
+		[[nodiscard]] auto& getMatcher() const { return m_Matcher; }
+
+	private:
+		const IRule* m_Rule;
+
+		std::unique_ptr<IMatcher> m_Matcher;
+	};
+
+	// Matches a prefix that several alternatives of an or start with, made by Lexer::optimize.
+	// Matchers with the same prefix ID match the same way, so the next alternative replays the match from MatcherState::m_Prefixes instead of matching again.
+	// It is written as the prefix it wraps.
+	class SharedPrefixMatcher final : public IMatcher
+	{
+	public:
+		SharedPrefixMatcher(std::uint32_t prefixID, std::unique_ptr<IMatcher>&& matcher);
+		SharedPrefixMatcher(SharedPrefixMatcher&& move) noexcept;
+
+		virtual MatchResult               match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const override;
+		virtual void                      link(const Lexer& lexer, LinkState& linkState) override;
+		virtual bool                      write(GrammarWriter& writer) const override;
+		virtual std::unique_ptr<IMatcher> optimize(OptimizeState& state) override;
+		virtual std::unique_ptr<IMatcher> clone() const override;
+		virtual EMatcherKind              getKind() const override { return EMatcherKind::SharedPrefix; }
+
+		[[nodiscard]] auto  getPrefixID() const { return m_PrefixID; }
+		[[nodiscard]] auto& getMatcher() const { return m_Matcher; }
+
+	private:
+		std::uint32_t m_PrefixID;
+
+		std::unique_ptr<IMatcher> m_Matcher;
 	};
 
 	class TextMatcher final : public IMatcher
 	{
+	public:
+		// Offsets into the text of a fused text, where a segment ends and whether it started a group of the combination
+		struct Segment
+		{
+		public:
+			std::size_t m_End;
+			bool        m_GroupStart;
+		};
+
+		static constexpr std::size_t NoGroupStart = ~0ULL;
+
 	public:
 		TextMatcher(const std::string& text);
 		TextMatcher(std::string&& text);
 		TextMatcher(TextMatcher&& move) noexcept;
 
-		virtual MatchResult match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) override;
+		virtual MatchResult               match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const override;
+		virtual void                      link(const Lexer& lexer, LinkState& linkState) override;
+		virtual bool                      write(GrammarWriter& writer) const override;
+		virtual std::unique_ptr<IMatcher> clone() const override;
+		virtual EMatcherKind              getKind() const override { return EMatcherKind::Text; }
+
+		// Appends next, the messages of each fused text stay the ones it reported on its own
+		void fuse(const TextMatcher& next, bool groupStart, bool nextGroupStart);
+		void setGroupStart(bool groupStart);
+
+		// Returns the offset of the last segment starting a group at or before the segment containing offset, or NoGroupStart
+		[[nodiscard]] std::size_t getGroupStart(std::size_t offset) const;
+
+		[[nodiscard]] auto& getText() const { return m_Text; }
+		[[nodiscard]] auto& getSegments() const { return m_Segments; }
+
+	private:
+		[[nodiscard]] std::pair<std::size_t, std::size_t> getSegment(std::size_t offset) const;
 
 	private:
 		std::string m_Text;
+		// Empty unless texts were fused
+		std::vector<Segment> m_Segments;
+	};
+
+	// The compiled form of a regex, shared by every regex matcher with the same pattern once the lexer is optimized.
+	// The pattern is checked on construction, invalid patterns are reported by Lexer::finalize and never compiled.
+	struct RegexProgram
+	{
+	public:
+		RegexProgram(std::string&& pattern);
+
+		const std::regex& getRegex();
+
+		[[nodiscard]] auto  isValid() const { return m_Valid; }
+		[[nodiscard]] auto& getError() const { return m_Error; }
+
+	public:
+		std::string m_Pattern;
+
+	private:
+		// Declared before m_Valid, which is initialized by validating into it
+		std::string m_Error;
+		bool        m_Valid;
+
+		// Compiled on first match, so building or loading a grammar does not pay for regexes it never uses
+		std::atomic<bool> m_Compiled;
+		std::mutex        m_CompileMutex;
+		std::regex        m_Regex;
 	};
 
 	class RegexMatcher final : public IMatcher
@@ -207,14 +407,25 @@ namespace CommonLexer
 	public:
 		RegexMatcher(const std::string& regex);
 		RegexMatcher(std::string&& regex);
+		RegexMatcher(std::shared_ptr<RegexProgram> program);
 		RegexMatcher(RegexMatcher&& move) noexcept;
 
-		virtual MatchResult match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) override;
+		virtual MatchResult               match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const override;
+		virtual void                      link(const Lexer& lexer, LinkState& linkState) override;
+		virtual bool                      write(GrammarWriter& writer) const override;
+		virtual std::unique_ptr<IMatcher> optimize(OptimizeState& state) override;
+		virtual std::unique_ptr<IMatcher> clone() const override;
+		virtual EMatcherKind              getKind() const override { return EMatcherKind::Regex; }
+
+		[[nodiscard]] auto& getProgram() const { return m_Program; }
 
 	private:
-		std::regex m_Regex;
+		std::shared_ptr<RegexProgram> m_Program;
 	};
 
+	// Builds a matcher from the canonical form written by IMatcher::write, returns nullptr when the data is invalid
+	std::unique_ptr<IMatcher> ReadMatcher(GrammarReader& reader);
+
 	//--------------------------
 	// Template Implementations
 	//--------------------------
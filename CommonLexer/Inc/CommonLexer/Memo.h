@@ -0,0 +1,89 @@
+#pragma once
+
+#include "Matcher.h"
+#include "Message.h"
+#include "NodeStack.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace CommonLexer
+{
+	class IRule;
+
+	struct MemoEntry
+	{
+	public:
+		MatchResult m_Result;
+		SourcePoint m_Bound;
+
+		const IRule* m_EndRule;
+		SourcePoint  m_EndRuleBegin;
+
+		SourcePoint m_ReadEnd;
+
+		std::vector<StackNode> m_Nodes;
+		std::vector<Message>   m_Messages;
+
+		std::size_t m_MemoryUsage;
+	};
+
+	struct MemoStats
+	{
+	public:
+		std::size_t m_Hits     = 0;
+		std::size_t m_Misses   = 0;
+		std::size_t m_Entries  = 0;
+		std::size_t m_Rejected = 0;
+		std::size_t m_Memory   = 0;
+	};
+
+	class MemoTable
+	{
+	public:
+		// Rule IDs are dense after Lexer::finalize, so entries are bucketed per rule instead of hashing the rule ID into the key.
+		explicit MemoTable(std::size_t ruleCount, std::size_t memoryLimit = ~0ULL) : m_Entries(ruleCount), m_MemoryLimit(memoryLimit) {}
+
+		[[nodiscard]] const MemoEntry* find(std::uint32_t ruleID, SourceSpan span);
+		void                           insert(std::uint32_t ruleID, SourceSpan span, MemoEntry&& entry);
+		void                           clear();
+		// Drops the entries of matches starting before point
+		void                           evictBefore(SourcePoint point);
+		// Clears the entries and makes room for ruleCount rules, keeping the allocated buckets for reuse
+		void                           reset(std::size_t ruleCount);
+
+		[[nodiscard]] auto  getMemoryLimit() const { return m_MemoryLimit; }
+		[[nodiscard]] auto& getStats() const { return m_Stats; }
+
+	private:
+		std::vector<std::unordered_map<std::size_t, MemoEntry>> m_Entries;
+
+		std::size_t m_MemoryLimit;
+		MemoStats   m_Stats;
+	};
+
+	// Holds the last match of every prefix shared by Lexer::optimize, the alternatives sharing a prefix try it right after each other over the same span.
+	class PrefixCache
+	{
+	public:
+		[[nodiscard]] const MemoEntry* find(std::uint32_t prefixID, SourceSpan span) const;
+		void                           insert(std::uint32_t prefixID, SourceSpan span, MemoEntry&& entry);
+		// Drops the entries, keeping the slots for reuse
+		void                           clear();
+
+	private:
+		struct Slot
+		{
+		public:
+			SourcePoint              m_Start;
+			std::optional<MemoEntry> m_Entry;
+		};
+
+	private:
+		std::vector<Slot> m_Slots;
+	};
+} // namespace CommonLexer
\ No newline at end of file
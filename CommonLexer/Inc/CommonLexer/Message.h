@@ -2,7 +2,11 @@
 
 #include "SourceSpan.h"
 
+#include <cstddef>
+#include <cstdint>
+
 #include <string>
+#include <string_view>
 #include <utility>
 
 namespace CommonLexer
@@ -13,23 +17,74 @@ namespace CommonLexer
 		Error
 	};
 
+	enum class EMessageKind : std::uint8_t
+	{
+		Custom,
+		ExpectedText,
+		ExpectedRegex,
+		ExpectedSpace,
+		ExpectedWhitespace,
+		ExpectedMatches,
+		UnexpectedSequence,
+		MissingRule
+	};
+
+	// Messages are recorded as structured records and only formatted when getMessage is called.
+	// The expected text is borrowed from the literals of the lexer, i.e. the texts and rule names of its matchers, so recording a failure never copies it.
+	// A message stays valid as long as the lexer, text the lexer does not own, like the value of a named group, is copied into the message.
 	struct Message
 	{
 	public:
-		Message(const std::string& message, SourcePoint point, SourceSpan span, std::uint32_t ruleID, EMessageSeverity severity = EMessageSeverity::Error) : m_Message(message), m_Point(point), m_Span(span), m_RuleID(ruleID), m_Severity(severity) {}
-		Message(std::string&& message, SourcePoint point, SourceSpan span, std::uint32_t ruleID, EMessageSeverity severity = EMessageSeverity::Error) : m_Message(std::move(message)), m_Point(point), m_Span(span), m_RuleID(ruleID), m_Severity(severity) {}
+		Message(const std::string& message, SourcePoint point, SourceSpan span, std::uint32_t ruleID, EMessageSeverity severity = EMessageSeverity::Error)
+		    : m_Kind(EMessageKind::Custom), m_GotEOF(false), m_Got('\0'), m_Severity(severity), m_RuleID(ruleID), m_Point(point), m_Span(span), m_ExpectedCount(0), m_GotCount(0), m_OwnsExpected(false), m_Message(message) {}
+		Message(std::string&& message, SourcePoint point, SourceSpan span, std::uint32_t ruleID, EMessageSeverity severity = EMessageSeverity::Error)
+		    : m_Kind(EMessageKind::Custom), m_GotEOF(false), m_Got('\0'), m_Severity(severity), m_RuleID(ruleID), m_Point(point), m_Span(span), m_ExpectedCount(0), m_GotCount(0), m_OwnsExpected(false), m_Message(std::move(message)) {}
+		Message(EMessageKind kind, SourcePoint point, SourceSpan span, std::uint32_t ruleID, EMessageSeverity severity = EMessageSeverity::Error)
+		    : m_Kind(kind), m_GotEOF(true), m_Got('\0'), m_Severity(severity), m_RuleID(ruleID), m_Point(point), m_Span(span), m_ExpectedCount(0), m_GotCount(0), m_OwnsExpected(false) {}
+		// expected has to live as long as the lexer
+		Message(EMessageKind kind, std::string_view expected, SourcePoint point, SourceSpan span, std::uint32_t ruleID, EMessageSeverity severity = EMessageSeverity::Error)
+		    : m_Kind(kind), m_GotEOF(true), m_Got('\0'), m_Severity(severity), m_RuleID(ruleID), m_Point(point), m_Span(span), m_Expected(expected), m_ExpectedCount(0), m_GotCount(0), m_OwnsExpected(false) {}
+		Message(EMessageKind kind, std::string_view expected, char got, SourcePoint point, SourceSpan span, std::uint32_t ruleID, EMessageSeverity severity = EMessageSeverity::Error)
+		    : m_Kind(kind), m_GotEOF(false), m_Got(got), m_Severity(severity), m_RuleID(ruleID), m_Point(point), m_Span(span), m_Expected(expected), m_ExpectedCount(0), m_GotCount(0), m_OwnsExpected(false) {}
+		// Copies expected into the message, for text the lexer does not own
+		Message(EMessageKind kind, std::string&& expected, SourcePoint point, SourceSpan span, std::uint32_t ruleID, EMessageSeverity severity = EMessageSeverity::Error)
+		    : m_Kind(kind), m_GotEOF(true), m_Got('\0'), m_Severity(severity), m_RuleID(ruleID), m_Point(point), m_Span(span), m_ExpectedCount(0), m_GotCount(0), m_OwnsExpected(true), m_Message(std::move(expected)) {}
+		Message(EMessageKind kind, std::string&& expected, char got, SourcePoint point, SourceSpan span, std::uint32_t ruleID, EMessageSeverity severity = EMessageSeverity::Error)
+		    : m_Kind(kind), m_GotEOF(false), m_Got(got), m_Severity(severity), m_RuleID(ruleID), m_Point(point), m_Span(span), m_ExpectedCount(0), m_GotCount(0), m_OwnsExpected(true), m_Message(std::move(expected)) {}
+		Message(EMessageKind kind, std::size_t expectedCount, std::size_t gotCount, SourcePoint point, SourceSpan span, std::uint32_t ruleID, EMessageSeverity severity = EMessageSeverity::Error)
+		    : m_Kind(kind), m_GotEOF(true), m_Got('\0'), m_Severity(severity), m_RuleID(ruleID), m_Point(point), m_Span(span), m_ExpectedCount(expectedCount), m_GotCount(gotCount), m_OwnsExpected(false) {}
+
+		// Moves the point and span by offset, used when the text in front of the message was edited
+		void shift(std::ptrdiff_t offset);
+
+		[[nodiscard]] std::string getMessage() const;
 
-		[[nodiscard]] auto& getMessage() const { return m_Message; }
-		[[nodiscard]] auto  getPoint() const { return m_Point; }
-		[[nodiscard]] auto  getSpan() const { return m_Span; }
-		[[nodiscard]] auto  getRuleID() const { return m_RuleID; }
-		[[nodiscard]] auto  getSeverity() const { return m_Severity; }
+		[[nodiscard]] auto getKind() const { return m_Kind; }
+		[[nodiscard]] auto isExpectedOwned() const { return m_OwnsExpected; }
+		[[nodiscard]] std::string_view getExpected() const { return m_OwnsExpected ? std::string_view { m_Message } : m_Expected; }
+		[[nodiscard]] auto getGot() const { return m_Got; }
+		[[nodiscard]] auto isGotEOF() const { return m_GotEOF; }
+		[[nodiscard]] auto getExpectedCount() const { return m_ExpectedCount; }
+		[[nodiscard]] auto getGotCount() const { return m_GotCount; }
+		[[nodiscard]] auto getPoint() const { return m_Point; }
+		[[nodiscard]] auto getSpan() const { return m_Span; }
+		[[nodiscard]] auto getRuleID() const { return m_RuleID; }
+		[[nodiscard]] auto getSeverity() const { return m_Severity; }
 
 	private:
-		std::string      m_Message;
+		EMessageKind     m_Kind;
+		bool             m_GotEOF;
+		char             m_Got;
+		EMessageSeverity m_Severity;
+		std::uint32_t    m_RuleID;
 		SourcePoint      m_Point;
 		SourceSpan       m_Span;
-		std::uint32_t    m_RuleID;
-		EMessageSeverity m_Severity;
+		std::string_view m_Expected;
+		std::size_t      m_ExpectedCount;
+		std::size_t      m_GotCount;
+		bool             m_OwnsExpected;
+
+		// The text of custom messages, or the expected text when the message owns it
+		std::string m_Message;
 	};
 } // namespace CommonLexer
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include "SourceSpan.h"
 
+#include <cstddef>
 #include <cstdint>
 
 #include <vector>
@@ -17,8 +18,12 @@ namespace CommonLexer
 		explicit Node(Lex& lex);
 		Node(Lex& lex, std::uint32_t rule);
 
+		// Points this node and all of its children at lex, used when the owning lex is moved
+		void setLex(Lex& lex);
 		void setRule(std::uint32_t rule);
 		void setSourceSpan(SourceSpan span);
+		// Moves the spans of this node and all of its children by offset
+		void shift(std::ptrdiff_t offset);
 		void addChild(const Node& child);
 		void addChild(Node&& child);
 		void addChildren(const Node& node);
@@ -29,6 +34,7 @@ namespace CommonLexer
 		[[nodiscard]] auto&       getLex() const { return *m_Lex; }
 		[[nodiscard]] auto        getRule() const { return m_Rule; }
 		[[nodiscard]] auto        getSpan() const { return m_Span; }
+		[[nodiscard]] auto&       getChildren() { return m_Children; }
 		[[nodiscard]] auto&       getChildren() const { return m_Children; }
 
 	private:
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "SourceSpan.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <span>
+#include <vector>
+
+namespace CommonLexer
+{
+	struct Node;
+
+	// A node on the stack, sizes are relative so a range of nodes can be copied anywhere on the stack
+	struct StackNode
+	{
+	public:
+		SourceSpan    m_Span;
+		std::uint32_t m_Rule;
+		// Number of nodes in this node's subtree including itself, its children directly follow it
+		std::uint32_t m_SubtreeSize;
+	};
+
+	// Nodes built while matching, stored in preorder on a single stack.
+	// Matchers take a checkpoint before trying something and roll back to it when the nodes are not wanted, which never allocates once the stack has grown.
+	class NodeStack
+	{
+	public:
+		[[nodiscard]] std::size_t checkpoint() const { return m_Nodes.size(); }
+		void                      rollback(std::size_t checkpoint);
+
+		// Pushes a node for rule, its children are the nodes pushed until it is closed
+		[[nodiscard]] std::size_t open(std::uint32_t rule);
+		void                      close(std::size_t index, SourceSpan span);
+		void                      append(std::span<const StackNode> nodes);
+		// Removes the nodes in [begin, end) and moves the nodes behind them down, the range has to consist of whole subtrees
+		void                      erase(std::size_t begin, std::size_t end);
+		void                      clear() { m_Nodes.clear(); }
+
+		// Adds the nodes from begin on as children of parent
+		void build(Node& parent, std::size_t begin = 0) const;
+
+		[[nodiscard]] std::span<const StackNode> getNodes(std::size_t begin = 0) const { return std::span<const StackNode> { m_Nodes }.subspan(begin); }
+		[[nodiscard]] std::size_t                size() const { return m_Nodes.size(); }
+
+	private:
+		void build(Node& parent, std::size_t begin, std::size_t end) const;
+
+	private:
+		std::vector<StackNode> m_Nodes;
+	};
+} // namespace CommonLexer
\ No newline at end of file
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "FirstSet.h"
+#include "Matcher.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace CommonLexer
+{
+	struct RegexProgram;
+
+	struct OptimizeOptions
+	{
+	public:
+		// Splices nested combinations and ors into their parent
+		bool m_Flatten = true;
+		// Replaces references to small nodeless rules with a copy of the rule's matcher
+		bool m_InlineRules = true;
+		// Merges adjacent texts in a combination into one text
+		bool m_FuseTexts = true;
+		// Lets regexes with the same pattern share one compiled program
+		bool m_ShareRegexes = true;
+		// Matches a prefix that several alternatives of an or start with once per span, the other alternatives replay it
+		bool m_SharePrefixes = true;
+		// Gives ors a table of the alternatives worth trying for each byte an alternative can start with
+		bool m_DispatchFirstBytes = true;
+
+		// Rules with more matchers than this are never inlined
+		std::size_t m_InlineLimit = 16;
+	};
+
+	struct OptimizeStats
+	{
+	public:
+		// Every removed matcher was one match call each time lexing reached it
+		[[nodiscard]] std::size_t getRemovedInvocations() const { return m_FlattenedMatchers + m_InlinedRules + m_FusedTexts; }
+
+	public:
+		std::size_t m_FlattenedMatchers = 0;
+		std::size_t m_InlinedRules      = 0;
+		std::size_t m_FusedTexts        = 0;
+		std::size_t m_SharedRegexes     = 0;
+		std::size_t m_SharedPrefixes    = 0;
+		std::size_t m_DispatchedOrs     = 0;
+	};
+
+	// Every pass keeps the nodes, messages and spans of the lex identical, so they only apply where that can be proven from the matchers.
+	struct OptimizeState
+	{
+	public:
+		OptimizeState(const Lexer& lexer, const OptimizeOptions& options, OptimizeStats& stats) : m_Lexer(lexer), m_Options(options), m_Stats(stats) {}
+
+		void optimize(std::unique_ptr<IMatcher>& matcher);
+
+		// Returns an optimized copy of the rule's matcher, or nullptr when references to the rule have to stay references
+		[[nodiscard]] std::unique_ptr<IMatcher> inlineRule(const IRule& rule);
+		[[nodiscard]] std::shared_ptr<RegexProgram> shareRegex(const std::shared_ptr<RegexProgram>& program);
+
+		// Looks for the prefixes the alternatives of ors share, has to be called before the rules are optimized
+		void findSharedPrefixes();
+		// Wraps the first matcher of a combination in a SharedPrefixMatcher when it is one of the shared prefixes
+		void sharePrefix(std::unique_ptr<IMatcher>& matcher);
+
+		// Computes the FIRST sets of the rules, has to be called before the rules are optimized
+		void analyzeFirstSets();
+		// Returns the alternatives to try for each byte at the start of the span, or an empty table when every alternative has to be tried
+		[[nodiscard]] std::vector<std::uint64_t> buildDispatch(const std::vector<std::unique_ptr<IMatcher>>& alternatives);
+
+		// Whether the matcher may return EMatchStatus::Skip, answers true when it can't tell
+		[[nodiscard]] bool        canSkip(const IMatcher& matcher);
+		[[nodiscard]] std::size_t countMatchers(const IMatcher& matcher) const;
+		// Whether the matcher matches a span the same way wherever it is used, so one match can be replayed in place of another
+		[[nodiscard]] bool        isStateless(const IMatcher& matcher);
+		// Whether matching the rule neither reads nor writes named groups and runs no callbacks or custom matchers, remembered per rule
+		[[nodiscard]] bool        isStatelessRule(const IRule& rule);
+
+	public:
+		const Lexer&           m_Lexer;
+		const OptimizeOptions& m_Options;
+		OptimizeStats&         m_Stats;
+
+		// Rules whose matcher is being optimized, they are never inlined into themselves
+		std::vector<const IRule*> m_RuleStack;
+
+	private:
+		enum class ESkip : std::uint8_t
+		{
+			Visiting,
+			Never,
+			Maybe
+		};
+
+	private:
+		void findSharedPrefixes(const IMatcher& matcher, std::vector<std::string>& prefixes);
+		// Returns the matcher an alternative starts with when it is the first matcher of a combination
+		[[nodiscard]] const IMatcher* getLeadingMatcher(const IMatcher& alternative) const;
+		[[nodiscard]] bool            readsState(const IMatcher& matcher, std::unordered_set<const IRule*>& visited) const;
+		// Same as readsState, remembering the answer for every referenced rule
+		[[nodiscard]] bool            readsState(const IMatcher& matcher);
+		// Whether matching may change the rule messages are reported for
+		[[nodiscard]] bool            setsRule(const IMatcher& matcher) const;
+		// Whether the first thing matching does is entering a rule, which hides the rule any matcher before it left behind
+		[[nodiscard]] bool            entersRule(const IMatcher& matcher) const;
+
+	private:
+		std::unordered_map<const IRule*, ESkip>                       m_RuleSkips;
+		std::unordered_map<std::string, std::shared_ptr<RegexProgram>> m_Regexes;
+
+		// Canonical form of every shared prefix to its prefix ID
+		std::unordered_map<std::string, std::uint32_t> m_SharedPrefixes;
+		std::unordered_map<const IRule*, bool>         m_StatelessRules;
+		std::uint32_t                                  m_PrefixCount = 0;
+
+		std::optional<FirstSetAnalysis> m_FirstSets;
+	};
+} // namespace CommonLexer
\ No newline at end of file
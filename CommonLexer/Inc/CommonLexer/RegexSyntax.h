@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace CommonLexer
+{
+	// Checks pattern against the ECMAScript syntax std::regex accepts, without compiling it.
+	// Compiling a pattern std::regex rejects aborts when exceptions are disabled, so patterns are checked here first.
+	// Returns false and sets error to the reason when std::regex would reject the pattern.
+	[[nodiscard]] bool ValidateRegex(std::string_view pattern, std::string& error);
+} // namespace CommonLexer
\ No newline at end of file
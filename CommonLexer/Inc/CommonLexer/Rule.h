@@ -6,6 +6,8 @@
 
 namespace CommonLexer
 {
+	static constexpr std::uint32_t InvalidRuleID = ~0U;
+
 	class IRule : public IMatcher
 	{
 	public:
@@ -13,13 +15,20 @@ namespace CommonLexer
 		IRule(std::string&& name);
 
 		[[nodiscard]] auto& getName() const { return m_Name; }
-		[[nodiscard]] auto  getID() { return m_ID; }
+		[[nodiscard]] auto  getID() const { return m_ID; }
+		[[nodiscard]] auto  isMemoized() const { return m_Memoized; }
+		[[nodiscard]] auto  isReplayable() const { return m_Replayable; }
 
 		void setID(std::uint32_t id) { m_ID = id; }
+		void setMemoized(bool memoized) { m_Memoized = memoized; }
+		// Set by Lexer::finalize, a rule is only replayed from the memo when replaying can't differ from matching it again
+		void setReplayable(bool replayable) { m_Replayable = replayable; }
 
 	private:
 		std::string   m_Name;
 		std::uint32_t m_ID;
+		bool          m_Memoized;
+		bool          m_Replayable;
 	};
 
 	template <class T>
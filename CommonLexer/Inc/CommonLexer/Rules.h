@@ -19,7 +19,14 @@ namespace CommonLexer
 		MatcherRule(std::string&& name, std::unique_ptr<IMatcher>&& matcher, bool createNode = true);
 		MatcherRule(MatcherRule&& move) noexcept;
 
-		virtual MatchResult match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) override;
+		virtual MatchResult               match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const override;
+		virtual void                      link(const Lexer& lexer, LinkState& linkState) override;
+		virtual bool                      write(GrammarWriter& writer) const override;
+		virtual std::unique_ptr<IMatcher> optimize(OptimizeState& state) override;
+		virtual EMatcherKind              getKind() const override { return EMatcherKind::MatcherRule; }
+
+		[[nodiscard]] auto& getMatcher() const { return m_Matcher; }
+		[[nodiscard]] auto  createsNode() const { return m_CreateNode; }
 
 	private:
 		std::unique_ptr<IMatcher> m_Matcher;
@@ -37,7 +44,8 @@ namespace CommonLexer
 		CallbackRule(std::string&& name, Callback&& callback);
 		CallbackRule(CallbackRule&& move) noexcept;
 
-		virtual MatchResult match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) override;
+		virtual MatchResult  match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const override;
+		virtual EMatcherKind getKind() const override { return EMatcherKind::CallbackRule; }
 
 	private:
 		Callback m_Callback;
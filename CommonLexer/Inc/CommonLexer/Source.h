@@ -1,14 +1,33 @@
 #pragma once
 
+#include "LineIndex.h"
+#include "MappedFile.h"
 #include "SourceSpan.h"
 
 #include <cstddef>
 
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace CommonLexer
 {
+	struct SourceChunk
+	{
+	public:
+		[[nodiscard]] bool        isContiguous() const { return m_Data.data() != nullptr; }
+		[[nodiscard]] std::size_t getEnd() const { return m_Start + m_Data.size(); }
+		[[nodiscard]] bool        contains(std::size_t index, std::size_t length = 1) const { return index >= m_Start && index + length <= getEnd(); }
+
+	public:
+		std::size_t      m_Start = 0;
+		std::string_view m_Data;
+	};
+
 	class ISource
 	{
 	public:
@@ -22,9 +41,21 @@ namespace CommonLexer
 
 		[[nodiscard]] SourceSpan getCompleteSpan() { return { 0, getSize() }; }
 
+		// Resolves the line and column of every point in a single sweep over the lines, columns count UTF-8 codepoints instead of bytes when utf8Columns is set.
+		// Points in ascending order take O(points + lines), other points are sorted first.
+		virtual void                              resolveLocations(std::span<const SourcePoint> points, std::span<SourceLocation> locations, bool utf8Columns = false);
+		[[nodiscard]] std::vector<SourceLocation> resolveLocations(std::span<const SourcePoint> points, bool utf8Columns = false);
+
 		[[nodiscard]] virtual std::string getSpan(std::size_t index, std::size_t length) = 0;
 		[[nodiscard]] std::string         getSpan(SourceSpan span) { return getSpan(span.m_Start, span.length()); }
 
+		// Returns the largest contiguous chunk of memory containing index, or a chunk without data if the source can't provide one
+		[[nodiscard]] virtual SourceChunk getChunk([[maybe_unused]] std::size_t index) { return { index, {} }; }
+
+		// Returns a view into the source without copying when possible, otherwise the span is copied into fallback
+		[[nodiscard]] std::string_view getSpanView(std::size_t index, std::size_t length, std::string& fallback);
+		[[nodiscard]] std::string_view getSpanView(SourceSpan span, std::string& fallback) { return getSpanView(span.m_Start, span.length(), fallback); }
+
 		[[nodiscard]] virtual std::string getLine(std::size_t line) = 0;
 		[[nodiscard]] std::string         getLine(SourcePoint point) { return getLine(getLineFromIndex(point)); }
 
@@ -50,17 +81,75 @@ namespace CommonLexer
 		[[nodiscard]] virtual std::size_t getLineFromIndex(std::size_t index) override;
 		[[nodiscard]] virtual std::size_t getColumnFromIndex(std::size_t index) override;
 
+		virtual void resolveLocations(std::span<const SourcePoint> points, std::span<SourceLocation> locations, bool utf8Columns = false) override;
+
 		[[nodiscard]] virtual std::string getSpan(std::size_t index, std::size_t length) override;
+		[[nodiscard]] virtual SourceChunk getChunk(std::size_t index) override;
 
 		[[nodiscard]] virtual std::string getLine(std::size_t line) override;
 
 		[[nodiscard]] virtual std::vector<std::string> getLines(std::size_t startLine, std::size_t lines) override;
 
 	private:
-		void setupLineToIndex();
+		std::string m_Str;
+		LineIndex   m_LineIndex;
+	};
+
+	class MappedFileSource : public ISource
+	{
+	public:
+		MappedFileSource() = default;
+		explicit MappedFileSource(const std::filesystem::path& filepath, MappedFileFlags flags = EMappedFileFlags::Default);
+
+		bool open(const std::filesystem::path& filepath, MappedFileFlags flags = EMappedFileFlags::Default);
+		void close();
+
+		[[nodiscard]] auto isOpen() const { return m_File.isOpen(); }
+
+		[[nodiscard]] virtual std::size_t getSize() override;
+		[[nodiscard]] virtual std::size_t getNumLines() override;
+		[[nodiscard]] virtual std::size_t getIndexFromLine(std::size_t line) override;
+		[[nodiscard]] virtual std::size_t getLineFromIndex(std::size_t index) override;
+		[[nodiscard]] virtual std::size_t getColumnFromIndex(std::size_t index) override;
+
+		virtual void resolveLocations(std::span<const SourcePoint> points, std::span<SourceLocation> locations, bool utf8Columns = false) override;
+
+		[[nodiscard]] virtual std::string getSpan(std::size_t index, std::size_t length) override;
+		[[nodiscard]] virtual SourceChunk getChunk(std::size_t index) override;
+
+		[[nodiscard]] virtual std::string getLine(std::size_t line) override;
+
+		[[nodiscard]] virtual std::vector<std::string> getLines(std::size_t startLine, std::size_t lines) override;
+
+	private:
+		const LineIndex& getLineIndex();
 
 	private:
-		std::string              m_Str;
-		std::vector<std::size_t> m_LineToIndex;
+		MappedFile m_File;
+
+		// Built on the first line lookup, lookups from several threads build it once
+		LineIndex         m_LineIndex;
+		std::atomic<bool> m_LineIndexBuilt { false };
+		std::mutex        m_LineIndexMutex;
 	};
+
+	//--------------------------
+	// Template Implementations
+	//--------------------------
+
+	// Calls func(begin, end, toPoint) with raw pointers when span lies inside a single contiguous chunk and with SourceIterators otherwise.
+	// toPoint converts an iterator of either kind back into a SourcePoint.
+	template <class Func>
+	decltype(auto) VisitSourceSpan(ISource* source, SourceSpan span, Func&& func)
+	{
+		auto chunk = source->getChunk(span.m_Start);
+		if (chunk.isContiguous() && chunk.contains(span.m_Start, span.length()))
+		{
+			const char* data  = chunk.m_Data.data();
+			std::size_t start = chunk.m_Start;
+			const char* begin = data + (span.m_Start - start);
+			return func(begin, begin + span.length(), [data, start](const char* itr) { return SourcePoint { start + static_cast<std::size_t>(itr - data) }; });
+		}
+		return func(span.begin(source), span.end(source), [](SourceIterator itr) { return static_cast<SourcePoint>(itr); });
+	}
 } // namespace CommonLexer
\ No newline at end of file
@@ -70,31 +70,42 @@ namespace CommonLexer
 		std::size_t m_Index;
 	};
 
+	struct SourceLocation
+	{
+	public:
+		std::size_t m_Line   = 0;
+		std::size_t m_Column = 0;
+	};
+
 	class SourceIterator
 	{
 	public:
 		using value_type        = char;
-		using difference_type   = std::size_t;
-		using reference         = char&;
-		using pointer           = char*;
-		using iterator_category = std::bidirectional_iterator_tag;
+		using difference_type   = std::ptrdiff_t;
+		using reference         = char;
+		using pointer           = const char*;
+		using iterator_category = std::random_access_iterator_tag;
 
-		SourceIterator() : m_Source(nullptr), m_CacheOffset(0) {}
-		SourceIterator(ISource* source, SourcePoint point) : m_Source(source), m_Point(point), m_CacheOffset(0) { recache(); }
+		SourceIterator() : m_Source(nullptr), m_ChunkStart(0), m_Chunk(nullptr), m_ChunkSize(0), m_CacheStart(0) {}
+		SourceIterator(ISource* source, SourcePoint point) : m_Source(source), m_Point(point), m_ChunkStart(0), m_Chunk(nullptr), m_ChunkSize(0), m_CacheStart(0) { recache(); }
 
 		[[nodiscard]] operator SourcePoint() const { return m_Point; }
 
 		[[nodiscard]] char operator*() const
 		{
-			if (m_Cache.empty() || m_CacheOffset >= m_Cache.size())
-				return '\0';
-			return m_Cache[m_CacheOffset];
+			std::size_t offset = m_Point.m_Index - m_ChunkStart;
+			if (offset < m_ChunkSize)
+				return m_Chunk[offset];
+			offset = m_Point.m_Index - m_CacheStart;
+			if (offset < m_Cache.size())
+				return m_Cache[offset];
+			return '\0';
 		}
+		[[nodiscard]] char operator[](difference_type offset) const { return *(*this + offset); }
 
 		SourceIterator& operator++()
 		{
 			++m_Point;
-			++m_CacheOffset;
 			recache();
 			return *this;
 		}
@@ -102,14 +113,12 @@ namespace CommonLexer
 		{
 			auto copy = *this;
 			++m_Point;
-			++m_CacheOffset;
 			recache();
 			return copy;
 		}
 		SourceIterator& operator--()
 		{
 			--m_Point;
-			--m_CacheOffset;
 			recache();
 			return *this;
 		}
@@ -117,38 +126,38 @@ namespace CommonLexer
 		{
 			auto copy = *this;
 			--m_Point;
-			--m_CacheOffset;
 			recache();
 			return copy;
 		}
 
-		SourceIterator& operator+=(std::size_t count)
+		SourceIterator& operator+=(difference_type count)
 		{
-			m_Point += count;
-			m_CacheOffset += count;
+			m_Point += static_cast<std::size_t>(count);
 			recache();
 			return *this;
 		}
-		SourceIterator& operator-=(std::size_t count)
+		SourceIterator& operator-=(difference_type count)
 		{
-			m_Point -= count;
-			m_CacheOffset -= count;
+			m_Point -= static_cast<std::size_t>(count);
 			recache();
 			return *this;
 		}
 
-		[[nodiscard]] SourceIterator operator+(std::size_t count)
+		[[nodiscard]] SourceIterator operator+(difference_type count) const
 		{
 			auto copy = *this;
 			copy += count;
 			return copy;
 		}
-		[[nodiscard]] SourceIterator operator-(std::size_t count)
+		[[nodiscard]] SourceIterator operator-(difference_type count) const
 		{
 			auto copy = *this;
 			copy -= count;
 			return copy;
 		}
+		[[nodiscard]] friend SourceIterator operator+(difference_type count, const SourceIterator& itr) { return itr + count; }
+
+		[[nodiscard]] difference_type operator-(const SourceIterator& other) const { return static_cast<difference_type>(m_Point.m_Index - other.m_Point.m_Index); }
 
 		[[nodiscard]] bool operator==(const SourceIterator& other) const { return m_Point == other.m_Point; }
 		[[nodiscard]] bool operator!=(const SourceIterator& other) const { return m_Point != other.m_Point; }
@@ -158,13 +167,27 @@ namespace CommonLexer
 		[[nodiscard]] bool operator>=(const SourceIterator& other) const { return m_Point >= other.m_Point; }
 
 	private:
-		void recache();
+		void recache()
+		{
+			if (m_Point.m_Index - m_ChunkStart < m_ChunkSize)
+				return;
+			fetch();
+		}
+
+		void fetch();
 
 	private:
 		ISource*    m_Source;
 		SourcePoint m_Point;
+
+		// Contiguous memory owned by the source
+		std::size_t m_ChunkStart;
+		const char* m_Chunk;
+		std::size_t m_ChunkSize;
+
+		// Copied window for sources without contiguous memory
 		std::string m_Cache;
-		std::size_t m_CacheOffset;
+		std::size_t m_CacheStart;
 	};
 
 	struct SourceSpan
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace CommonLexer
+{
+	// Describes how a source can be split into chunks that are lexed in parallel.
+	// The main rule has to be equivalent to zero or more repetitions of m_ItemRule, and items must not share named groups.
+	struct SplitOptions
+	{
+	public:
+		[[nodiscard]] bool isEnabled() const { return !m_ItemRule.empty(); }
+
+	public:
+		std::string m_ItemRule;
+
+		std::string m_OpenBrackets  = "{([";
+		std::string m_CloseBrackets = "})]";
+		std::string m_Quotes        = "\"'";
+		std::string m_LineComment   = "#";
+		// A split point has to follow one of these characters, ignoring whitespace and comments
+		std::string m_Terminators = ";}";
+		// Only split in front of a non whitespace character at the start of a line
+		bool m_LineStart = true;
+
+		std::size_t m_MinChunkSize = 16384;
+	};
+
+	// Scans text for at most chunkCount - 1 split points outside of brackets, quotes and comments, spread evenly over the text.
+	// The points are only likely item boundaries, the lexer verifies them and falls back to serial lexing when they are wrong.
+	[[nodiscard]] std::vector<std::size_t> FindSplitPoints(std::string_view text, const SplitOptions& options, std::size_t chunkCount);
+} // namespace CommonLexer
\ No newline at end of file
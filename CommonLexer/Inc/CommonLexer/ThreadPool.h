@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace CommonLexer
+{
+	// Fixed size pool where every worker owns a task queue, idle workers steal from the front of the other queues.
+	class ThreadPool
+	{
+	public:
+		// Called with the index of the worker running it, so callers can keep per worker state
+		using Task = std::function<void(std::size_t worker)>;
+
+	public:
+		// A thread count of 0 uses one worker per hardware thread
+		explicit ThreadPool(std::size_t threadCount = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		// Queues the task on the given worker, it might still be run by any other worker
+		void submit(std::size_t worker, Task&& task);
+		void submit(Task&& task);
+		// Blocks until every submitted task has finished
+		void wait();
+
+		[[nodiscard]] auto getThreadCount() const { return m_Workers.size(); }
+
+	private:
+		struct Worker
+		{
+		public:
+			std::mutex       m_Mutex;
+			std::deque<Task> m_Tasks;
+			std::thread      m_Thread;
+		};
+
+	private:
+		void run(std::size_t worker);
+		bool popTask(std::size_t worker, Task& task);
+
+	private:
+		std::vector<std::unique_ptr<Worker>> m_Workers;
+
+		std::mutex              m_Mutex;
+		std::condition_variable m_WorkAvailable;
+		std::condition_variable m_Idle;
+		bool                    m_Stopping;
+
+		std::atomic<std::size_t> m_Queued;
+		std::atomic<std::size_t> m_Pending;
+		std::atomic<std::size_t> m_NextWorker;
+	};
+} // namespace CommonLexer
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Message.h"
+#include "NodeStack.h"
+#include "SourceSpan.h"
+
+#include <cstdint>
+
+#include <span>
+#include <vector>
+
+namespace CommonLexer
+{
+	static constexpr std::uint32_t InvalidTokenIndex = ~0U;
+
+	enum class ETokenFilter
+	{
+		// Only nodes without children are written
+		Leaves,
+		// Every node is written in preorder
+		All
+	};
+
+	struct Token
+	{
+	public:
+		SourceSpan    m_Span;
+		std::uint32_t m_Rule;
+		// Number of ancestors the node has, whether they were written or not
+		std::uint32_t m_Depth;
+		// Index of the parent's token, InvalidTokenIndex for top level nodes and when the parent was filtered out
+		std::uint32_t m_Parent;
+	};
+
+	struct TokenStream
+	{
+	public:
+		void clear();
+
+	public:
+		std::vector<Token>   m_Tokens;
+		std::vector<Message> m_Messages;
+	};
+
+	// Appends the nodes in preorder as tokens
+	void AppendTokens(std::span<const StackNode> nodes, ETokenFilter filter, std::vector<Token>& tokens);
+} // namespace CommonLexer
\ No newline at end of file
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "CommonLexer/Lex.h"
+#include "CommonLexer/Lexer.h"
+#include "CommonLexer/Matchers.h"
+#include "CommonLexer/Rules.h"
+
+#include <cstdint>
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace CommonLexer
+{
+	class ISource;
+}
+
+namespace GrammarLexer
+{
+	// Builds a runtime lexer from a .grammar file lexed by GrammarLexer.
+	// Groups and nested combinations or ors are flattened and single element combinations are unwrapped while compiling, so the matchers are as shallow as hand written ones.
+	class GrammarCompiler
+	{
+	public:
+		// Callback rules declared with 'Name!;' are bound to the callback registered under their name
+		void setCallback(const std::string& rule, CommonLexer::CallbackRule::Callback&& callback);
+
+		// Replaces the rules of lexer, applies the options the grammar sets and finalizes it, returns false and fills getErrors() when the grammar is invalid.
+		// Settings the grammar does not mention, like memoization without a '!Memoization' option, stay as they are on lexer.
+		bool compile(CommonLexer::ISource* source, CommonLexer::Lexer& lexer);
+		bool compile(const CommonLexer::Lex& grammar, CommonLexer::Lexer& lexer);
+
+		[[nodiscard]] auto& getErrors() const { return m_Errors; }
+
+	private:
+		enum class ENodeKind : std::uint8_t
+		{
+			Unknown,
+			BlockDeclaration,
+			OptionDeclaration,
+			RuleDeclaration,
+			NodelessRuleDeclaration,
+			CallbackRuleDeclaration,
+			Identifier,
+			Boolean,
+			Integer,
+			Branch,
+			CombinationMatcher,
+			OrMatcher,
+			ZeroOrMore,
+			OneOrMore,
+			ExactAmount,
+			RangeMatcher,
+			OptionalMatcher,
+			NegativeMatcher,
+			LenientSpaceMatcher,
+			ForcedSpaceMatcher,
+			Group,
+			NamedGroupMatcher,
+			NamedGroupReferenceMatcher,
+			ReferenceMatcher,
+			TextMatcher,
+			RegexMatcher
+		};
+
+		// Options are scoped to the block declaring them
+		struct Options
+		{
+		public:
+			CommonLexer::SpaceDirectionFlags m_SpaceDirection = CommonLexer::ESpaceDirection::Right;
+			CommonLexer::ESpaceMethod        m_SpaceMethod    = CommonLexer::ESpaceMethod::Normal;
+
+			// Ors follow the choice of the lexer until '!Choice' sets one
+			std::optional<CommonLexer::EChoice> m_Choice;
+		};
+
+		using Matchers = std::vector<std::unique_ptr<CommonLexer::IMatcher>>;
+
+	private:
+		void compileDeclarations(const CommonLexer::Node& node, Options options);
+		void compileOption(const CommonLexer::Node& node, Options& options);
+		void compileRule(const CommonLexer::Node& node, const Options& options, bool createNode);
+		void compileCallbackRule(const CommonLexer::Node& node);
+
+		std::unique_ptr<CommonLexer::IMatcher> compileMatcher(const CommonLexer::Node& node, const Options& options);
+		void                                   compileSequence(const CommonLexer::Node& node, std::size_t begin, std::size_t end, const Options& options, Matchers& matchers);
+		void                                   compileAlternatives(const CommonLexer::Node& node, const Options& options, Matchers& matchers);
+
+		void addError(const CommonLexer::Node& node, std::string_view error);
+
+		[[nodiscard]] ENodeKind                getKind(const CommonLexer::Node& node) const;
+		[[nodiscard]] std::string              getText(const CommonLexer::Node& node) const;
+		[[nodiscard]] std::string              getIdentifier(const CommonLexer::Node& node) const;
+		[[nodiscard]] const CommonLexer::Node& unwrapGroups(const CommonLexer::Node& node) const;
+		// Branches separated by ';' are lexed as a combination, because forced spaces skip the separator, so they are told apart by the text between the children
+		[[nodiscard]] bool hasBranches(const CommonLexer::Node& node) const;
+		[[nodiscard]] bool isBranchSeparator(const CommonLexer::Node& previous, const CommonLexer::Node& next) const;
+
+	private:
+		std::unordered_map<std::string, CommonLexer::CallbackRule::Callback> m_Callbacks;
+
+		const CommonLexer::Lex*  m_Grammar = nullptr;
+		CommonLexer::Lexer*      m_Lexer   = nullptr;
+		std::vector<ENodeKind>   m_Kinds;
+		std::vector<std::string> m_Errors;
+	};
+} // namespace GrammarLexer
\ No newline at end of file
@@ -0,0 +1,163 @@
+#include "CommonLexer/BatchLexer.h"
+#include "CommonLexer/Lexer.h"
+#include "CommonLexer/Source.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+
+namespace CommonLexer
+{
+	static double PerSecond(std::size_t count, std::chrono::nanoseconds duration)
+	{
+		return duration.count() > 0 ? static_cast<double>(count) * 1e9 / static_cast<double>(duration.count()) : 0.0;
+	}
+
+	double BatchLexFileStats::getBytesPerSecond() const
+	{
+		return PerSecond(m_Bytes, m_Duration);
+	}
+
+	double BatchLexStats::getBytesPerSecond() const
+	{
+		return PerSecond(m_Bytes, m_WallTime);
+	}
+
+	double BatchLexStats::getFilesPerSecond() const
+	{
+		return PerSecond(m_Files, m_WallTime);
+	}
+
+	BatchLexer::BatchLexer(const Lexer& lexer, std::size_t threadCount)
+	    : m_Lexer(&lexer), m_Pool(threadCount), m_SerialSession(lexer)
+	{
+		m_Sessions.reserve(m_Pool.getThreadCount());
+		for (std::size_t i = 0; i < m_Pool.getThreadCount(); ++i)
+			m_Sessions.emplace_back(lexer);
+	}
+
+	BatchLexResult BatchLexer::lexSources(std::span<ISource* const> sources)
+	{
+		BatchLexResult result;
+		lexBatch(result, sources, {}, EMappedFileFlags::None);
+		return result;
+	}
+
+	BatchLexResult BatchLexer::lexFiles(std::span<const std::filesystem::path> filepaths, MappedFileFlags flags)
+	{
+		BatchLexResult result;
+		lexBatch(result, {}, filepaths, flags);
+		return result;
+	}
+
+	Lex BatchLexer::lexSplit(ISource* source)
+	{
+		return lexSplit(source, source->getCompleteSpan());
+	}
+
+	Lex BatchLexer::lexSplit(ISource* source, SourceSpan span)
+	{
+		m_Lexer->ensureFinalized();
+		if (!source || !m_Lexer->getSplitOptions().isEnabled() || m_Lexer->getSplitRuleID() == InvalidRuleID)
+			return m_SerialSession.lexSource(source, span);
+
+		std::string fallback;
+		auto        text   = source->getSpanView(span, fallback);
+		auto        points = FindSplitPoints(text, m_Lexer->getSplitOptions(), m_Pool.getThreadCount() * 4);
+		if (points.empty())
+			return m_SerialSession.lexSource(source, span);
+
+		std::vector<SourcePoint> starts;
+		starts.reserve(points.size() + 1);
+		starts.emplace_back(span.m_Start);
+		for (auto point : points)
+			starts.emplace_back(span.m_Start + point);
+
+		std::vector<Lex> chunks;
+		chunks.reserve(starts.size());
+		for (std::size_t i = 0; i < starts.size(); ++i)
+			chunks.emplace_back(*m_Lexer, source);
+
+		std::vector<std::uint8_t> lined(starts.size(), false);
+		for (std::size_t i = 0; i < starts.size(); ++i)
+		{
+			m_Pool.submit(i * m_Pool.getThreadCount() / starts.size(), [this, &chunks, &starts, &lined, source, span, i](std::size_t worker) {
+				SourcePoint end = i + 1 < starts.size() ? starts[i + 1] : span.m_End;
+				lined[i]        = m_Sessions[worker].lexChunk(chunks[i], source, span, starts[i], end);
+			});
+		}
+		m_Pool.wait();
+
+		if (std::find(lined.begin(), lined.end(), false) != lined.end())
+			return m_SerialSession.lexSource(source, span);
+
+		Lex   lex { *m_Lexer, source };
+		auto& root = lex.getRoot();
+		root.setRule(m_Lexer->getMainRuleID());
+		for (auto& chunk : chunks)
+			root.addChildren(std::move(chunk.getRoot()));
+		root.setLex(lex);
+		return lex;
+	}
+
+	void BatchLexer::lexBatch(BatchLexResult& result, std::span<ISource* const> sources, std::span<const std::filesystem::path> filepaths, MappedFileFlags flags)
+	{
+		std::size_t count   = filepaths.empty() ? sources.size() : filepaths.size();
+		std::size_t threads = m_Pool.getThreadCount();
+
+		result.m_Lexes.reserve(count);
+		for (std::size_t i = 0; i < count; ++i)
+			result.m_Lexes.emplace_back(*m_Lexer, filepaths.empty() ? sources[i] : nullptr);
+		result.m_FileStats.resize(count);
+		if (!filepaths.empty())
+			result.m_Sources.resize(count);
+
+		auto start = std::chrono::steady_clock::now();
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			// Neighbouring files start on the same worker, stealing evens out the load when their sizes differ
+			m_Pool.submit(i * threads / count, [this, &result, sources, filepaths, flags, i](std::size_t worker) {
+				auto        fileStart = std::chrono::steady_clock::now();
+				auto&       stats     = result.m_FileStats[i];
+				ISource*    source    = nullptr;
+				std::size_t size      = 0;
+				if (filepaths.empty())
+				{
+					source = sources[i];
+				}
+				else
+				{
+					auto file = std::make_unique<MappedFileSource>(filepaths[i], flags);
+					if (file->isOpen())
+						source = file.get();
+					result.m_Sources[i] = std::move(file);
+				}
+
+				if (source)
+				{
+					size              = source->getSize();
+					result.m_Lexes[i] = m_Sessions[worker].lexSource(source);
+				}
+				else if (!filepaths.empty())
+				{
+					result.m_Lexes[i].setMessages({ Message { fmt::format("Failed to open '{}'", filepaths[i].string()), 0, { 0, 0 }, InvalidRuleID } });
+				}
+
+				stats.m_Bytes    = size;
+				stats.m_Worker   = worker;
+				stats.m_Duration = std::chrono::steady_clock::now() - fileStart;
+			});
+		}
+		m_Pool.wait();
+
+		auto& total      = result.m_Stats;
+		total.m_Files    = count;
+		total.m_Threads  = threads;
+		total.m_WallTime = std::chrono::steady_clock::now() - start;
+		for (auto& stats : result.m_FileStats)
+		{
+			total.m_Bytes += stats.m_Bytes;
+			total.m_LexTime += stats.m_Duration;
+		}
+	}
+} // namespace CommonLexer
\ No newline at end of file
@@ -0,0 +1,315 @@
+#include "CommonLexer/FirstSet.h"
+#include "CommonLexer/Lexer.h"
+#include "CommonLexer/Matchers.h"
+#include "CommonLexer/Rules.h"
+
+namespace CommonLexer
+{
+	static constexpr std::string_view SpaceBytes      = " \t";
+	static constexpr std::string_view WhitespaceBytes = " \t\n\v\f\r";
+
+	static void AddBytes(std::bitset<256>& bytes, std::string_view chars)
+	{
+		for (char c : chars)
+			bytes.set(static_cast<std::uint8_t>(c));
+	}
+
+	static void AddRange(std::bitset<256>& bytes, std::uint8_t first, std::uint8_t last)
+	{
+		for (std::size_t c = first; c <= last; ++c)
+			bytes.set(c);
+	}
+
+	// Adds the bytes of a class escape like \d, returns false when c isn't one
+	static bool AddClassEscape(std::bitset<256>& bytes, char c)
+	{
+		std::bitset<256> set;
+		switch (c)
+		{
+		case 'd': [[fallthrough]];
+		case 'D': AddRange(set, '0', '9'); break;
+		case 'w': [[fallthrough]];
+		case 'W':
+			AddRange(set, '0', '9');
+			AddRange(set, 'A', 'Z');
+			AddRange(set, 'a', 'z');
+			set.set('_');
+			break;
+		case 's': [[fallthrough]];
+		case 'S': AddBytes(set, WhitespaceBytes); break;
+		default: return false;
+		}
+		bytes |= c >= 'A' && c <= 'Z' ? ~set : set;
+		return true;
+	}
+
+	// Returns the byte a character escape stands for, or -1 for escapes that aren't a single known byte like back references
+	static int GetEscapedByte(std::string_view pattern, std::size_t i, bool inClass)
+	{
+		char c = pattern[i];
+		switch (c)
+		{
+		case 'n': return '\n';
+		case 't': return '\t';
+		case 'r': return '\r';
+		case 'f': return '\f';
+		case 'v': return '\v';
+		case 'b': return inClass ? '\b' : -1;
+		case '0': return i + 1 < pattern.size() && pattern[i + 1] >= '0' && pattern[i + 1] <= '9' ? -1 : '\0';
+		default:
+			if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || static_cast<std::uint8_t>(c) >= 0x80)
+				return -1;
+			return static_cast<std::uint8_t>(c);
+		}
+	}
+
+	// Parses the bracket expression starting at pattern[i], i is left after the closing bracket
+	static bool ParseClass(std::string_view pattern, std::size_t& i, std::bitset<256>& bytes)
+	{
+		bool negated = ++i < pattern.size() && pattern[i] == '^';
+		if (negated)
+			++i;
+		if (i >= pattern.size() || pattern[i] == ']')
+			return false;
+
+		// Gives the byte at i, -2 for a class escape already added to set
+		std::bitset<256> set;
+		auto             readAtom = [&]() -> int {
+			char c = pattern[i++];
+			if (c == '[' && i < pattern.size() && (pattern[i] == ':' || pattern[i] == '.' || pattern[i] == '='))
+				return -1;
+			if (static_cast<std::uint8_t>(c) >= 0x80)
+				return -1;
+			if (c != '\\')
+				return static_cast<std::uint8_t>(c);
+			if (i >= pattern.size())
+				return -1;
+			if (AddClassEscape(set, pattern[i]))
+			{
+				++i;
+				return -2;
+			}
+			return GetEscapedByte(pattern, i++, true);
+		};
+
+		while (i < pattern.size() && pattern[i] != ']')
+		{
+			int first = readAtom();
+			if (first == -1)
+				return false;
+			if (first == -2)
+				continue;
+
+			if (i + 1 < pattern.size() && pattern[i] == '-' && pattern[i + 1] != ']')
+			{
+				++i;
+				int last = readAtom();
+				if (last < 0 || last < first)
+					return false;
+				AddRange(set, static_cast<std::uint8_t>(first), static_cast<std::uint8_t>(last));
+				continue;
+			}
+			set.set(static_cast<std::size_t>(first));
+		}
+		if (i >= pattern.size())
+			return false;
+		++i;
+
+		bytes = negated ? ~set : set;
+		return true;
+	}
+
+	// Whether the pattern has an alternation outside of any group or class
+	static bool HasTopLevelAlternation(std::string_view pattern)
+	{
+		std::size_t depth   = 0;
+		bool        inClass = false;
+		for (std::size_t i = 0; i < pattern.size(); ++i)
+		{
+			char c = pattern[i];
+			if (c == '\\')
+				++i;
+			else if (inClass)
+				inClass = c != ']';
+			else if (c == '[')
+				inClass = true;
+			else if (c == '(')
+				++depth;
+			else if (c == ')' && depth > 0)
+				--depth;
+			else if (c == '|' && depth == 0)
+				return true;
+		}
+		return false;
+	}
+
+	FirstSet FirstSet::Any()
+	{
+		FirstSet set;
+		set.m_Bytes.set();
+		set.m_Nullable = true;
+		return set;
+	}
+
+	FirstSet FirstSet::Regex(std::string_view pattern)
+	{
+		// Only a leading single character atom that has to match is looked at, anything else may start anywhere
+		if (pattern.empty() || HasTopLevelAlternation(pattern))
+			return Any();
+
+		FirstSet    set;
+		std::size_t i = 0;
+		switch (pattern[0])
+		{
+		case '[':
+			if (!ParseClass(pattern, i, set.m_Bytes))
+				return Any();
+			break;
+		case '\\':
+			if (pattern.size() < 2)
+				return Any();
+			if (!AddClassEscape(set.m_Bytes, pattern[1]))
+			{
+				int byte = GetEscapedByte(pattern, 1, false);
+				if (byte < 0)
+					return Any();
+				set.m_Bytes.set(static_cast<std::size_t>(byte));
+			}
+			i = 2;
+			break;
+		case '.':
+			set.m_Bytes.set();
+			i = 1;
+			break;
+		case '(': [[fallthrough]];
+		case ')': [[fallthrough]];
+		case '^': [[fallthrough]];
+		case '$': [[fallthrough]];
+		case '*': [[fallthrough]];
+		case '+': [[fallthrough]];
+		case '?': [[fallthrough]];
+		case '{': [[fallthrough]];
+		case '}': [[fallthrough]];
+		case '|': [[fallthrough]];
+		case ']': return Any();
+		default:
+			set.m_Bytes.set(static_cast<std::uint8_t>(pattern[0]));
+			i = 1;
+			break;
+		}
+
+		// A quantifier that allows zero matches lets the rest of the pattern start the match
+		if (i < pattern.size() && (pattern[i] == '*' || pattern[i] == '?' || pattern[i] == '{'))
+			return Any();
+		return set;
+	}
+
+	FirstSetAnalysis::FirstSetAnalysis(const Lexer& lexer)
+	    : m_RuleSets(lexer.getRuleCount())
+	{
+		// Every rule starts out matching nothing and the sets only grow, so recursive rules settle once no set changes
+		bool changed = true;
+		while (changed)
+		{
+			changed = false;
+			for (std::uint32_t ruleID = 0; ruleID < m_RuleSets.size(); ++ruleID)
+			{
+				auto     rule = lexer.getRule(ruleID);
+				FirstSet set  = rule->getKind() == EMatcherKind::MatcherRule ? getMatcherSet(*static_cast<const MatcherRule&>(*rule).getMatcher()) : FirstSet::Any();
+				if (!(set == m_RuleSets[ruleID]))
+				{
+					m_RuleSets[ruleID] = set;
+					changed            = true;
+				}
+			}
+		}
+	}
+
+	FirstSet FirstSetAnalysis::getMatcherSet(const IMatcher& matcher) const
+	{
+		switch (matcher.getKind())
+		{
+		case EMatcherKind::Combination:
+		{
+			FirstSet set;
+			set.m_Nullable = true;
+			for (auto& child : static_cast<const CombinationMatcher&>(matcher).getMatchers())
+			{
+				auto childSet = getMatcherSet(*child);
+				set.m_Bytes |= childSet.m_Bytes;
+				if (!childSet.m_Nullable)
+				{
+					set.m_Nullable = false;
+					break;
+				}
+			}
+			return set;
+		}
+		case EMatcherKind::Or:
+		{
+			FirstSet set;
+			for (auto& alternative : static_cast<const OrMatcher&>(matcher).getMatchers())
+				set |= getMatcherSet(*alternative);
+			return set;
+		}
+		case EMatcherKind::Range:
+		{
+			auto& range    = static_cast<const RangeMatcher&>(matcher);
+			auto  set      = getMatcherSet(*range.getMatcher());
+			set.m_Nullable = set.m_Nullable || range.getLowerBounds() == 0;
+			return set;
+		}
+		case EMatcherKind::Optional:
+		{
+			auto set       = getMatcherSet(*static_cast<const OptionalMatcher&>(matcher).getMatcher());
+			set.m_Nullable = true;
+			return set;
+		}
+		case EMatcherKind::Negative:
+		{
+			auto set       = getMatcherSet(*static_cast<const NegativeMatcher&>(matcher).getMatcher());
+			set.m_Nullable = true;
+			return set;
+		}
+		case EMatcherKind::Space:
+		{
+			// Forced spaces never fail, a missing space is only reported
+			auto& space = static_cast<const SpaceMatcher&>(matcher);
+			if (space.isForced())
+				return FirstSet::Any();
+
+			auto set = getMatcherSet(*space.getMatcher());
+			if (space.getDirection().contains(ESpaceDirection::Left) || set.m_Nullable)
+				AddBytes(set.m_Bytes, space.getMethod() == ESpaceMethod::Whitespace ? WhitespaceBytes : SpaceBytes);
+			return set;
+		}
+		case EMatcherKind::NamedGroup: return getMatcherSet(*static_cast<const NamedGroupMatcher&>(matcher).getMatcher());
+		case EMatcherKind::InlineRule: return getMatcherSet(*static_cast<const InlineRuleMatcher&>(matcher).getMatcher());
+		case EMatcherKind::SharedPrefix: return getMatcherSet(*static_cast<const SharedPrefixMatcher&>(matcher).getMatcher());
+		case EMatcherKind::Reference:
+		{
+			auto rule = static_cast<const ReferenceMatcher&>(matcher).getRule();
+			return rule && rule->getID() < m_RuleSets.size() ? m_RuleSets[rule->getID()] : FirstSet::Any();
+		}
+		case EMatcherKind::MatcherRule: [[fallthrough]];
+		case EMatcherKind::CallbackRule:
+		{
+			auto& rule = static_cast<const IRule&>(matcher);
+			return rule.getID() < m_RuleSets.size() ? m_RuleSets[rule.getID()] : FirstSet::Any();
+		}
+		case EMatcherKind::Text:
+		{
+			auto&    text = static_cast<const TextMatcher&>(matcher).getText();
+			FirstSet set;
+			set.m_Nullable = text.empty();
+			if (!text.empty())
+				set.m_Bytes.set(static_cast<std::uint8_t>(text[0]));
+			return set;
+		}
+		case EMatcherKind::Regex: return FirstSet::Regex(static_cast<const RegexMatcher&>(matcher).getProgram()->m_Pattern);
+		case EMatcherKind::NamedGroupReference: [[fallthrough]];
+		case EMatcherKind::Custom: [[fallthrough]];
+		default: return FirstSet::Any();
+		}
+	}
+} // namespace CommonLexer
\ No newline at end of file
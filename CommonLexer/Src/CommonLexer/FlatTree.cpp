@@ -0,0 +1,142 @@
+#include "CommonLexer/FlatTree.h"
+#include "CommonLexer/Node.h"
+
+#include <limits>
+#include <vector>
+
+namespace CommonLexer
+{
+	static constexpr std::size_t MaxFlatValue = std::numeric_limits<std::uint32_t>::max();
+
+	static bool CountNodes(const Node& node, std::size_t& count)
+	{
+		auto span = node.getSpan();
+		if (++count > MaxFlatValue || span.m_End.m_Index > MaxFlatValue)
+			return false;
+		for (auto& child : node.getChildren())
+			if (!CountNodes(child, count))
+				return false;
+		return true;
+	}
+
+	static std::uint32_t FlattenNode(const Node& node, std::uint32_t index, std::uint32_t* fields[FlatTree::FieldCount])
+	{
+		auto span        = node.getSpan();
+		fields[0][index] = node.getRule();
+		fields[1][index] = static_cast<std::uint32_t>(span.m_Start.m_Index);
+		fields[2][index] = static_cast<std::uint32_t>(span.m_End.m_Index);
+
+		std::uint32_t next = index + 1;
+		for (auto& child : node.getChildren())
+			next = FlattenNode(child, next, fields);
+		fields[3][index] = next;
+		return next;
+	}
+
+	FlatNode::ChildIterator& FlatNode::ChildIterator::operator++()
+	{
+		m_Index = m_Tree->getSubtreeEnd(m_Index);
+		return *this;
+	}
+
+	std::uint32_t FlatNode::getRule() const
+	{
+		return m_Tree->getRule(m_Index);
+	}
+
+	SourceSpan FlatNode::getSpan() const
+	{
+		return m_Tree->getSpan(m_Index);
+	}
+
+	bool FlatNode::hasChildren() const
+	{
+		return m_Tree->getSubtreeEnd(m_Index) > m_Index + 1;
+	}
+
+	FlatNode::ChildRange FlatNode::getChildren() const
+	{
+		return { { m_Tree, m_Index + 1 }, { m_Tree, m_Tree->getSubtreeEnd(m_Index) } };
+	}
+
+	std::size_t FlatNode::getChildCount() const
+	{
+		std::size_t count = 0;
+		for ([[maybe_unused]] auto child : getChildren())
+			++count;
+		return count;
+	}
+
+	std::optional<FlatNode> FlatNode::getChild(std::size_t index) const
+	{
+		for (auto child : getChildren())
+			if (index-- == 0)
+				return child;
+		return {};
+	}
+
+	FlatTree::FlatTree(std::span<const std::uint32_t> arena)
+	    : m_External(arena.data()), m_NodeCount(arena.size() / FieldCount) {}
+
+	bool FlatTree::build(const Node& root)
+	{
+		clear();
+
+		std::size_t count = 0;
+		if (!CountNodes(root, count))
+			return false;
+
+		m_Arena.resize(count * FieldCount);
+		std::uint32_t* fields[FieldCount];
+		for (std::size_t i = 0; i < FieldCount; ++i)
+			fields[i] = m_Arena.data() + i * count;
+		FlattenNode(root, 0, fields);
+		m_NodeCount = count;
+		return true;
+	}
+
+	void FlatTree::toNode(Node& node, std::uint32_t index) const
+	{
+		node.setRule(getRule(index));
+		node.setSourceSpan(getSpan(index));
+		for (auto child : getNode(index).getChildren())
+		{
+			Node childNode { node.getLex() };
+			toNode(childNode, child.getIndex());
+			node.addChild(std::move(childNode));
+		}
+	}
+
+	void FlatTree::clear()
+	{
+		m_Arena.clear();
+		m_External  = nullptr;
+		m_NodeCount = 0;
+	}
+
+	bool FlatTree::isValid() const
+	{
+		if (m_NodeCount > MaxFlatValue)
+			return false;
+
+		auto starts      = getStarts();
+		auto ends        = getEnds();
+		auto subtreeEnds = getSubtreeEnds();
+
+		// Ends of the subtrees enclosing the current node, innermost last
+		std::vector<std::uint32_t> enclosing;
+		for (std::uint32_t i = 0; i < m_NodeCount; ++i)
+		{
+			while (!enclosing.empty() && enclosing.back() == i)
+				enclosing.pop_back();
+
+			std::size_t limit = enclosing.empty() ? m_NodeCount : enclosing.back();
+			if (subtreeEnds[i] <= i || subtreeEnds[i] > limit || starts[i] > ends[i])
+				return false;
+			if (i == 0 && subtreeEnds[i] != m_NodeCount)
+				return false;
+			enclosing.push_back(subtreeEnds[i]);
+		}
+		return true;
+	}
+} // namespace CommonLexer
\ No newline at end of file
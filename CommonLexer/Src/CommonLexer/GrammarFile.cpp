@@ -0,0 +1,52 @@
+#include "CommonLexer/GrammarFile.h"
+#include "CommonLexer/GrammarReader.h"
+#include "CommonLexer/GrammarWriter.h"
+#include "CommonLexer/Lexer.h"
+#include "CommonLexer/MappedFile.h"
+
+#include <fstream>
+#include <utility>
+
+namespace CommonLexer
+{
+	bool WriteGrammar(const Lexer& lexer, std::vector<char>& data)
+	{
+		GrammarWriter writer;
+		writer.writeU32(GrammarFileMagic);
+		writer.writeU32(GrammarFileVersion);
+		if (!lexer.writeGrammar(writer))
+			return false;
+
+		data = std::move(writer).takeData();
+		return true;
+	}
+
+	bool WriteGrammarFile(const Lexer& lexer, const std::filesystem::path& filepath)
+	{
+		std::vector<char> data;
+		if (!WriteGrammar(lexer, data))
+			return false;
+
+		std::ofstream file { filepath, std::ios::binary | std::ios::trunc };
+		if (!file)
+			return false;
+		file.write(data.data(), static_cast<std::streamsize>(data.size()));
+		return static_cast<bool>(file);
+	}
+
+	bool ReadGrammar(Lexer& lexer, std::span<const char> data)
+	{
+		GrammarReader reader { data };
+		if (reader.readU32() != GrammarFileMagic || reader.readU32() != GrammarFileVersion || !reader.isValid())
+			return false;
+		return lexer.readGrammar(reader) && reader.isAtEnd();
+	}
+
+	bool ReadGrammarFile(Lexer& lexer, const std::filesystem::path& filepath)
+	{
+		MappedFile file;
+		if (!file.open(filepath, EMappedFileFlags::Sequential))
+			return false;
+		return ReadGrammar(lexer, { file.getData(), file.getSize() });
+	}
+} // namespace CommonLexer
\ No newline at end of file
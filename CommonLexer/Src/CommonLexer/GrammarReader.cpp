@@ -0,0 +1,60 @@
+#include "CommonLexer/GrammarReader.h"
+
+namespace CommonLexer
+{
+	std::uint8_t GrammarReader::readU8()
+	{
+		if (m_Offset >= m_Data.size())
+		{
+			m_Valid = false;
+			return 0;
+		}
+		return static_cast<std::uint8_t>(m_Data[m_Offset++]);
+	}
+
+	std::uint32_t GrammarReader::readU32()
+	{
+		std::uint32_t value = 0;
+		for (std::size_t i = 0; i < 4; ++i)
+			value |= std::uint32_t { readU8() } << (i * 8);
+		return value;
+	}
+
+	std::uint64_t GrammarReader::readU64()
+	{
+		std::uint64_t value = 0;
+		for (std::size_t i = 0; i < 8; ++i)
+			value |= std::uint64_t { readU8() } << (i * 8);
+		return value;
+	}
+
+	bool GrammarReader::readBool()
+	{
+		std::uint8_t value = readU8();
+		if (value > 1)
+			m_Valid = false;
+		return value == 1;
+	}
+
+	EMatcherKind GrammarReader::readKind()
+	{
+		std::uint8_t value = readU8();
+		if (value > static_cast<std::uint8_t>(EMatcherKind::ChoiceOr))
+			m_Valid = false;
+		return static_cast<EMatcherKind>(value);
+	}
+
+	std::string GrammarReader::readString()
+	{
+		std::uint64_t length = readU64();
+		if (!m_Valid || length > getRemaining())
+		{
+			m_Valid = false;
+			return {};
+		}
+
+		std::string value { m_Data.data() + m_Offset, static_cast<std::size_t>(length) };
+		m_Offset += static_cast<std::size_t>(length);
+		return value;
+	}
+} // namespace CommonLexer
\ No newline at end of file
@@ -0,0 +1,22 @@
+#include "CommonLexer/GrammarWriter.h"
+
+namespace CommonLexer
+{
+	void GrammarWriter::writeU32(std::uint32_t value)
+	{
+		for (std::size_t i = 0; i < 4; ++i)
+			writeU8(static_cast<std::uint8_t>(value >> (i * 8)));
+	}
+
+	void GrammarWriter::writeU64(std::uint64_t value)
+	{
+		for (std::size_t i = 0; i < 8; ++i)
+			writeU8(static_cast<std::uint8_t>(value >> (i * 8)));
+	}
+
+	void GrammarWriter::writeString(std::string_view value)
+	{
+		writeU64(value.size());
+		m_Data.insert(m_Data.end(), value.begin(), value.end());
+	}
+} // namespace CommonLexer
\ No newline at end of file
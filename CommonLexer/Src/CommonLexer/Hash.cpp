@@ -0,0 +1,68 @@
+#include "CommonLexer/Hash.h"
+
+#include <bit>
+
+namespace CommonLexer
+{
+	static constexpr std::uint64_t Prime1 = 0x9E3779B185EBCA87ULL;
+	static constexpr std::uint64_t Prime2 = 0xC2B2AE3D27D4EB4FULL;
+	static constexpr std::uint64_t Prime3 = 0x165667B19E3779F9ULL;
+
+	void Hasher::update(const void* data, std::size_t size)
+	{
+		auto bytes = static_cast<const char*>(data);
+		m_Length += size;
+
+		// Complete a word left over from the previous update first
+		while (m_WordBytes > 0 && size > 0)
+		{
+			m_Word |= std::uint64_t { static_cast<unsigned char>(*bytes++) } << (m_WordBytes * 8);
+			--size;
+			if (++m_WordBytes == 8)
+			{
+				mix(m_Word);
+				m_Word      = 0;
+				m_WordBytes = 0;
+			}
+		}
+
+		for (; size >= 8; bytes += 8, size -= 8)
+		{
+			// Assembled as little endian so the hash does not depend on the platform, compilers turn this into a single load
+			std::uint64_t word = 0;
+			for (std::size_t i = 0; i < 8; ++i)
+				word |= std::uint64_t { static_cast<unsigned char>(bytes[i]) } << (i * 8);
+			mix(word);
+		}
+
+		for (; size > 0; --size)
+			m_Word |= std::uint64_t { static_cast<unsigned char>(*bytes++) } << (m_WordBytes++ * 8);
+	}
+
+	std::uint64_t Hasher::finish() const
+	{
+		std::uint64_t state = m_State;
+		if (m_WordBytes > 0)
+			state = std::rotl(state ^ (m_Word * Prime1), 27) * Prime2 + Prime3;
+		state ^= m_Length * Prime3;
+
+		state ^= state >> 33;
+		state *= Prime2;
+		state ^= state >> 29;
+		state *= Prime3;
+		state ^= state >> 32;
+		return state;
+	}
+
+	void Hasher::mix(std::uint64_t word)
+	{
+		m_State = std::rotl(m_State ^ (std::rotl(word * Prime2, 31) * Prime1), 27) * Prime1 + Prime3;
+	}
+
+	std::uint64_t Hash(std::string_view data, std::uint64_t seed)
+	{
+		Hasher hasher { seed };
+		hasher.update(data);
+		return hasher.finish();
+	}
+} // namespace CommonLexer
\ No newline at end of file
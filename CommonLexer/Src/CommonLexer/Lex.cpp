@@ -1,5 +1,85 @@
 #include "CommonLexer/Lex.h"
+#include "CommonLexer/Source.h"
+
+#include <utility>
 
 namespace CommonLexer
 {
-}
\ No newline at end of file
+	// Node starts are ascending in preorder and node ends in postorder, ends are paired with the preorder index of their node
+	static void CollectNodePoints(const Node& node, std::vector<SourcePoint>& starts, std::vector<std::pair<SourcePoint, std::size_t>>& ends)
+	{
+		std::size_t index = starts.size();
+		starts.emplace_back(node.getSpan().m_Start);
+		for (auto& child : node.getChildren())
+			CollectNodePoints(child, starts, ends);
+		ends.emplace_back(node.getSpan().m_End, index);
+	}
+
+	Lex::Lex(Lex&& move) noexcept
+	    : m_Lexer(move.m_Lexer), m_Source(move.m_Source), m_Root(std::move(move.m_Root)), m_Messages(std::move(move.m_Messages)), m_Items(std::move(move.m_Items))
+	{
+		m_Root.setLex(*this);
+	}
+
+	Lex& Lex::operator=(Lex&& move) noexcept
+	{
+		if (this != &move)
+		{
+			m_Lexer    = move.m_Lexer;
+			m_Source   = move.m_Source;
+			m_Root     = std::move(move.m_Root);
+			m_Messages = std::move(move.m_Messages);
+			m_Items    = std::move(move.m_Items);
+			m_Root.setLex(*this);
+		}
+		return *this;
+	}
+
+	std::vector<NodeLocation> Lex::resolveNodeLocations(bool utf8Columns) const
+	{
+		if (!m_Source)
+			return {};
+
+		std::vector<SourcePoint>                         starts;
+		std::vector<std::pair<SourcePoint, std::size_t>> ends;
+		CollectNodePoints(m_Root, starts, ends);
+
+		// Merging the two ascending streams hands the source sorted points, so it resolves them in one sweep without sorting
+		std::vector<SourcePoint> points;
+		std::vector<std::size_t> targets;
+		points.reserve(starts.size() * 2);
+		targets.reserve(starts.size() * 2);
+		std::size_t start = 0;
+		std::size_t end   = 0;
+		while (start < starts.size() || end < ends.size())
+		{
+			if (end == ends.size() || (start < starts.size() && starts[start] <= ends[end].first))
+			{
+				points.push_back(starts[start]);
+				targets.push_back(start++ * 2);
+			}
+			else
+			{
+				points.push_back(ends[end].first);
+				targets.push_back(ends[end++].second * 2 + 1);
+			}
+		}
+
+		auto                      locations = m_Source->resolveLocations(points, utf8Columns);
+		std::vector<NodeLocation> nodeLocations(starts.size());
+		for (std::size_t i = 0; i < locations.size(); ++i)
+		{
+			auto& location = nodeLocations[targets[i] / 2];
+			(targets[i] % 2 == 0 ? location.m_Start : location.m_End) = locations[i];
+		}
+		return nodeLocations;
+	}
+
+	FlatTree Lex::flatten() const
+	{
+		FlatTree tree;
+		if (!tree.build(m_Root))
+			tree.clear();
+		return tree;
+	}
+} // namespace CommonLexer
\ No newline at end of file
@@ -0,0 +1,255 @@
+#include "CommonLexer/LexCache.h"
+#include "CommonLexer/GrammarWriter.h"
+#include "CommonLexer/Hash.h"
+#include "CommonLexer/LexFile.h"
+#include "CommonLexer/Lexer.h"
+#include "CommonLexer/Source.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <system_error>
+#include <thread>
+
+namespace CommonLexer
+{
+	static std::uint64_t HashSource(ISource* source)
+	{
+		static constexpr std::size_t BlockSize = 65536;
+
+		Hasher      hasher;
+		std::size_t size = source->getSize();
+		for (std::size_t index = 0; index < size;)
+		{
+			auto chunk = source->getChunk(index);
+			if (chunk.isContiguous() && chunk.contains(index, 0))
+			{
+				std::size_t length = std::min(chunk.getEnd(), size) - index;
+				hasher.update(chunk.m_Data.substr(index - chunk.m_Start, length));
+				index += length;
+			}
+			else
+			{
+				std::size_t length = std::min(BlockSize, size - index);
+				hasher.update(source->getSpan(index, length));
+				index += length;
+			}
+		}
+		return hasher.finish();
+	}
+
+	LexCache::LexCache(const Lexer& lexer, LexCacheOptions options)
+	    : m_Lexer(&lexer), m_Options(std::move(options)), m_Enabled(false), m_GrammarHash(0)
+	{
+		GrammarWriter writer;
+		if (lexer.writeGrammar(writer))
+		{
+			auto& data    = writer.getData();
+			m_GrammarHash = Hash({ data.data(), data.size() });
+			m_Enabled     = true;
+		}
+
+		if (!m_Options.m_Directory.empty())
+		{
+			std::error_code error;
+			std::filesystem::create_directories(m_Options.m_Directory, error);
+		}
+	}
+
+	Lex LexCache::lexSource(ISource* source)
+	{
+		if (!m_Enabled || !source)
+			return m_Lexer->lexSource(source);
+
+		// Loaded messages borrow from the literals, which only exist once the lexer is linked
+		m_Lexer->ensureFinalized();
+		auto key = getKey(source);
+		if (auto data = findMemory(key))
+		{
+			Lex lex { *m_Lexer, source };
+			if (loadLex(lex, *data))
+			{
+				{
+					std::lock_guard lock { m_Mutex };
+					++m_Stats.m_MemoryHits;
+				}
+				return lex;
+			}
+		}
+
+		if (auto data = loadDisk(key))
+		{
+			Lex lex { *m_Lexer, source };
+			if (loadLex(lex, *data))
+			{
+				{
+					std::lock_guard lock { m_Mutex };
+					++m_Stats.m_DiskHits;
+				}
+				insertMemory(key, std::move(data));
+				return lex;
+			}
+		}
+
+		{
+			std::lock_guard lock { m_Mutex };
+			++m_Stats.m_Misses;
+		}
+
+		auto lex  = m_Lexer->lexSource(source);
+		auto data = std::make_shared<std::vector<char>>();
+		if (WriteLex(lex, *data))
+		{
+			storeDisk(key, *data);
+			insertMemory(key, std::move(data));
+		}
+		return lex;
+	}
+
+	void LexCache::clear()
+	{
+		std::lock_guard lock { m_Mutex };
+		m_Entries.clear();
+		m_Index.clear();
+		m_Stats.m_Entries = 0;
+		m_Stats.m_Memory  = 0;
+	}
+
+	LexCacheKey LexCache::getKey(ISource* source) const
+	{
+		return { m_GrammarHash, HashSource(source), source->getSize() };
+	}
+
+	LexCacheStats LexCache::getStats() const
+	{
+		std::lock_guard lock { m_Mutex };
+		return m_Stats;
+	}
+
+	LexCache::Blob LexCache::findMemory(const LexCacheKey& key)
+	{
+		std::lock_guard lock { m_Mutex };
+		auto            itr = m_Index.find(key);
+		if (itr == m_Index.end())
+			return nullptr;
+
+		m_Entries.splice(m_Entries.begin(), m_Entries, itr->second);
+		return itr->second->m_Data;
+	}
+
+	void LexCache::insertMemory(const LexCacheKey& key, Blob data)
+	{
+		std::size_t size = data->size();
+		if (size > m_Options.m_MemoryLimit)
+			return;
+
+		std::lock_guard lock { m_Mutex };
+		if (m_Index.contains(key))
+			return;
+
+		while (!m_Entries.empty() && m_Stats.m_Memory + size > m_Options.m_MemoryLimit)
+		{
+			auto& entry = m_Entries.back();
+			m_Stats.m_Memory -= entry.m_Data->size();
+			--m_Stats.m_Entries;
+			++m_Stats.m_Evictions;
+			m_Index.erase(entry.m_Key);
+			m_Entries.pop_back();
+		}
+
+		m_Entries.push_front({ key, std::move(data) });
+		m_Index.insert({ key, m_Entries.begin() });
+		m_Stats.m_Memory += size;
+		++m_Stats.m_Entries;
+	}
+
+	LexCache::Blob LexCache::loadDisk(const LexCacheKey& key) const
+	{
+		if (m_Options.m_Directory.empty())
+			return nullptr;
+
+		std::ifstream file { getPath(key), std::ios::binary | std::ios::ate };
+		if (!file)
+			return nullptr;
+
+		auto size = file.tellg();
+		if (size < static_cast<std::streamoff>(sizeof(LexCacheFileHeader)))
+			return nullptr;
+
+		// Files of another version or key and corrupted files are misses, the lex then overwrites them
+		LexCacheFileHeader header {};
+		file.seekg(0);
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+		    header.m_Magic != LexCacheFileMagic ||
+		    header.m_Version != LexCacheFileVersion ||
+		    header.m_Key != key ||
+		    header.m_PayloadSize != static_cast<std::uint64_t>(size) - sizeof(header))
+			return nullptr;
+
+		auto data = std::make_shared<std::vector<char>>(static_cast<std::size_t>(header.m_PayloadSize));
+		if (!file.read(data->data(), static_cast<std::streamsize>(data->size())) ||
+		    Hash({ data->data(), data->size() }) != header.m_Checksum)
+			return nullptr;
+		return data;
+	}
+
+	void LexCache::storeDisk(const LexCacheKey& key, const std::vector<char>& data) const
+	{
+		if (m_Options.m_Directory.empty())
+			return;
+
+		// Written to a temporary file first, so other processes never see a partial lex file
+		auto path     = getPath(key);
+		auto nonce    = std::hash<std::thread::id> {}(std::this_thread::get_id()) ^ static_cast<std::size_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+		auto tempPath = path;
+		tempPath += fmt::format(".{:x}.tmp", nonce);
+		{
+			std::ofstream file { tempPath, std::ios::binary | std::ios::trunc };
+			if (!file)
+				return;
+			LexCacheFileHeader header { LexCacheFileMagic, LexCacheFileVersion, key, data.size(), Hash({ data.data(), data.size() }) };
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(data.data(), static_cast<std::streamsize>(data.size()));
+			if (!file)
+				return;
+		}
+
+		std::error_code error;
+		std::filesystem::rename(tempPath, path, error);
+		if (error)
+			std::filesystem::remove(tempPath, error);
+	}
+
+	bool LexCache::loadLex(Lex& lex, const std::vector<char>& data) const
+	{
+		LexView view;
+		if (!view.openMemory({ data.data(), data.size() }) || view.getSourceSize() != lex.getSource()->getSize() || view.getRuleCount() != m_Lexer->getRuleCount())
+			return false;
+
+		// Messages borrow their expected text from the lexer, so they stay valid once the data is evicted
+		std::vector<Message> messages;
+		messages.reserve(view.getMessageCount());
+		for (std::size_t i = 0; i < view.getMessageCount(); ++i)
+		{
+			auto message = view.getMessage(i, m_Lexer);
+			if (!message)
+				return false;
+			messages.push_back(std::move(*message));
+		}
+
+		auto& tree = view.getTree();
+		if (!tree.empty())
+			tree.toNode(lex.getRoot());
+		lex.setMessages(std::move(messages));
+		return true;
+	}
+
+	std::filesystem::path LexCache::getPath(const LexCacheKey& key) const
+	{
+		return m_Options.m_Directory / fmt::format("{:016x}{:016x}{:016x}.clex", key.m_Grammar, key.m_Source, key.m_Size);
+	}
+} // namespace CommonLexer
\ No newline at end of file
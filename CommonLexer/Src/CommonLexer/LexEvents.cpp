@@ -0,0 +1,21 @@
+#include "CommonLexer/LexEvents.h"
+
+namespace CommonLexer
+{
+	void EmitLexEvents(std::span<const StackNode> nodes, ILexEventSink& sink)
+	{
+		for (std::size_t i = 0; i < nodes.size(); i += nodes[i].m_SubtreeSize)
+		{
+			auto& node = nodes[i];
+			if (node.m_SubtreeSize == 1)
+			{
+				sink.token(node.m_Rule, node.m_Span);
+				continue;
+			}
+
+			sink.enterRule(node.m_Rule, node.m_Span.m_Start);
+			EmitLexEvents(nodes.subspan(i + 1, node.m_SubtreeSize - 1), sink);
+			sink.exitRule(node.m_Rule, node.m_Span);
+		}
+	}
+} // namespace CommonLexer
\ No newline at end of file
@@ -0,0 +1,266 @@
+#include "CommonLexer/LexFile.h"
+#include "CommonLexer/Lex.h"
+#include "CommonLexer/Lexer.h"
+#include "CommonLexer/Source.h"
+
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <utility>
+
+namespace CommonLexer
+{
+	static constexpr std::size_t LexFileAlignment = 8;
+
+	static std::size_t AlignSection(std::size_t offset)
+	{
+		return (offset + LexFileAlignment - 1) & ~(LexFileAlignment - 1);
+	}
+
+	template <class T>
+	static void WriteSection(std::vector<char>& data, std::size_t offset, const T* values, std::size_t count)
+	{
+		if (count > 0)
+			std::memcpy(data.data() + offset, values, count * sizeof(T));
+	}
+
+	static bool CountFits(std::size_t count)
+	{
+		return count <= std::numeric_limits<std::uint32_t>::max();
+	}
+
+	static bool AddString(std::string& strings, std::string_view string, std::uint32_t& offset, std::uint32_t& length)
+	{
+		if (strings.size() + string.size() > std::numeric_limits<std::uint32_t>::max())
+			return false;
+		offset = static_cast<std::uint32_t>(strings.size());
+		length = static_cast<std::uint32_t>(string.size());
+		strings.append(string);
+		return true;
+	}
+
+	static bool SectionFits(std::span<const char> data, std::uint64_t offset, std::uint64_t size)
+	{
+		return offset % LexFileAlignment == 0 && offset <= data.size() && size <= data.size() - offset;
+	}
+
+	static bool StringFits(const LexFileHeader& header, std::uint32_t offset, std::uint32_t length)
+	{
+		return offset <= header.m_StringsSize && length <= header.m_StringsSize - offset;
+	}
+
+	static bool MessageIsValid(const LexFileHeader& header, const LexFileMessage& message)
+	{
+		return message.m_Kind <= static_cast<std::uint8_t>(EMessageKind::MissingRule) &&
+		       message.m_Severity <= static_cast<std::uint8_t>(EMessageSeverity::Error) &&
+		       message.m_GotEOF <= 1 &&
+		       message.m_SpanStart <= message.m_SpanEnd &&
+		       StringFits(header, message.m_TextOffset, message.m_TextLength);
+	}
+
+	bool WriteLex(const Lex& lex, std::vector<char>& data)
+	{
+		FlatTree tree;
+		if (!tree.build(lex.getRoot()) || !CountFits(tree.getNodeCount()))
+			return false;
+
+		auto lexer = lex.getLexer();
+		if ((lexer && !CountFits(lexer->getRuleCount())) || !CountFits(lex.getMessages().size()))
+			return false;
+
+		std::string strings;
+
+		std::vector<LexFileRule> rules(lexer ? lexer->getRuleCount() : 0);
+		for (std::uint32_t i = 0; i < rules.size(); ++i)
+		{
+			auto rule = lexer->getRule(i);
+			if (!AddString(strings, rule ? std::string_view { rule->getName() } : std::string_view {}, rules[i].m_NameOffset, rules[i].m_NameLength))
+				return false;
+		}
+
+		auto&                       messages = lex.getMessages();
+		std::vector<LexFileMessage> fileMessages(messages.size());
+		for (std::size_t i = 0; i < messages.size(); ++i)
+		{
+			auto& message     = messages[i];
+			auto& fileMessage = fileMessages[i];
+			auto  span        = message.getSpan();
+			fileMessage       = { message.getPoint().m_Index, span.m_Start.m_Index, span.m_End.m_Index, message.getExpectedCount(), message.getGotCount(), message.getRuleID(), 0, 0, InvalidLiteral, 0, static_cast<std::uint8_t>(message.getKind()), static_cast<std::uint8_t>(message.getSeverity()), message.isGotEOF(), message.getGot() };
+
+			std::string      custom = message.getKind() == EMessageKind::Custom ? message.getMessage() : std::string {};
+			std::string_view text   = message.getKind() == EMessageKind::Custom ? std::string_view { custom } : message.getExpected();
+			if (!AddString(strings, text, fileMessage.m_TextOffset, fileMessage.m_TextLength))
+				return false;
+
+			if (message.getKind() != EMessageKind::Custom && !message.isExpectedOwned() && lexer)
+			{
+				if (auto literal = lexer->findLiteral(text))
+				{
+					fileMessage.m_Literal       = literal->m_Literal;
+					fileMessage.m_LiteralOffset = literal->m_Offset;
+				}
+			}
+		}
+
+		LexFileHeader header {};
+		header.m_Magic          = LexFileMagic;
+		header.m_Version        = LexFileVersion;
+		header.m_NodeCount      = static_cast<std::uint32_t>(tree.getNodeCount());
+		header.m_RuleCount      = static_cast<std::uint32_t>(rules.size());
+		header.m_MessageCount   = static_cast<std::uint32_t>(fileMessages.size());
+		header.m_SourceSize     = lex.getSource() ? lex.getSource()->getSize() : 0;
+		header.m_NodesOffset    = AlignSection(sizeof(LexFileHeader));
+		header.m_RulesOffset    = AlignSection(header.m_NodesOffset + tree.getArena().size_bytes());
+		header.m_MessagesOffset = AlignSection(header.m_RulesOffset + rules.size() * sizeof(LexFileRule));
+		header.m_StringsOffset  = AlignSection(header.m_MessagesOffset + fileMessages.size() * sizeof(LexFileMessage));
+		header.m_StringsSize    = strings.size();
+
+		data.assign(header.m_StringsOffset + header.m_StringsSize, '\0');
+		WriteSection(data, 0, &header, 1);
+		WriteSection(data, header.m_NodesOffset, tree.getArena().data(), tree.getArena().size());
+		WriteSection(data, header.m_RulesOffset, rules.data(), rules.size());
+		WriteSection(data, header.m_MessagesOffset, fileMessages.data(), fileMessages.size());
+		WriteSection(data, header.m_StringsOffset, strings.data(), strings.size());
+		return true;
+	}
+
+	bool WriteLexFile(const Lex& lex, const std::filesystem::path& filepath)
+	{
+		std::vector<char> data;
+		if (!WriteLex(lex, data))
+			return false;
+
+		std::ofstream file { filepath, std::ios::binary | std::ios::trunc };
+		if (!file)
+			return false;
+		file.write(data.data(), static_cast<std::streamsize>(data.size()));
+		return static_cast<bool>(file);
+	}
+
+	LexView::LexView(LexView&& move) noexcept
+	    : m_File(std::move(move.m_File)),
+	      m_Header(std::exchange(move.m_Header, nullptr)),
+	      m_Rules(std::exchange(move.m_Rules, nullptr)),
+	      m_Messages(std::exchange(move.m_Messages, nullptr)),
+	      m_Strings(std::exchange(move.m_Strings, nullptr)),
+	      m_Tree(std::exchange(move.m_Tree, {})) {}
+
+	LexView& LexView::operator=(LexView&& move) noexcept
+	{
+		if (this != &move)
+		{
+			m_File     = std::move(move.m_File);
+			m_Header   = std::exchange(move.m_Header, nullptr);
+			m_Rules    = std::exchange(move.m_Rules, nullptr);
+			m_Messages = std::exchange(move.m_Messages, nullptr);
+			m_Strings  = std::exchange(move.m_Strings, nullptr);
+			m_Tree     = std::exchange(move.m_Tree, {});
+		}
+		return *this;
+	}
+
+	bool LexView::open(const std::filesystem::path& filepath)
+	{
+		close();
+		if (!m_File.open(filepath, EMappedFileFlags::None))
+			return false;
+		if (openMemory({ m_File.getData(), m_File.getSize() }))
+			return true;
+		m_File.close();
+		return false;
+	}
+
+	bool LexView::openMemory(std::span<const char> data)
+	{
+		m_Header = nullptr;
+		m_Tree.clear();
+
+		if (data.size() < sizeof(LexFileHeader) || reinterpret_cast<std::uintptr_t>(data.data()) % LexFileAlignment != 0)
+			return false;
+
+		auto header = reinterpret_cast<const LexFileHeader*>(data.data());
+		if (header->m_Magic != LexFileMagic || header->m_Version != LexFileVersion)
+			return false;
+		if (!SectionFits(data, header->m_NodesOffset, std::uint64_t { header->m_NodeCount } * FlatTree::FieldCount * sizeof(std::uint32_t)) ||
+		    !SectionFits(data, header->m_RulesOffset, std::uint64_t { header->m_RuleCount } * sizeof(LexFileRule)) ||
+		    !SectionFits(data, header->m_MessagesOffset, std::uint64_t { header->m_MessageCount } * sizeof(LexFileMessage)) ||
+		    !SectionFits(data, header->m_StringsOffset, header->m_StringsSize))
+			return false;
+
+		auto rules    = reinterpret_cast<const LexFileRule*>(data.data() + header->m_RulesOffset);
+		auto messages = reinterpret_cast<const LexFileMessage*>(data.data() + header->m_MessagesOffset);
+		for (std::uint32_t i = 0; i < header->m_RuleCount; ++i)
+			if (!StringFits(*header, rules[i].m_NameOffset, rules[i].m_NameLength))
+				return false;
+		for (std::uint32_t i = 0; i < header->m_MessageCount; ++i)
+			if (!MessageIsValid(*header, messages[i]))
+				return false;
+
+		FlatTree tree { std::span<const std::uint32_t> { reinterpret_cast<const std::uint32_t*>(data.data() + header->m_NodesOffset), std::size_t { header->m_NodeCount } * FlatTree::FieldCount } };
+		if (!tree.isValid())
+			return false;
+
+		m_Header   = header;
+		m_Rules    = rules;
+		m_Messages = messages;
+		m_Strings  = data.data() + header->m_StringsOffset;
+		m_Tree     = std::move(tree);
+		return true;
+	}
+
+	void LexView::close()
+	{
+		m_Header   = nullptr;
+		m_Rules    = nullptr;
+		m_Messages = nullptr;
+		m_Strings  = nullptr;
+		m_Tree.clear();
+		m_File.close();
+	}
+
+	std::string_view LexView::getRuleName(std::uint32_t ruleID) const
+	{
+		if (!m_Header || ruleID >= m_Header->m_RuleCount)
+			return {};
+		auto& rule = m_Rules[ruleID];
+		return getString(rule.m_NameOffset, rule.m_NameLength);
+	}
+
+	std::optional<Message> LexView::getMessage(std::size_t index, const Lexer* lexer) const
+	{
+		if (!m_Header || index >= m_Header->m_MessageCount)
+			return {};
+
+		auto&      message  = m_Messages[index];
+		auto       kind     = static_cast<EMessageKind>(message.m_Kind);
+		auto       severity = static_cast<EMessageSeverity>(message.m_Severity);
+		auto       text     = getString(message.m_TextOffset, message.m_TextLength);
+		SourceSpan span { message.m_SpanStart, message.m_SpanEnd };
+
+		if (kind == EMessageKind::Custom)
+			return Message { std::string { text }, message.m_Point, span, message.m_RuleID, severity };
+		if (kind == EMessageKind::ExpectedMatches)
+			return Message { kind, message.m_ExpectedCount, message.m_GotCount, message.m_Point, span, message.m_RuleID, severity };
+
+		if (lexer && !text.empty())
+		{
+			// Text that no literal held when writing was owned by the message, so it is copied again
+			if (message.m_Literal == InvalidLiteral)
+			{
+				if (!message.m_GotEOF)
+					return Message { kind, std::string { text }, message.m_Got, message.m_Point, span, message.m_RuleID, severity };
+				return Message { kind, std::string { text }, message.m_Point, span, message.m_RuleID, severity };
+			}
+
+			auto literal = lexer->getLiteral(message.m_Literal);
+			if (message.m_LiteralOffset > literal.size() || literal.substr(message.m_LiteralOffset, text.size()) != text)
+				return {};
+			text = literal.substr(message.m_LiteralOffset, text.size());
+		}
+
+		if (!message.m_GotEOF)
+			return Message { kind, text, message.m_Got, message.m_Point, span, message.m_RuleID, severity };
+		return Message { kind, text, message.m_Point, span, message.m_RuleID, severity };
+	}
+} // namespace CommonLexer
\ No newline at end of file
@@ -0,0 +1,293 @@
+#include "CommonLexer/LexEvents.h"
+#include "CommonLexer/LexSession.h"
+#include "CommonLexer/Lexer.h"
+#include "CommonLexer/Source.h"
+
+#include <algorithm>
+#include <iterator>
+#include <tuple>
+
+namespace CommonLexer
+{
+	static void ReuseItem(Node& root, std::vector<Node>& previousChildren, LexItem&& item, std::ptrdiff_t offset, std::vector<LexItem>& items)
+	{
+		std::size_t firstChild = root.getChildren().size();
+		for (std::size_t i = 0; i < item.m_ChildCount; ++i)
+		{
+			auto& child = previousChildren[item.m_FirstChild + i];
+			if (offset != 0)
+				child.shift(offset);
+			root.addChild(std::move(child));
+		}
+
+		if (offset != 0)
+		{
+			for (auto& message : item.m_Messages)
+				message.shift(offset);
+			item.m_Span    = { item.m_Span.m_Start.m_Index + static_cast<std::size_t>(offset), item.m_Span.m_End.m_Index + static_cast<std::size_t>(offset) };
+			item.m_ReadEnd = item.m_ReadEnd.m_Index + static_cast<std::size_t>(offset);
+		}
+		item.m_FirstChild = firstChild;
+		items.push_back(std::move(item));
+	}
+
+	LexSession::LexSession(const Lexer& lexer)
+	    : m_Lexer(&lexer), m_Memo(lexer.getRuleCount(), lexer.getMemoLimit()) {}
+
+	Lex LexSession::lexSource(ISource* source)
+	{
+		return lexSource(source, source->getCompleteSpan());
+	}
+
+	Lex LexSession::lexSource(ISource* source, SourceSpan span)
+	{
+		Lex                  lex { *m_Lexer, source };
+		std::vector<Message> messages;
+		if (matchSource(&lex, source, span, messages))
+		{
+			auto& root = lex.getRoot();
+			root.setRule(m_Lexer->getMainRuleID());
+			m_Nodes.build(root);
+		}
+		lex.setMessages(std::move(messages));
+		return lex;
+	}
+
+	void LexSession::lexTokens(ISource* source, TokenStream& tokens, ETokenFilter filter)
+	{
+		lexTokens(source, source->getCompleteSpan(), tokens, filter);
+	}
+
+	void LexSession::lexTokens(ISource* source, SourceSpan span, TokenStream& tokens, ETokenFilter filter)
+	{
+		tokens.clear();
+		if (matchSource(nullptr, source, span, tokens.m_Messages))
+			AppendTokens(m_Nodes.getNodes(), filter, tokens.m_Tokens);
+	}
+
+	std::vector<Message> LexSession::lexEvents(ISource* source, ILexEventSink& sink)
+	{
+		return lexEvents(source, source->getCompleteSpan(), sink);
+	}
+
+	std::vector<Message> LexSession::lexEvents(ISource* source, SourceSpan span, ILexEventSink& sink)
+	{
+		std::vector<Message> messages;
+		if (matchSource(nullptr, source, span, messages, &sink))
+		{
+			EmitLexEvents(m_Nodes.getNodes(), sink);
+			m_Nodes.clear();
+		}
+		return messages;
+	}
+
+	bool LexSession::lexChunk(Lex& lex, ISource* source, SourceSpan span, SourcePoint start, SourcePoint end)
+	{
+		m_Lexer->ensureFinalized();
+		auto rule = m_Lexer->getRule(m_Lexer->getSplitRuleID());
+		if (!rule || !source)
+			return false;
+
+		bool memoize = m_Lexer->isMemoizing();
+		if (memoize)
+			m_Memo.reset(m_Lexer->getRuleCount());
+		m_Prefixes.clear();
+		m_Nodes.clear();
+
+		MatcherState       state { &lex, source, span, &m_Nodes, memoize ? &m_Memo : nullptr };
+		MatcherScopedState scopedState;
+		state.m_Prefixes = &m_Prefixes;
+		state.m_Choice   = m_Lexer->getChoice();
+
+		SourceSpan subSpan { start, span.m_End };
+		while (subSpan.m_Start < end)
+		{
+			auto result = rule->match(state, scopedState, subSpan);
+			if (result.m_Status != EMatchStatus::Success || result.m_Span.m_End == subSpan.m_Start || result.m_Span.m_End > end)
+				return false;
+			subSpan.m_Start = result.m_Span.m_End;
+		}
+		m_Nodes.build(lex.getRoot());
+		return true;
+	}
+
+	std::vector<ChoiceDivergence> LexSession::findChoiceDivergences(ISource* source)
+	{
+		return findChoiceDivergences(source, source->getCompleteSpan());
+	}
+
+	std::vector<ChoiceDivergence> LexSession::findChoiceDivergences(ISource* source, SourceSpan span)
+	{
+		std::vector<ChoiceDivergence> divergences;
+		std::vector<Message>          messages;
+		matchSource(nullptr, source, span, messages, nullptr, &divergences);
+		m_Nodes.clear();
+
+		// Backtracking can match the same or at the same point more than once
+		auto key = [](const ChoiceDivergence& divergence) { return std::tie(divergence.m_Point.m_Index, divergence.m_RuleID, divergence.m_FirstAlternative, divergence.m_LongestAlternative); };
+		std::stable_sort(divergences.begin(), divergences.end(), [&](const ChoiceDivergence& lhs, const ChoiceDivergence& rhs) { return key(lhs) < key(rhs); });
+		divergences.erase(std::unique(divergences.begin(), divergences.end(), [&](const ChoiceDivergence& lhs, const ChoiceDivergence& rhs) { return key(lhs) == key(rhs); }), divergences.end());
+		return divergences;
+	}
+
+	Lex LexSession::lexIncremental(ISource* source)
+	{
+		return relex(Lex { *m_Lexer, nullptr }, source, {});
+	}
+
+	Lex LexSession::relex(Lex&& previous, ISource* source, std::span<const TextEdit> edits)
+	{
+		m_Lexer->ensureFinalized();
+		auto rule = m_Lexer->getRule(m_Lexer->getSplitRuleID());
+		if (!rule || !source)
+			return lexSource(source);
+
+		// Old items and positions are only usable when they come from this lexer
+		std::vector<LexItem> previousItems;
+		if (previous.getLexer() == m_Lexer)
+			previousItems = std::move(previous.getItems());
+		auto& previousChildren = previous.getRoot().getChildren();
+
+		std::size_t    firstChange = ~0ULL;
+		std::size_t    lastChange  = 0;
+		std::ptrdiff_t offset      = 0;
+		for (auto& edit : edits)
+		{
+			firstChange = std::min(firstChange, edit.m_Start);
+			lastChange  = std::max(lastChange, edit.m_Start + edit.m_OldLength);
+			offset += static_cast<std::ptrdiff_t>(edit.m_NewLength) - static_cast<std::ptrdiff_t>(edit.m_OldLength);
+		}
+
+		Lex   lex { *m_Lexer, source };
+		auto& root = lex.getRoot();
+		auto  span = source->getCompleteSpan();
+		root.setRule(m_Lexer->getMainRuleID());
+
+		std::vector<LexItem> items;
+
+		// Items in front of the first edit stay as they are, as long as they did not look at the edited text
+		std::size_t next     = 0;
+		SourcePoint position = span.m_Start;
+		while (next < previousItems.size() && previousItems[next].m_ReadEnd <= firstChange)
+		{
+			position = previousItems[next].m_Span.m_End;
+			ReuseItem(root, previousChildren, std::move(previousItems[next++]), 0, items);
+		}
+
+		bool memoize = m_Lexer->isMemoizing();
+		if (memoize)
+			m_Memo.reset(m_Lexer->getRuleCount());
+		m_Prefixes.clear();
+
+		MatcherState state { &lex, source, span, &m_Nodes, memoize ? &m_Memo : nullptr };
+		state.m_ErrorReporting = m_Lexer->getErrorReporting();
+		state.m_Choice         = m_Lexer->getChoice();
+		state.m_Prefixes       = &m_Prefixes;
+		state.m_TrackReads     = true;
+
+		LexItem failedItem;
+		bool    complete = true;
+		while (position < span.m_End)
+		{
+			// Matching at a position only depends on the text from there on, so once an old item start behind the last edit is reached the rest can be reused
+			while (next < previousItems.size() && static_cast<std::ptrdiff_t>(previousItems[next].m_Span.m_Start.m_Index) + offset < static_cast<std::ptrdiff_t>(position.m_Index))
+				++next;
+			if (next < previousItems.size() && previousItems[next].m_Span.m_Start > lastChange && previousItems[next].m_Span.m_Start.m_Index + static_cast<std::size_t>(offset) == position)
+			{
+				for (; next < previousItems.size(); ++next)
+					ReuseItem(root, previousChildren, std::move(previousItems[next]), offset, items);
+				position = items.back().m_Span.m_End;
+				continue;
+			}
+
+			LexItem item;
+			auto    result = matchItem(state, rule, lex, { position, span.m_End }, item);
+			if (result.m_Status != EMatchStatus::Success || result.m_Span.m_End == position)
+			{
+				failedItem = std::move(item);
+				complete   = false;
+				break;
+			}
+			position = result.m_Span.m_End;
+			items.push_back(std::move(item));
+		}
+
+		// Messages are only kept for incomplete lexes, like the repetition in the main rule does
+		if (!complete)
+		{
+			if (state.m_ErrorReporting == EErrorReporting::FarthestFailure)
+			{
+				FarthestFailure farthestFailure;
+				for (auto& item : items)
+					for (auto& message : item.m_Messages)
+						farthestFailure.record(Message { message });
+				for (auto& message : failedItem.m_Messages)
+					farthestFailure.record(std::move(message));
+				lex.setMessages(std::move(farthestFailure.m_Expectations));
+			}
+			else
+			{
+				std::vector<Message> messages;
+				for (auto& item : items)
+					messages.insert(messages.end(), item.m_Messages.begin(), item.m_Messages.end());
+				messages.insert(messages.end(), std::make_move_iterator(failedItem.m_Messages.begin()), std::make_move_iterator(failedItem.m_Messages.end()));
+				lex.setMessages(std::move(messages));
+			}
+		}
+		lex.setItems(std::move(items));
+		return lex;
+	}
+
+	bool LexSession::matchSource(Lex* lex, ISource* source, SourceSpan span, std::vector<Message>& messages, ILexEventSink* sink, std::vector<ChoiceDivergence>* divergences)
+	{
+		m_Lexer->ensureFinalized();
+		auto rule = m_Lexer->getRule(m_Lexer->getMainRuleID());
+		if (!rule || !source)
+			return false;
+
+		bool memoize = m_Lexer->isMemoizing();
+		if (memoize)
+			m_Memo.reset(m_Lexer->getRuleCount());
+		m_Prefixes.clear();
+		m_Nodes.clear();
+
+		auto               errorReporting = m_Lexer->getErrorReporting();
+		MatcherState       state { lex, source, span, &m_Nodes, memoize ? &m_Memo : nullptr };
+		MatcherScopedState scopedState;
+		state.m_ErrorReporting    = errorReporting;
+		state.m_Choice            = m_Lexer->getChoice();
+		state.m_EventSink         = sink;
+		state.m_Prefixes          = &m_Prefixes;
+		state.m_ChoiceDivergences = divergences;
+
+		auto result = rule->match(state, scopedState, span);
+		if (errorReporting == EErrorReporting::FarthestFailure)
+		{
+			if (result.m_Status == EMatchStatus::Failure || result.m_Span.m_End < span.m_End)
+				messages = std::move(state.m_FarthestFailure.m_Expectations);
+		}
+		else
+		{
+			messages = std::move(scopedState.m_Messages);
+		}
+		return true;
+	}
+
+	MatchResult LexSession::matchItem(MatcherState& state, const IRule* rule, Lex& lex, SourceSpan span, LexItem& item)
+	{
+		MatcherScopedState scopedState;
+		item.m_FirstChild       = lex.getRoot().getChildren().size();
+		state.m_ReadEnd         = span.m_Start;
+		state.m_FarthestFailure = {};
+
+		m_Nodes.clear();
+		auto result = rule->match(state, scopedState, span);
+		m_Nodes.build(lex.getRoot());
+
+		item.m_Span       = { span.m_Start, result.m_Span.m_End };
+		item.m_ReadEnd    = state.m_ReadEnd;
+		item.m_ChildCount = lex.getRoot().getChildren().size() - item.m_FirstChild;
+		item.m_Messages   = state.m_ErrorReporting == EErrorReporting::FarthestFailure ? std::move(state.m_FarthestFailure.m_Expectations) : std::move(scopedState.m_Messages);
+		return result;
+	}
+} // namespace CommonLexer
\ No newline at end of file
@@ -1,67 +1,272 @@
 #include "CommonLexer/Lexer.h"
+#include "CommonLexer/GrammarReader.h"
+#include "CommonLexer/GrammarWriter.h"
+#include "CommonLexer/LexSession.h"
+#include "CommonLexer/Matchers.h"
+#include "CommonLexer/Rules.h"
 #include "CommonLexer/Source.h"
 
+#include <fmt/format.h>
+
+#include <cstdint>
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
 namespace CommonLexer
 {
 	Lexer::Lexer()
-	    : m_RNG(std::random_device {}()) {}
+	    : m_MainRuleID(InvalidRuleID), m_Memoization(false), m_MemoLimit(~0ULL), m_ErrorReporting(EErrorReporting::Accumulate), m_Choice(EChoice::Longest), m_SplitRuleID(InvalidRuleID), m_Finalized(false) {}
 
-	Lex Lexer::lexSource(ISource* source)
+	Lex Lexer::lexSource(ISource* source) const
 	{
 		return lexSource(source, source->getCompleteSpan());
 	}
 
-	Lex Lexer::lexSource(ISource* source, SourceSpan span)
+	Lex Lexer::lexSource(ISource* source, SourceSpan span) const
+	{
+		LexSession session { *this };
+		return session.lexSource(source, span);
+	}
+
+	void Lexer::lexTokens(ISource* source, TokenStream& tokens, ETokenFilter filter) const
+	{
+		lexTokens(source, source->getCompleteSpan(), tokens, filter);
+	}
+
+	void Lexer::lexTokens(ISource* source, SourceSpan span, TokenStream& tokens, ETokenFilter filter) const
 	{
-		Lex  lex { *this, source };
-		auto rule = getRule(m_MainRule);
-		if (rule && source)
+		LexSession session { *this };
+		session.lexTokens(source, span, tokens, filter);
+	}
+
+	bool Lexer::finalize()
+	{
+		m_FinalizeErrors.clear();
+
+		m_MainRuleID = getRuleID(m_MainRule);
+		if (m_MainRuleID == InvalidRuleID)
+			m_FinalizeErrors.push_back(fmt::format("Main rule '{}' does not exist", m_MainRule));
+
+		m_SplitRuleID = InvalidRuleID;
+		if (m_SplitOptions.isEnabled())
 		{
-			auto& root = lex.getRoot();
-			root.setRule(rule->getID());
+			m_SplitRuleID = getRuleID(m_SplitOptions.m_ItemRule);
+			if (m_SplitRuleID == InvalidRuleID)
+				m_FinalizeErrors.push_back(fmt::format("Split rule '{}' does not exist", m_SplitOptions.m_ItemRule));
+		}
+
+		linkRules(m_FinalizeErrors);
 
-			MatcherState       state { &lex, source, span };
-			MatcherScopedState scopedState { &root };
-			rule->match(state, scopedState, span);
+		// A memo replay adds the nodes, messages and reads of a match but not the named groups it set, and callbacks may depend on anything
+		OptimizeOptions options;
+		OptimizeStats   stats;
+		OptimizeState   state { *this, options, stats };
+		for (auto& rule : m_Rules)
+			rule->setReplayable(state.isStatelessRule(*rule));
+
+		m_Finalized.store(true, std::memory_order_release);
+		return m_FinalizeErrors.empty();
+	}
+
+	void Lexer::ensureFinalized() const
+	{
+		if (m_Finalized.load(std::memory_order_acquire))
+			return;
+
+		// Finalizing only resolves what the registered rules already describe, so to callers the lexer stays the same
+		std::lock_guard lock { m_FinalizeMutex };
+		if (!m_Finalized.load(std::memory_order_relaxed))
+			const_cast<Lexer*>(this)->finalize();
+	}
+
+	OptimizeStats Lexer::optimize(const OptimizeOptions& options)
+	{
+		if (!isFinalized())
+			finalize();
+
+		OptimizeStats stats;
+		OptimizeState state { *this, options, stats };
+		if (options.m_SharePrefixes)
+			state.findSharedPrefixes();
+		if (options.m_DispatchFirstBytes)
+			state.analyzeFirstSets();
+		for (auto& rule : m_Rules)
+			rule->optimize(state);
+
+		// Errors were already reported by finalize
+		std::vector<std::string> errors;
+		linkRules(errors);
+		return stats;
+	}
+
+	bool Lexer::writeGrammar(GrammarWriter& writer) const
+	{
+		writer.writeU32(static_cast<std::uint32_t>(m_Rules.size()));
+		for (auto& rule : m_Rules)
+		{
+			writer.writeString(rule->getName());
+			writer.writeBool(rule->isMemoized());
+			if (!rule->write(writer))
+				return false;
 		}
-		return lex;
+
+		writer.writeString(m_MainRule);
+		writer.writeBool(m_Memoization);
+		writer.writeU64(m_MemoLimit);
+		writer.writeU8(static_cast<std::uint8_t>(m_ErrorReporting));
+		writer.writeU8(static_cast<std::uint8_t>(m_Choice));
+
+		writer.writeString(m_SplitOptions.m_ItemRule);
+		writer.writeString(m_SplitOptions.m_OpenBrackets);
+		writer.writeString(m_SplitOptions.m_CloseBrackets);
+		writer.writeString(m_SplitOptions.m_Quotes);
+		writer.writeString(m_SplitOptions.m_LineComment);
+		writer.writeString(m_SplitOptions.m_Terminators);
+		writer.writeBool(m_SplitOptions.m_LineStart);
+		writer.writeU64(m_SplitOptions.m_MinChunkSize);
+		return true;
+	}
+
+	bool Lexer::readGrammar(GrammarReader& reader)
+	{
+		clearRules();
+
+		std::uint32_t ruleCount = reader.readU32();
+		m_Rules.reserve(std::min<std::size_t>(ruleCount, reader.getRemaining()));
+		m_RuleIDs.reserve(std::min<std::size_t>(ruleCount, reader.getRemaining()));
+		for (std::uint32_t i = 0; i < ruleCount && reader.isValid(); ++i)
+		{
+			std::string name       = reader.readString();
+			bool        memoized   = reader.readBool();
+			bool        createNode = reader.readBool();
+			auto        matcher    = ReadMatcher(reader);
+			if (!matcher)
+				break;
+
+			auto rule = std::make_unique<MatcherRule>(std::move(name), std::move(matcher), createNode);
+			rule->setMemoized(memoized);
+			registerRule(std::move(rule));
+		}
+
+		m_MainRule    = reader.readString();
+		m_Memoization = reader.readBool();
+		m_MemoLimit   = reader.readU64();
+
+		std::uint8_t errorReporting = reader.readU8();
+		if (errorReporting > static_cast<std::uint8_t>(EErrorReporting::FarthestFailure))
+			reader.fail();
+		m_ErrorReporting = static_cast<EErrorReporting>(errorReporting);
+
+		std::uint8_t choice = reader.readU8();
+		if (choice > static_cast<std::uint8_t>(EChoice::First))
+			reader.fail();
+		m_Choice = static_cast<EChoice>(choice);
+
+		m_SplitOptions.m_ItemRule      = reader.readString();
+		m_SplitOptions.m_OpenBrackets  = reader.readString();
+		m_SplitOptions.m_CloseBrackets = reader.readString();
+		m_SplitOptions.m_Quotes        = reader.readString();
+		m_SplitOptions.m_LineComment   = reader.readString();
+		m_SplitOptions.m_Terminators   = reader.readString();
+		m_SplitOptions.m_LineStart     = reader.readBool();
+		m_SplitOptions.m_MinChunkSize  = reader.readU64();
+
+		if (!reader.isValid())
+		{
+			clearRules();
+			return false;
+		}
+		return finalize();
 	}
 
 	void Lexer::registerRule(std::unique_ptr<IRule>&& rule)
 	{
-		auto id = newRuleID();
-		rule->setID(id);
-		m_Rules.insert({ id, std::move(rule) });
+		auto itr = m_RuleIDs.find(rule->getName());
+		if (itr != m_RuleIDs.end())
+		{
+			rule->setID(itr->second);
+			m_Rules[itr->second] = std::move(rule);
+		}
+		else
+		{
+			auto id = static_cast<std::uint32_t>(m_Rules.size());
+			rule->setID(id);
+			m_RuleIDs.insert({ rule->getName(), id });
+			m_Rules.push_back(std::move(rule));
+		}
+		m_Finalized.store(false, std::memory_order_relaxed);
+	}
+
+	void Lexer::clearRules()
+	{
+		m_Rules.clear();
+		m_RuleIDs.clear();
+		m_Finalized.store(false, std::memory_order_relaxed);
 	}
 
 	void Lexer::setMainRule(const std::string& rule)
 	{
 		m_MainRule = rule;
+		m_Finalized.store(false, std::memory_order_relaxed);
 	}
 
-	[[nodiscard]] std::uint32_t Lexer::getRuleID(const std::string& rule) const
+	void Lexer::setSplitOptions(const SplitOptions& splitOptions)
 	{
-		for (auto& r : m_Rules)
-		{
-			if (r.second->getName() == rule)
-				return r.first;
-		}
-		return 0;
+		m_SplitOptions = splitOptions;
+		m_Finalized.store(false, std::memory_order_relaxed);
 	}
 
-	[[nodiscard]] IRule* Lexer::getRule(std::uint32_t ruleID)
+	void Lexer::setMemoization(bool enabled, std::size_t memoryLimit)
 	{
-		auto itr = m_Rules.find(ruleID);
-		return itr != m_Rules.end() ? itr->second.get() : nullptr;
+		m_Memoization = enabled;
+		m_MemoLimit   = memoryLimit;
 	}
 
-	std::uint32_t Lexer::newRuleID()
+	void Lexer::setRuleMemoization(const std::string& rule, bool memoized)
 	{
-		std::uint32_t id = m_RNG();
+		auto id = getRuleID(rule);
+		if (id != InvalidRuleID)
+			m_Rules[id]->setMemoized(memoized);
+	}
 
-		while (id == 0 || m_Rules.find(id) != m_Rules.end())
-			id = m_RNG();
+	std::optional<LiteralReference> Lexer::findLiteral(std::string_view text) const
+	{
+		if (text.empty())
+			return std::nullopt;
+
+		// The last literal starting at or in front of text is the only one that can contain it
+		std::less<const char*> less;
+		auto                   itr = std::upper_bound(m_LiteralOrder.begin(), m_LiteralOrder.end(), text.data(), [&](const char* data, std::uint32_t literal) { return less(data, m_Literals[literal].data()); });
+		if (itr == m_LiteralOrder.begin())
+			return std::nullopt;
+
+		std::uint32_t literal = *std::prev(itr);
+		auto          offset  = reinterpret_cast<std::uintptr_t>(text.data()) - reinterpret_cast<std::uintptr_t>(m_Literals[literal].data());
+		if (offset > m_Literals[literal].size() || text.size() > m_Literals[literal].size() - offset)
+			return std::nullopt;
+		return LiteralReference { literal, static_cast<std::uint32_t>(offset) };
+	}
 
-		return id;
+	void Lexer::linkRules(std::vector<std::string>& errors)
+	{
+		m_Literals.clear();
+		for (auto& rule : m_Rules)
+		{
+			LinkState linkState { rule.get(), errors, m_Literals };
+			rule->link(*this, linkState);
+		}
+
+		m_LiteralOrder.resize(m_Literals.size());
+		for (std::uint32_t i = 0; i < m_LiteralOrder.size(); ++i)
+			m_LiteralOrder[i] = i;
+		std::sort(m_LiteralOrder.begin(), m_LiteralOrder.end(), [&](std::uint32_t lhs, std::uint32_t rhs) { return std::less<const char*> {}(m_Literals[lhs].data(), m_Literals[rhs].data()); });
+	}
+
+	[[nodiscard]] std::uint32_t Lexer::getRuleID(const std::string& rule) const
+	{
+		auto itr = m_RuleIDs.find(rule);
+		return itr != m_RuleIDs.end() ? itr->second : InvalidRuleID;
 	}
 } // namespace CommonLexer
\ No newline at end of file
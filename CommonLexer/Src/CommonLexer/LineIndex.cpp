@@ -0,0 +1,148 @@
+#include "CommonLexer/LineIndex.h"
+#include "CommonLexer/Build.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+#if BUILD_IS_PLATFORM_AMD64 || BUILD_IS_PLATFORM_X86
+	#define COMMON_LEXER_LINE_INDEX_SIMD 1
+	#include <immintrin.h>
+	#if BUILD_IS_TOOLSET_MSVC
+		#include <intrin.h>
+		#define COMMON_LEXER_TARGET_AVX2
+	#else
+		#define COMMON_LEXER_TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#else
+	#define COMMON_LEXER_LINE_INDEX_SIMD 0
+#endif
+
+namespace CommonLexer
+{
+	static void FindNewlinesScalar(const char* data, std::size_t offset, std::size_t size, std::vector<std::size_t>& lineStarts)
+	{
+		while (offset < size)
+		{
+			auto newline = static_cast<const char*>(std::memchr(data + offset, '\n', size - offset));
+			if (!newline)
+				break;
+			offset = static_cast<std::size_t>(newline - data) + 1;
+			lineStarts.emplace_back(offset);
+		}
+	}
+
+#if COMMON_LEXER_LINE_INDEX_SIMD
+	static std::size_t FindNewlinesSSE2(const char* data, std::size_t size, std::vector<std::size_t>& lineStarts)
+	{
+		const __m128i newline = _mm_set1_epi8('\n');
+
+		std::size_t i = 0;
+		for (; i + 16 <= size; i += 16)
+		{
+			__m128i       chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+			std::uint32_t mask  = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)));
+			while (mask)
+			{
+				lineStarts.emplace_back(i + std::countr_zero(mask) + 1);
+				mask &= mask - 1;
+			}
+		}
+		return i;
+	}
+
+	COMMON_LEXER_TARGET_AVX2 static std::size_t FindNewlinesAVX2(const char* data, std::size_t size, std::vector<std::size_t>& lineStarts)
+	{
+		const __m256i newline = _mm256_set1_epi8('\n');
+
+		std::size_t i = 0;
+		for (; i + 32 <= size; i += 32)
+		{
+			__m256i       chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+			std::uint32_t mask  = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline)));
+			while (mask)
+			{
+				lineStarts.emplace_back(i + std::countr_zero(mask) + 1);
+				mask &= mask - 1;
+			}
+		}
+		return i;
+	}
+
+	static bool HasAVX2()
+	{
+	#if BUILD_IS_TOOLSET_MSVC
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+	#else
+		return __builtin_cpu_supports("avx2");
+	#endif
+	}
+#endif
+
+	void LineIndex::build(std::string_view str)
+	{
+		m_LineToIndex.clear();
+
+		// Rough guess of 40 characters per line to avoid most reallocations
+		m_LineToIndex.reserve(str.size() / 40 + 1);
+		m_LineToIndex.emplace_back(0);
+
+		const char* data   = str.data();
+		std::size_t offset = 0;
+#if COMMON_LEXER_LINE_INDEX_SIMD
+		static const bool s_HasAVX2 = HasAVX2();
+		if (s_HasAVX2)
+			offset = FindNewlinesAVX2(data, str.size(), m_LineToIndex);
+		else
+			offset = FindNewlinesSSE2(data, str.size(), m_LineToIndex);
+#endif
+		FindNewlinesScalar(data, offset, str.size(), m_LineToIndex);
+	}
+
+	void LineIndex::clear()
+	{
+		m_LineToIndex.clear();
+	}
+
+	std::size_t LineIndex::getLineFromIndex(std::size_t index) const
+	{
+		auto itr = std::upper_bound(m_LineToIndex.begin(), m_LineToIndex.end(), index);
+		if (itr == m_LineToIndex.begin())
+			return ~0ULL;
+		return static_cast<std::size_t>(itr - m_LineToIndex.begin());
+	}
+
+	std::size_t LineIndex::getLineFromIndex(std::size_t index, std::size_t& cursor) const
+	{
+		std::size_t lines = m_LineToIndex.size();
+
+		// Check the last hit and its following line before falling back to a binary search
+		for (std::size_t line = cursor, end = std::min(cursor + 2, lines); line < end; ++line)
+		{
+			if (m_LineToIndex[line] <= index && (line + 1 == lines || index < m_LineToIndex[line + 1]))
+			{
+				cursor = line;
+				return line + 1;
+			}
+		}
+
+		std::size_t line = getLineFromIndex(index);
+		if (line != ~0ULL)
+			cursor = line - 1;
+		return line;
+	}
+
+	std::size_t LineIndex::getColumnFromIndex(std::size_t index) const
+	{
+		std::size_t line = getLineFromIndex(index);
+		if (line == ~0ULL)
+			return 1;
+		return index - m_LineToIndex[line - 1] + 1;
+	}
+} // namespace CommonLexer
\ No newline at end of file
@@ -0,0 +1,164 @@
+#include "CommonLexer/MappedFile.h"
+#include "CommonLexer/Build.h"
+
+#if BUILD_IS_SYSTEM_WINDOWS
+	#include <Windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+#include <utility>
+
+namespace CommonLexer
+{
+	MappedFile::MappedFile()
+	    : m_Open(false), m_Data(nullptr), m_Size(0), m_FileHandle(nullptr), m_MappingHandle(nullptr) {}
+
+	MappedFile::MappedFile(const std::filesystem::path& filepath, MappedFileFlags flags)
+	    : m_Open(false), m_Data(nullptr), m_Size(0), m_FileHandle(nullptr), m_MappingHandle(nullptr)
+	{
+		open(filepath, flags);
+	}
+
+	MappedFile::MappedFile(MappedFile&& move) noexcept
+	    : m_Open(move.m_Open), m_Data(move.m_Data), m_Size(move.m_Size), m_FileHandle(move.m_FileHandle), m_MappingHandle(move.m_MappingHandle)
+	{
+		move.m_Open          = false;
+		move.m_Data          = nullptr;
+		move.m_Size          = 0;
+		move.m_FileHandle    = nullptr;
+		move.m_MappingHandle = nullptr;
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile&& move) noexcept
+	{
+		if (this != &move)
+		{
+			close();
+			m_Open          = std::exchange(move.m_Open, false);
+			m_Data          = std::exchange(move.m_Data, nullptr);
+			m_Size          = std::exchange(move.m_Size, 0);
+			m_FileHandle    = std::exchange(move.m_FileHandle, nullptr);
+			m_MappingHandle = std::exchange(move.m_MappingHandle, nullptr);
+		}
+		return *this;
+	}
+
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+#if BUILD_IS_SYSTEM_WINDOWS
+	bool MappedFile::open(const std::filesystem::path& filepath, MappedFileFlags flags)
+	{
+		close();
+
+		DWORD  fileFlags = flags.contains(EMappedFileFlags::Sequential) ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_ATTRIBUTE_NORMAL;
+		HANDLE file      = CreateFileW(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, fileFlags, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size))
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		m_FileHandle = file;
+		m_Size       = static_cast<std::size_t>(size.QuadPart);
+		m_Open       = true;
+		if (m_Size == 0)
+			return true;
+
+		// Large pages are only available for pagefile backed sections, so the flag is ignored here
+		HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping)
+		{
+			close();
+			return false;
+		}
+		m_MappingHandle = mapping;
+
+		m_Data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (!m_Data)
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (m_Data)
+			UnmapViewOfFile(m_Data);
+		if (m_MappingHandle)
+			CloseHandle(m_MappingHandle);
+		if (m_FileHandle)
+			CloseHandle(m_FileHandle);
+		m_Open          = false;
+		m_Data          = nullptr;
+		m_Size          = 0;
+		m_FileHandle    = nullptr;
+		m_MappingHandle = nullptr;
+	}
+#else
+	bool MappedFile::open(const std::filesystem::path& filepath, MappedFileFlags flags)
+	{
+		close();
+
+		int fd = ::open(filepath.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat st;
+		if (fstat(fd, &st) != 0)
+		{
+			::close(fd);
+			return false;
+		}
+
+		m_Size = static_cast<std::size_t>(st.st_size);
+		m_Open = true;
+		if (m_Size == 0)
+		{
+			::close(fd);
+			return true;
+		}
+
+		void* data = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, fd, 0);
+		// The mapping keeps its own reference to the file, so the descriptor is not needed anymore
+		::close(fd);
+		if (data == MAP_FAILED)
+		{
+			m_Open = false;
+			m_Size = 0;
+			return false;
+		}
+
+		if (flags.contains(EMappedFileFlags::Sequential))
+			madvise(data, m_Size, MADV_SEQUENTIAL);
+	#if BUILD_IS_SYSTEM_LINUX
+		if (flags.contains(EMappedFileFlags::HugePages))
+			madvise(data, m_Size, MADV_HUGEPAGE);
+	#endif
+
+		m_Data = static_cast<const char*>(data);
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (m_Data)
+			munmap(const_cast<char*>(m_Data), m_Size);
+		m_Open = false;
+		m_Data = nullptr;
+		m_Size = 0;
+	}
+#endif
+} // namespace CommonLexer
\ No newline at end of file
@@ -1,13 +1,55 @@
 #include "CommonLexer/Matcher.h"
+#include "CommonLexer/LexEvents.h"
+#include "CommonLexer/Memo.h"
+#include "CommonLexer/NodeStack.h"
 
 namespace CommonLexer
 {
-	void MatcherState::setCurrentRule(IRule* rule, SourcePoint begin)
+	void MatcherState::setCurrentRule(const IRule* rule, SourcePoint begin)
 	{
 		m_CurrentRule = rule;
 		m_RuleBegin   = begin;
 	}
 
+	void MatcherState::commitNodes(SourcePoint point)
+	{
+		if (!m_EventSink || m_Speculation > 0)
+			return;
+
+		EmitLexEvents(m_Nodes->getNodes(), *m_EventSink);
+		m_Nodes->clear();
+		// Matching never goes back in front of a commit, entries from point on may still be replayed
+		if (m_Memo)
+			m_Memo->evictBefore(point);
+	}
+
+	void FarthestFailure::record(Message&& message)
+	{
+		auto point = message.getPoint();
+		if (point < m_Point)
+			return;
+
+		if (point > m_Point)
+		{
+			m_Point = point;
+			m_Expectations.clear();
+		}
+
+		// Expectations are a set, the same expectation reached through different rules is only kept once
+		for (auto& expectation : m_Expectations)
+		{
+			if (expectation.getKind() == message.getKind() &&
+			    expectation.getExpected() == message.getExpected() &&
+			    expectation.isGotEOF() == message.isGotEOF() &&
+			    expectation.getGot() == message.getGot() &&
+			    expectation.getExpectedCount() == message.getExpectedCount() &&
+			    expectation.getGotCount() == message.getGotCount() &&
+			    (message.getKind() != EMessageKind::Custom || expectation.getMessage() == message.getMessage()))
+				return;
+		}
+		m_Expectations.push_back(std::move(message));
+	}
+
 	void MatcherState::setGroupedValue(const std::string& name, SourceSpan span)
 	{
 		m_GroupedValues.insert_or_assign(name, span);
@@ -1,21 +1,48 @@
 #include "CommonLexer/Matchers.h"
+#include "CommonLexer/GrammarReader.h"
+#include "CommonLexer/GrammarWriter.h"
 #include "CommonLexer/Lex.h"
 #include "CommonLexer/Lexer.h"
-#include "CommonLexer/Node.h"
+#include "CommonLexer/Memo.h"
+#include "CommonLexer/NodeStack.h"
+#include "CommonLexer/Optimizer.h"
+#include "CommonLexer/RegexSyntax.h"
 #include "CommonLexer/Rule.h"
+#include "CommonLexer/Source.h"
 
 #include <fmt/format.h>
 
+#include <algorithm>
+#include <iterator>
+#include <string_view>
+#include <utility>
+
 namespace CommonLexer
 {
+	static bool CloneMatchers(const std::vector<std::unique_ptr<IMatcher>>& matchers, std::vector<std::unique_ptr<IMatcher>>& clones)
+	{
+		clones.reserve(matchers.size());
+		for (auto& matcher : matchers)
+		{
+			auto clone = matcher->clone();
+			if (!clone)
+				return false;
+			clones.push_back(std::move(clone));
+		}
+		return true;
+	}
+
 	CombinationMatcher::CombinationMatcher(std::vector<std::unique_ptr<IMatcher>>&& matchers)
 	    : m_Matchers(std::move(matchers)) {}
 
 	CombinationMatcher::CombinationMatcher(CombinationMatcher&& move) noexcept
-	    : m_Matchers(std::move(move.m_Matchers)) {}
+	    : m_Matchers(std::move(move.m_Matchers)), m_Flags(std::move(move.m_Flags)) {}
 
-	MatchResult CombinationMatcher::match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span)
+	MatchResult CombinationMatcher::match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const
 	{
+		if (!m_Flags.empty())
+			return matchGroups(state, scopedState, span);
+
 		SourceSpan subSpan { span };
 		SourceSpan totalSpan { span.m_Start, span.m_Start };
 		for (auto& matcher : m_Matchers)
@@ -34,32 +61,269 @@ namespace CommonLexer
 		return { EMatchStatus::Success, totalSpan };
 	}
 
+	void CombinationMatcher::link(const Lexer& lexer, LinkState& linkState)
+	{
+		for (auto& matcher : m_Matchers)
+			matcher->link(lexer, linkState);
+	}
+
+	bool CombinationMatcher::write(GrammarWriter& writer) const
+	{
+		if (!m_Flags.empty())
+			return writeGroups(writer);
+
+		writer.writeKind(EMatcherKind::Combination);
+		writer.writeU32(static_cast<std::uint32_t>(m_Matchers.size()));
+		for (auto& matcher : m_Matchers)
+			if (!matcher->write(writer))
+				return false;
+		return true;
+	}
+
+	std::unique_ptr<IMatcher> CombinationMatcher::optimize(OptimizeState& state)
+	{
+		for (auto& matcher : m_Matchers)
+			state.optimize(matcher);
+		if (!m_Matchers.empty())
+			state.sharePrefix(m_Matchers.front());
+
+		auto& options = state.m_Options;
+		bool  changed = false;
+		for (std::size_t i = 0; i < m_Matchers.size() && !changed; ++i)
+		{
+			auto kind = m_Matchers[i]->getKind();
+			changed   = (options.m_Flatten && kind == EMatcherKind::Combination) || (options.m_FuseTexts && kind == EMatcherKind::Text && i > 0 && m_Matchers[i - 1]->getKind() == EMatcherKind::Text);
+		}
+		if (!changed)
+			return nullptr;
+
+		std::vector<std::unique_ptr<IMatcher>> matchers;
+		std::vector<std::uint8_t>              flags;
+		for (std::size_t i = 0; i < m_Matchers.size(); ++i)
+		{
+			auto&        matcher = m_Matchers[i];
+			std::uint8_t flag    = m_Flags.empty() ? static_cast<std::uint8_t>(GroupStart) : m_Flags[i];
+			if (!options.m_Flatten || matcher->getKind() != EMatcherKind::Combination)
+			{
+				matchers.push_back(std::move(matcher));
+				flags.push_back(flag);
+				continue;
+			}
+
+			// The groups of the nested combination don't matter here, the whole nested combination is one group
+			auto& nested = static_cast<CombinationMatcher&>(*matcher);
+			for (std::size_t j = 0; j < nested.m_Matchers.size(); ++j)
+			{
+				std::uint8_t nestedFlag = j == 0 ? flag & GroupStart : 0;
+				if (!nested.m_Flags.empty() && (nested.m_Flags[j] & FusedText))
+				{
+					static_cast<TextMatcher&>(*nested.m_Matchers[j]).setGroupStart(nestedFlag & GroupStart);
+					nestedFlag |= FusedText;
+				}
+				matchers.push_back(std::move(nested.m_Matchers[j]));
+				flags.push_back(nestedFlag);
+			}
+			++state.m_Stats.m_FlattenedMatchers;
+		}
+
+		m_Matchers.clear();
+		m_Flags.clear();
+		for (std::size_t i = 0; i < matchers.size(); ++i)
+		{
+			if (options.m_FuseTexts && !m_Matchers.empty() && matchers[i]->getKind() == EMatcherKind::Text && m_Matchers.back()->getKind() == EMatcherKind::Text)
+			{
+				auto& text = static_cast<TextMatcher&>(*m_Matchers.back());
+				text.fuse(static_cast<const TextMatcher&>(*matchers[i]), m_Flags.back() & GroupStart, flags[i] & GroupStart);
+				m_Flags.back() |= FusedText;
+				++state.m_Stats.m_FusedTexts;
+				continue;
+			}
+			m_Matchers.push_back(std::move(matchers[i]));
+			m_Flags.push_back(flags[i]);
+		}
+		return nullptr;
+	}
+
+	std::unique_ptr<IMatcher> CombinationMatcher::clone() const
+	{
+		std::vector<std::unique_ptr<IMatcher>> matchers;
+		if (!CloneMatchers(m_Matchers, matchers))
+			return nullptr;
+		auto combination     = std::make_unique<CombinationMatcher>(std::move(matchers));
+		combination->m_Flags = m_Flags;
+		return combination;
+	}
+
+	MatchResult CombinationMatcher::matchGroups(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const
+	{
+		SourceSpan  subSpan { span };
+		SourceSpan  totalSpan { span.m_Start, span.m_Start };
+		SourcePoint groupEnd { span.m_Start };
+		for (std::size_t i = 0; i < m_Matchers.size(); ++i)
+		{
+			if (m_Flags[i] & GroupStart)
+				groupEnd = totalSpan.m_End;
+
+			auto result = m_Matchers[i]->match(state, scopedState, subSpan);
+			switch (result.m_Status)
+			{
+			case EMatchStatus::Success:
+				subSpan.m_Start = totalSpan.m_End = result.m_Span.m_End;
+				break;
+			case EMatchStatus::Skip: continue;
+			case EMatchStatus::Failure: [[fallthrough]];
+			default:
+				// A fused text fails in one of the texts it was made from, which may have started a group of its own
+				if (m_Flags[i] & FusedText)
+				{
+					std::size_t groupStart = static_cast<const TextMatcher&>(*m_Matchers[i]).getGroupStart(result.m_Span.m_End.m_Index - subSpan.m_Start.m_Index);
+					if (groupStart != TextMatcher::NoGroupStart)
+						groupEnd = subSpan.m_Start + groupStart;
+				}
+				return { EMatchStatus::Failure, { span.m_Start, groupEnd } };
+			}
+		}
+		return { EMatchStatus::Success, totalSpan };
+	}
+
+	bool CombinationMatcher::writeGroups(GrammarWriter& writer) const
+	{
+		// Written as the nested combinations and texts the combination was optimized from
+		struct Element
+		{
+		public:
+			const IMatcher*  m_Matcher;
+			std::string_view m_Text;
+			bool             m_GroupStart;
+		};
+
+		std::vector<Element> elements;
+		for (std::size_t i = 0; i < m_Matchers.size(); ++i)
+		{
+			if (!(m_Flags[i] & FusedText))
+			{
+				elements.push_back({ m_Matchers[i].get(), {}, (m_Flags[i] & GroupStart) != 0 });
+				continue;
+			}
+
+			auto&       text  = static_cast<const TextMatcher&>(*m_Matchers[i]);
+			std::size_t start = 0;
+			for (auto& segment : text.getSegments())
+			{
+				elements.push_back({ nullptr, std::string_view { text.getText() }.substr(start, segment.m_End - start), segment.m_GroupStart });
+				start = segment.m_End;
+			}
+		}
+
+		std::vector<std::size_t> groups;
+		for (std::size_t i = 0; i < elements.size(); ++i)
+			if (i == 0 || elements[i].m_GroupStart)
+				groups.push_back(i);
+
+		auto writeElement = [&](const Element& element) {
+			if (element.m_Matcher)
+				return element.m_Matcher->write(writer);
+			writer.writeKind(EMatcherKind::Text);
+			writer.writeString(element.m_Text);
+			return true;
+		};
+
+		writer.writeKind(EMatcherKind::Combination);
+		writer.writeU32(static_cast<std::uint32_t>(groups.size()));
+		for (std::size_t i = 0; i < groups.size(); ++i)
+		{
+			std::size_t begin = groups[i];
+			std::size_t end   = i + 1 < groups.size() ? groups[i + 1] : elements.size();
+			if (end - begin > 1)
+			{
+				writer.writeKind(EMatcherKind::Combination);
+				writer.writeU32(static_cast<std::uint32_t>(end - begin));
+			}
+			for (std::size_t j = begin; j < end; ++j)
+				if (!writeElement(elements[j]))
+					return false;
+		}
+		return true;
+	}
+
 	OrMatcher::OrMatcher(std::vector<std::unique_ptr<IMatcher>>&& matchers)
 	    : m_Matchers(std::move(matchers)) {}
 
 	OrMatcher::OrMatcher(OrMatcher&& move) noexcept
-	    : m_Matchers(std::move(move.m_Matchers)) {}
+	    : m_Matchers(std::move(move.m_Matchers)), m_Dispatch(std::move(move.m_Dispatch)), m_Choice(move.m_Choice) {}
 
-	MatchResult OrMatcher::match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span)
+	MatchResult OrMatcher::match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const
 	{
-		std::vector<Message> messages;
+		// Alternatives left out by the dispatch table fail at the span start after reading the byte there, so only their messages are unknown
+		std::uint64_t candidates = ~0ULL;
+		bool          dispatched = !m_Dispatch.empty() && span.length() > 0;
+		if (dispatched)
+		{
+			std::string      fallback;
+			std::string_view text = state.m_Source->getSpanView(span.m_Start, 1, fallback);
+			state.markRead(span.m_Start.m_Index + 1);
+			candidates = m_Dispatch[static_cast<std::uint8_t>(text[0])];
+		}
 
-		Node        bestNode { *state.m_Lex };
+		std::vector<Message> messages;
+		// The left out alternative whose messages are the best ones so far, they are only matched when nothing replaces them
+		std::size_t  leftOut = m_Matchers.size();
+		const IRule* leftOutRule { nullptr };
+		SourcePoint  leftOutRuleBegin;
+
+		// The nodes of the best alternative so far are kept in [checkpoint, bestEnd), every other alternative is rolled back
+		auto&       nodes      = *state.m_Nodes;
+		std::size_t checkpoint = nodes.checkpoint();
+		std::size_t bestEnd    = checkpoint;
 		MatchResult bestResult { EMatchStatus::Failure, { span.m_Start, span.m_Start } };
 
-		for (auto& matcher : m_Matchers)
+		// The first success is only tracked to report where the choices differ
+		EChoice       choice     = m_Choice ? *m_Choice : state.m_Choice;
+		std::uint32_t ruleID     = state.m_ChoiceDivergences ? state.m_CurrentRule->getID() : InvalidRuleID;
+		std::size_t   bestIndex  = m_Matchers.size();
+		std::size_t   firstIndex = m_Matchers.size();
+		SourceSpan    firstSpan { span.m_Start, span.m_Start };
+
+		++state.m_Speculation;
+		for (std::size_t i = 0; i < m_Matchers.size(); ++i)
 		{
-			Node               tempNode { *state.m_Lex };
-			MatcherScopedState newScopedState { &tempNode };
-			auto               result = matcher->match(state, newScopedState, span);
+			// The farthest failure keeps the expectations at the span start until a failure gets past it
+			if (dispatched && !(candidates >> i & 1) && (state.m_ErrorReporting != EErrorReporting::FarthestFailure || state.m_FarthestFailure.m_Point > span.m_Start))
+			{
+				if (bestResult.m_Status != EMatchStatus::Success && bestResult.m_Span.length() == 0)
+				{
+					messages.clear();
+					leftOut          = i;
+					leftOutRule      = state.m_CurrentRule;
+					leftOutRuleBegin = state.m_RuleBegin;
+					bestResult       = { EMatchStatus::Failure, { span.m_Start, span.m_Start } };
+				}
+				continue;
+			}
+
+			std::size_t        begin = nodes.checkpoint();
+			MatcherScopedState newScopedState;
+			auto               result = m_Matchers[i]->match(state, newScopedState, span);
 			switch (result.m_Status)
 			{
 			case EMatchStatus::Success:
+				if (firstIndex == m_Matchers.size())
+				{
+					firstIndex = i;
+					firstSpan  = result.m_Span;
+				}
 				if (bestResult.m_Status != EMatchStatus::Success || result.m_Span.length() > bestResult.m_Span.length())
 				{
-					messages   = std::move(newScopedState.m_Messages);
-					bestNode   = std::move(tempNode);
+					messages = std::move(newScopedState.m_Messages);
+					leftOut  = m_Matchers.size();
+					nodes.erase(checkpoint, begin);
+					bestEnd    = nodes.checkpoint();
 					bestResult = result;
+					bestIndex  = i;
+				}
+				else
+				{
+					nodes.rollback(begin);
 				}
 				break;
 			case EMatchStatus::Skip:
@@ -68,39 +332,186 @@ namespace CommonLexer
 				[[fallthrough]];
 			case EMatchStatus::Failure:
 			{
+				nodes.rollback(begin);
 				std::size_t len = result.m_Span.length();
 				if (len == 0)
 					len = 1;
 				if (bestResult.m_Status != EMatchStatus::Success && len > bestResult.m_Span.length())
 				{
 					messages   = std::move(newScopedState.m_Messages);
-					bestNode   = std::move(tempNode);
+					leftOut    = m_Matchers.size();
 					bestResult = result;
 				}
 				continue;
 			}
 			}
+
+			// Only a success gets here, and the first success is the best one so far
+			if (choice == EChoice::First)
+			{
+				if (state.m_ChoiceDivergences)
+					checkChoice(state, span, ruleID, i, result.m_Span);
+				break;
+			}
 		}
 
+		if (state.m_ChoiceDivergences && choice == EChoice::Longest && bestIndex != firstIndex)
+			state.m_ChoiceDivergences->push_back({ ruleID, span.m_Start, firstIndex, bestIndex, firstSpan, bestResult.m_Span });
+
+		// Matched in the rule it would have started in, the rule it leaves behind is hidden by the alternatives after it
+		if (leftOut < m_Matchers.size() && state.m_ErrorReporting == EErrorReporting::Accumulate)
+		{
+			const IRule*       rule      = state.m_CurrentRule;
+			SourcePoint        ruleBegin = state.m_RuleBegin;
+			std::size_t        begin     = nodes.checkpoint();
+			MatcherScopedState newScopedState;
+			state.setCurrentRule(leftOutRule, leftOutRuleBegin);
+			m_Matchers[leftOut]->match(state, newScopedState, span);
+			nodes.rollback(begin);
+			state.setCurrentRule(rule, ruleBegin);
+			messages = std::move(newScopedState.m_Messages);
+		}
+
+		--state.m_Speculation;
+
 		scopedState.addMessages(std::move(messages));
-		if (bestResult.m_Status == EMatchStatus::Success)
-			scopedState.m_ParentNode->addChildren(std::move(bestNode));
+		if (bestResult.m_Status != EMatchStatus::Success)
+			bestEnd = checkpoint;
+		nodes.rollback(bestEnd);
 		return bestResult;
 	}
 
+	void OrMatcher::checkChoice(MatcherState& state, SourceSpan span, std::uint32_t ruleID, std::size_t first, SourceSpan firstSpan) const
+	{
+		// The alternatives are matched the way a longest choice would, including the ors nested in them that follow the lexer.
+		// The lex has to come out as if the check never ran, so everything matching changes is put back afterwards.
+		// Memo and prefix entries would be replayed later without their farthest failure expectations, so they are left alone.
+		auto&        nodes           = *state.m_Nodes;
+		std::size_t  begin           = nodes.checkpoint();
+		const IRule* rule            = state.m_CurrentRule;
+		SourcePoint  ruleBegin       = state.m_RuleBegin;
+		SourcePoint  readEnd         = state.m_ReadEnd;
+		auto         groupedValues   = state.m_GroupedValues;
+		auto         farthestFailure = std::move(state.m_FarthestFailure);
+		auto         memo            = state.m_Memo;
+		auto         prefixes        = state.m_Prefixes;
+		auto         divergences     = state.m_ChoiceDivergences;
+		EChoice      choice          = state.m_Choice;
+		state.m_Memo                 = nullptr;
+		state.m_Prefixes             = nullptr;
+		state.m_ChoiceDivergences    = nullptr;
+		state.m_FarthestFailure      = {};
+		state.m_Choice               = EChoice::Longest;
+
+		std::size_t longest     = first;
+		SourceSpan  longestSpan = firstSpan;
+		for (std::size_t i = first + 1; i < m_Matchers.size(); ++i)
+		{
+			MatcherScopedState scopedState;
+			auto               result = m_Matchers[i]->match(state, scopedState, span);
+			nodes.rollback(begin);
+			if (result.m_Status == EMatchStatus::Success && result.m_Span.length() > longestSpan.length())
+			{
+				longest     = i;
+				longestSpan = result.m_Span;
+			}
+		}
+
+		state.setCurrentRule(rule, ruleBegin);
+		state.m_ReadEnd           = readEnd;
+		state.m_GroupedValues     = std::move(groupedValues);
+		state.m_FarthestFailure   = std::move(farthestFailure);
+		state.m_Memo              = memo;
+		state.m_Prefixes          = prefixes;
+		state.m_ChoiceDivergences = divergences;
+		state.m_Choice            = choice;
+
+		if (longest != first)
+			divergences->push_back({ ruleID, span.m_Start, first, longest, firstSpan, longestSpan });
+	}
+
+	void OrMatcher::link(const Lexer& lexer, LinkState& linkState)
+	{
+		for (auto& matcher : m_Matchers)
+			matcher->link(lexer, linkState);
+	}
+
+	bool OrMatcher::write(GrammarWriter& writer) const
+	{
+		if (m_Choice)
+		{
+			writer.writeKind(EMatcherKind::ChoiceOr);
+			writer.writeU8(static_cast<std::uint8_t>(*m_Choice));
+		}
+		else
+		{
+			writer.writeKind(EMatcherKind::Or);
+		}
+		writer.writeU32(static_cast<std::uint32_t>(m_Matchers.size()));
+		for (auto& matcher : m_Matchers)
+			if (!matcher->write(writer))
+				return false;
+		return true;
+	}
+
+	std::unique_ptr<IMatcher> OrMatcher::optimize(OptimizeState& state)
+	{
+		for (auto& matcher : m_Matchers)
+			state.optimize(matcher);
+
+		if (state.m_Options.m_Flatten)
+		{
+			// A nested or with the same choice picks the alternative this or would pick among them, except when one of them skips since a skip is only kept while nothing else matched
+			std::vector<std::unique_ptr<IMatcher>> matchers;
+			matchers.reserve(m_Matchers.size());
+			for (auto& matcher : m_Matchers)
+			{
+				if (matcher->getKind() != EMatcherKind::Or || static_cast<OrMatcher&>(*matcher).m_Choice != m_Choice || state.canSkip(*matcher))
+				{
+					matchers.push_back(std::move(matcher));
+					continue;
+				}
+
+				for (auto& alternative : static_cast<OrMatcher&>(*matcher).m_Matchers)
+					matchers.push_back(std::move(alternative));
+				++state.m_Stats.m_FlattenedMatchers;
+			}
+			m_Matchers = std::move(matchers);
+		}
+
+		if (state.m_Options.m_DispatchFirstBytes)
+		{
+			m_Dispatch = state.buildDispatch(m_Matchers);
+			if (!m_Dispatch.empty())
+				++state.m_Stats.m_DispatchedOrs;
+		}
+		return nullptr;
+	}
+
+	std::unique_ptr<IMatcher> OrMatcher::clone() const
+	{
+		std::vector<std::unique_ptr<IMatcher>> matchers;
+		if (!CloneMatchers(m_Matchers, matchers))
+			return nullptr;
+		auto matcher        = std::make_unique<OrMatcher>(std::move(matchers));
+		matcher->m_Dispatch = m_Dispatch;
+		matcher->m_Choice   = m_Choice;
+		return matcher;
+	}
+
 	RangeMatcher::RangeMatcher(std::unique_ptr<IMatcher>&& matcher, std::size_t lowerBounds, std::size_t upperBounds)
 	    : m_Matcher(std::move(matcher)), m_LowerBounds(lowerBounds), m_UpperBounds(upperBounds) {}
 
 	RangeMatcher::RangeMatcher(RangeMatcher&& move) noexcept
 	    : m_Matcher(std::move(move.m_Matcher)), m_LowerBounds(move.m_LowerBounds), m_UpperBounds(move.m_UpperBounds) {}
 
-	MatchResult RangeMatcher::match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span)
+	MatchResult RangeMatcher::match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const
 	{
 		std::size_t matches { 0 };
 		SourceSpan  subSpan { span };
 		SourceSpan  totalSpan { span.m_Start, span.m_Start };
 
-		MatcherScopedState newScopedState { scopedState.m_ParentNode };
+		MatcherScopedState newScopedState;
 
 		while (matches < m_UpperBounds)
 		{
@@ -110,6 +521,8 @@ namespace CommonLexer
 
 			subSpan.m_Start = totalSpan.m_End = result.m_Span.m_End;
 			++matches;
+			// An iteration is final once nothing around the repetition can roll it back
+			state.commitNodes(subSpan.m_Start);
 
 			if (subSpan.length() == 0)
 				break;
@@ -120,19 +533,48 @@ namespace CommonLexer
 
 		if (matches < m_LowerBounds)
 		{
-			scopedState.addMessage(fmt::format("Expected at least {} matches but only got {} matches", m_LowerBounds, matches), subSpan.m_End, subSpan, state.m_CurrentRule->getID());
+			// The farthest failure needs the point the missing match would have started at, accumulated messages keep pointing at the span end
+			SourcePoint point = state.m_ErrorReporting == EErrorReporting::FarthestFailure ? subSpan.m_Start : subSpan.m_End;
+			state.addMessage(scopedState, EMessageKind::ExpectedMatches, m_LowerBounds, matches, point, subSpan, state.m_CurrentRule->getID());
 			return { EMatchStatus::Failure, totalSpan };
 		}
 		return { EMatchStatus::Success, totalSpan };
 	}
 
+	void RangeMatcher::link(const Lexer& lexer, LinkState& linkState)
+	{
+		m_Matcher->link(lexer, linkState);
+	}
+
+	bool RangeMatcher::write(GrammarWriter& writer) const
+	{
+		writer.writeKind(EMatcherKind::Range);
+		writer.writeU64(m_LowerBounds);
+		writer.writeU64(m_UpperBounds);
+		return m_Matcher->write(writer);
+	}
+
+	std::unique_ptr<IMatcher> RangeMatcher::optimize(OptimizeState& state)
+	{
+		state.optimize(m_Matcher);
+		return nullptr;
+	}
+
+	std::unique_ptr<IMatcher> RangeMatcher::clone() const
+	{
+		auto matcher = m_Matcher->clone();
+		if (!matcher)
+			return nullptr;
+		return std::make_unique<RangeMatcher>(std::move(matcher), m_LowerBounds, m_UpperBounds);
+	}
+
 	OptionalMatcher::OptionalMatcher(std::unique_ptr<IMatcher>&& matcher)
 	    : m_Matcher(std::move(matcher)) {}
 
 	OptionalMatcher::OptionalMatcher(OptionalMatcher&& move) noexcept
 	    : m_Matcher(std::move(move.m_Matcher)) {}
 
-	MatchResult OptionalMatcher::match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span)
+	MatchResult OptionalMatcher::match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const
 	{
 		auto result = m_Matcher->match(state, scopedState, span);
 		switch (result.m_Status)
@@ -144,22 +586,50 @@ namespace CommonLexer
 		}
 	}
 
+	void OptionalMatcher::link(const Lexer& lexer, LinkState& linkState)
+	{
+		m_Matcher->link(lexer, linkState);
+	}
+
+	bool OptionalMatcher::write(GrammarWriter& writer) const
+	{
+		writer.writeKind(EMatcherKind::Optional);
+		return m_Matcher->write(writer);
+	}
+
+	std::unique_ptr<IMatcher> OptionalMatcher::optimize(OptimizeState& state)
+	{
+		state.optimize(m_Matcher);
+		return nullptr;
+	}
+
+	std::unique_ptr<IMatcher> OptionalMatcher::clone() const
+	{
+		auto matcher = m_Matcher->clone();
+		if (!matcher)
+			return nullptr;
+		return std::make_unique<OptionalMatcher>(std::move(matcher));
+	}
+
 	NegativeMatcher::NegativeMatcher(std::unique_ptr<IMatcher>&& matcher)
 	    : m_Matcher(std::move(matcher)) {}
 
 	NegativeMatcher::NegativeMatcher(NegativeMatcher&& move) noexcept
 	    : m_Matcher(std::move(move.m_Matcher)) {}
 
-	MatchResult NegativeMatcher::match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span)
+	MatchResult NegativeMatcher::match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const
 	{
-		Node               tempNode { *state.m_Lex };
-		MatcherScopedState newScopedState { &tempNode };
+		std::size_t        checkpoint = state.m_Nodes->checkpoint();
+		MatcherScopedState newScopedState;
 
+		++state.m_Speculation;
 		auto result = m_Matcher->match(state, newScopedState, span);
+		--state.m_Speculation;
+		state.m_Nodes->rollback(checkpoint);
 		switch (result.m_Status)
 		{
 		case EMatchStatus::Success:
-			scopedState.addMessage("Did not expect following sequence", span.m_Start, result.m_Span, state.m_CurrentRule->getID());
+			state.addMessage(scopedState, EMessageKind::UnexpectedSequence, span.m_Start, result.m_Span, state.m_CurrentRule->getID());
 			return { EMatchStatus::Failure, result.m_Span };
 		case EMatchStatus::Skip: [[fallthrough]];
 		case EMatchStatus::Failure: return { EMatchStatus::Success, { span.m_Start, span.m_Start } };
@@ -167,13 +637,38 @@ namespace CommonLexer
 		}
 	}
 
+	void NegativeMatcher::link(const Lexer& lexer, LinkState& linkState)
+	{
+		m_Matcher->link(lexer, linkState);
+	}
+
+	bool NegativeMatcher::write(GrammarWriter& writer) const
+	{
+		writer.writeKind(EMatcherKind::Negative);
+		return m_Matcher->write(writer);
+	}
+
+	std::unique_ptr<IMatcher> NegativeMatcher::optimize(OptimizeState& state)
+	{
+		state.optimize(m_Matcher);
+		return nullptr;
+	}
+
+	std::unique_ptr<IMatcher> NegativeMatcher::clone() const
+	{
+		auto matcher = m_Matcher->clone();
+		if (!matcher)
+			return nullptr;
+		return std::make_unique<NegativeMatcher>(std::move(matcher));
+	}
+
 	SpaceMatcher::SpaceMatcher(std::unique_ptr<IMatcher>&& matcher, bool forced, SpaceDirectionFlags direction, ESpaceMethod method)
 	    : m_Matcher(std::move(matcher)), m_Forced(forced), m_Direction(direction), m_Method(method) {}
 
 	SpaceMatcher::SpaceMatcher(SpaceMatcher&& move) noexcept
 	    : m_Matcher(std::move(move.m_Matcher)), m_Forced(move.m_Forced), m_Direction(move.m_Direction), m_Method(move.m_Method) {}
 
-	MatchResult SpaceMatcher::match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span)
+	MatchResult SpaceMatcher::match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const
 	{
 		SourceSpan subSpan { span };
 		SourceSpan totalSpan { span.m_Start, span.m_Start };
@@ -266,89 +761,116 @@ namespace CommonLexer
 		return { EMatchStatus::Success, totalSpan };
 	}
 
-	MatchResult SpaceMatcher::matchNormalSpaces(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span)
+	void SpaceMatcher::link(const Lexer& lexer, LinkState& linkState)
 	{
-		std::size_t i = 0;
+		m_Matcher->link(lexer, linkState);
+	}
 
-		auto begin = state.m_SourceSpan.begin(state.m_Source);
-		auto itr   = span.begin(state.m_Source);
-		auto end   = span.end(state.m_Source);
+	bool SpaceMatcher::write(GrammarWriter& writer) const
+	{
+		writer.writeKind(EMatcherKind::Space);
+		writer.writeBool(m_Forced);
+		writer.writeU8(m_Direction.m_Value);
+		writer.writeU8(static_cast<std::uint8_t>(m_Method));
+		return m_Matcher->write(writer);
+	}
 
-		if (m_Forced)
-		{
-			--itr;
-			if (itr < begin)
-				++itr;
-		}
+	std::unique_ptr<IMatcher> SpaceMatcher::optimize(OptimizeState& state)
+	{
+		state.optimize(m_Matcher);
+		return nullptr;
+	}
 
+	std::unique_ptr<IMatcher> SpaceMatcher::clone() const
+	{
+		auto matcher = m_Matcher->clone();
+		if (!matcher)
+			return nullptr;
+		return std::make_unique<SpaceMatcher>(std::move(matcher), m_Forced, m_Direction, m_Method);
+	}
+
+	template <class Iterator, class IsSpace>
+	static Iterator SkipSpaces(Iterator itr, Iterator end, bool forced, std::size_t& spaces, IsSpace&& isSpace)
+	{
 		while (itr != end)
 		{
-			switch (*itr)
+			if (isSpace(*itr))
 			{
-			case '\t': [[fallthrough]];
-			case ' ':
 				++itr;
-				++i;
+				++spaces;
 				continue;
 			}
 
-			if (m_Forced && i == 0)
+			if (forced && spaces == 0)
 			{
 				++itr;
 				continue;
 			}
 			break;
 		}
+		return itr;
+	}
+
+	template <class IsSpace>
+	static SourcePoint MatchSpaces(MatcherState& state, SourceSpan span, bool forced, std::size_t& spaces, char& got, IsSpace&& isSpace)
+	{
+		// Forced spaces may be satisfied by the character right before the span
+		SourceSpan searchSpan { span };
+		if (forced && searchSpan.m_Start > state.m_SourceSpan.m_Start)
+			--searchSpan.m_Start;
+
+		SourcePoint point = VisitSourceSpan(state.m_Source, searchSpan, [&](auto begin, auto end, auto toPoint) {
+			auto itr = SkipSpaces(begin, end, forced, spaces, isSpace);
+			got      = itr != end ? *itr : '\0';
+			return toPoint(itr);
+		});
+		// The character that ended the spaces was looked at as well
+		state.markRead(point.m_Index + 1);
+		return point;
+	}
+
+	MatchResult SpaceMatcher::matchNormalSpaces(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const
+	{
+		std::size_t i   = 0;
+		char        got = '\0';
+
+		SourcePoint itr = MatchSpaces(state, span, m_Forced, i, got, [](char c) { return c == '\t' || c == ' '; });
 
 		if (m_Forced && i == 0)
 		{
-			scopedState.addMessage(fmt::format("Expected space or tab but got '{}'", itr != end ? std::string { *itr } : "EOF"), span.m_Start, SourceSpan { span.m_Start, span.m_Start }, state.m_CurrentRule->getID());
+			if (itr != span.m_End)
+				state.addMessage(scopedState, EMessageKind::ExpectedSpace, std::string_view {}, got, span.m_Start, SourceSpan { span.m_Start, span.m_Start }, state.m_CurrentRule->getID());
+			else
+				state.addMessage(scopedState, EMessageKind::ExpectedSpace, span.m_Start, SourceSpan { span.m_Start, span.m_Start }, state.m_CurrentRule->getID());
 		}
 
 		return { EMatchStatus::Success, { span.m_Start, itr } };
 	}
 
-	MatchResult SpaceMatcher::matchWhitespaceSpaces(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span)
+	MatchResult SpaceMatcher::matchWhitespaceSpaces(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const
 	{
-		std::size_t i = 0;
-
-		auto begin = state.m_SourceSpan.begin(state.m_Source);
-		auto itr   = span.begin(state.m_Source);
-		auto end   = span.end(state.m_Source);
+		std::size_t i   = 0;
+		char        got = '\0';
 
-		if (m_Forced)
-		{
-			--itr;
-			if (itr < begin)
-				++itr;
-		}
-
-		while (itr != end)
-		{
-			switch (*itr)
+		SourcePoint itr = MatchSpaces(state, span, m_Forced, i, got, [](char c) {
+			switch (c)
 			{
 			case '\t': [[fallthrough]];
 			case '\n': [[fallthrough]];
 			case '\v': [[fallthrough]];
 			case '\f': [[fallthrough]];
 			case '\r': [[fallthrough]];
-			case ' ':
-				++itr;
-				++i;
-				continue;
+			case ' ': return true;
+			default: return false;
 			}
-
-			if (m_Forced && i == 0)
-			{
-				++itr;
-				continue;
-			}
-			break;
-		}
+		});
 
 		if (m_Forced && i == 0)
 		{
-			scopedState.addMessage(fmt::format("Expected space, tab, vertical tab, form feed, carriage return or line feed but got '{}'", itr != end ? std::string { *itr } : "EOF"), span.m_Start, SourceSpan { span.m_Start, span.m_Start }, state.m_CurrentRule->getID());
+			if (itr != span.m_End)
+				state.addMessage(scopedState, EMessageKind::ExpectedWhitespace, std::string_view {}, got, span.m_Start, SourceSpan { span.m_Start, span.m_Start }, state.m_CurrentRule->getID());
+			else
+				state.addMessage(scopedState, EMessageKind::ExpectedWhitespace, span.m_Start, SourceSpan { span.m_Start, span.m_Start }, state.m_CurrentRule->getID());
 		}
 
 		return { EMatchStatus::Success, { span.m_Start, itr } };
@@ -363,7 +885,7 @@ namespace CommonLexer
 	NamedGroupMatcher::NamedGroupMatcher(NamedGroupMatcher&& move) noexcept
 	    : m_Name(std::move(move.m_Name)), m_Matcher(std::move(move.m_Matcher)) {}
 
-	MatchResult NamedGroupMatcher::match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span)
+	MatchResult NamedGroupMatcher::match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const
 	{
 		auto result = m_Matcher->match(state, scopedState, span);
 		if (result.m_Status == EMatchStatus::Success)
@@ -371,6 +893,32 @@ namespace CommonLexer
 		return result;
 	}
 
+	void NamedGroupMatcher::link(const Lexer& lexer, LinkState& linkState)
+	{
+		m_Matcher->link(lexer, linkState);
+	}
+
+	bool NamedGroupMatcher::write(GrammarWriter& writer) const
+	{
+		writer.writeKind(EMatcherKind::NamedGroup);
+		writer.writeString(m_Name);
+		return m_Matcher->write(writer);
+	}
+
+	std::unique_ptr<IMatcher> NamedGroupMatcher::optimize(OptimizeState& state)
+	{
+		state.optimize(m_Matcher);
+		return nullptr;
+	}
+
+	std::unique_ptr<IMatcher> NamedGroupMatcher::clone() const
+	{
+		auto matcher = m_Matcher->clone();
+		if (!matcher)
+			return nullptr;
+		return std::make_unique<NamedGroupMatcher>(m_Name, std::move(matcher));
+	}
+
 	NamedGroupReferenceMatcher::NamedGroupReferenceMatcher(const std::string& name)
 	    : m_Name(name) {}
 
@@ -380,38 +928,87 @@ namespace CommonLexer
 	NamedGroupReferenceMatcher::NamedGroupReferenceMatcher(NamedGroupReferenceMatcher&& move) noexcept
 	    : m_Name(std::move(move.m_Name)) {}
 
-	MatchResult NamedGroupReferenceMatcher::match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span)
+	MatchResult NamedGroupReferenceMatcher::match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const
 	{
 		auto groupedSpan = state.getGroupedValue(m_Name);
 
-		auto itr = span.begin(state.m_Source);
-		auto end = span.end(state.m_Source);
+		// The group's text belongs to the source, so messages copy it
+		std::string      groupFallback;
+		std::string_view groupText = state.m_Source->getSpanView(groupedSpan, groupFallback);
+		std::string      fallback;
+		std::string_view text = state.m_Source->getSpanView(span.m_Start, std::min(span.length(), groupText.size()), fallback);
 
-		auto textItr = groupedSpan.begin(state.m_Source);
-		auto textEnd = groupedSpan.end(state.m_Source);
-
-		while (textItr != textEnd)
+		std::size_t i = 0;
+		while (i < groupText.size())
 		{
-			if (itr == end)
+			if (i >= text.size())
 			{
-				scopedState.addMessage(fmt::format("Expected '{}', but got 'EOF'", SourceSpan { textItr, textEnd }.getSpan(state.m_Source)), itr, SourceSpan { span.m_Start, itr }, state.m_CurrentRule->getID());
-				return { EMatchStatus::Failure, { span.m_Start, itr } };
+				SourcePoint point = span.m_Start + i;
+				state.markRead(point.m_Index + 1);
+				state.addMessage(scopedState, EMessageKind::ExpectedText, std::string { groupText.substr(i) }, point, SourceSpan { span.m_Start, point }, state.m_CurrentRule->getID());
+				return { EMatchStatus::Failure, { span.m_Start, point } };
 			}
 
-			if (*itr != *textItr)
+			if (text[i] != groupText[i])
 			{
-				scopedState.addMessage(fmt::format("Expected '{}', but got '{}'", *textItr, *itr), itr, SourceSpan { span.m_Start, itr }, state.m_CurrentRule->getID());
-				return { EMatchStatus::Failure, { span.m_Start, itr } };
+				SourcePoint point = span.m_Start + i;
+				state.markRead(point.m_Index + 1);
+				state.addMessage(scopedState, EMessageKind::ExpectedText, std::string { groupText.substr(i, 1) }, text[i], point, SourceSpan { span.m_Start, point }, state.m_CurrentRule->getID());
+				return { EMatchStatus::Failure, { span.m_Start, point } };
 			}
 
-			++itr;
-			++textItr;
+			++i;
 		}
-		return { EMatchStatus::Success, { span.m_Start, itr } };
+		state.markRead(span.m_Start + i);
+		return { EMatchStatus::Success, { span.m_Start, span.m_Start + i } };
+	}
+
+	bool NamedGroupReferenceMatcher::write(GrammarWriter& writer) const
+	{
+		writer.writeKind(EMatcherKind::NamedGroupReference);
+		writer.writeString(m_Name);
+		return true;
+	}
+
+	std::unique_ptr<IMatcher> NamedGroupReferenceMatcher::clone() const
+	{
+		return std::make_unique<NamedGroupReferenceMatcher>(m_Name);
+	}
+
+	// Adds the nodes, messages, reads and end rule of a captured match as if the match happened again
+	static MatchResult ReplayEntry(MatcherState& state, MatcherScopedState& scopedState, const MemoEntry& entry)
+	{
+		state.m_Nodes->append(entry.m_Nodes);
+		scopedState.addMessages(entry.m_Messages);
+		state.setCurrentRule(entry.m_EndRule, entry.m_EndRuleBegin);
+		state.markRead(entry.m_ReadEnd);
+		return entry.m_Result;
+	}
+
+	// Matches matcher over span like a plain match would and captures what ReplayEntry needs to repeat it
+	static MemoEntry CaptureEntry(const IMatcher& matcher, MatcherState& state, MatcherScopedState& scopedState, SourceSpan span)
+	{
+		std::size_t        captureBegin = state.m_Nodes->checkpoint();
+		MatcherScopedState captureState;
+
+		// Reads are captured separately so a replayed entry reports the same reads
+		SourcePoint outerReadEnd = state.m_ReadEnd;
+		state.m_ReadEnd          = span.m_Start;
+
+		++state.m_Speculation;
+		auto result = matcher.match(state, captureState, span);
+		--state.m_Speculation;
+
+		auto      nodes = state.m_Nodes->getNodes(captureBegin);
+		MemoEntry entry { result, span.m_End, state.m_CurrentRule, state.m_RuleBegin, state.m_ReadEnd, { nodes.begin(), nodes.end() }, captureState.m_Messages, 0 };
+		state.markRead(outerReadEnd);
+
+		scopedState.addMessages(std::move(captureState));
+		return entry;
 	}
 
 	ReferenceMatcher::ReferenceMatcher(const std::string& name)
-	    : m_Name(name) {}
+	    : m_Name(name), m_Rule(nullptr) {}
 
 	ReferenceMatcher::ReferenceMatcher(std::string&& name)
 	    : m_Name(std::move(name)), m_Rule(nullptr) {}
@@ -419,19 +1016,144 @@ namespace CommonLexer
 	ReferenceMatcher::ReferenceMatcher(ReferenceMatcher&& move) noexcept
 	    : m_Name(std::move(move.m_Name)), m_Rule(nullptr) {}
 
-	MatchResult ReferenceMatcher::match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span)
+	MatchResult ReferenceMatcher::match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const
 	{
 		if (!m_Rule)
 		{
-			m_Rule = state.m_Lex->getLexer()->getRule(m_Name);
-			if (!m_Rule)
-			{
-				scopedState.addMessage(fmt::format("Expected non existent rule '{}'", m_Name), span.m_Start, SourceSpan { span.m_Start, span.m_Start }, state.m_CurrentRule->getID());
-				return { EMatchStatus::Failure, { span.m_Start, span.m_Start } };
-			}
+			state.addMessage(scopedState, EMessageKind::MissingRule, std::string_view { m_Name }, span.m_Start, SourceSpan { span.m_Start, span.m_Start }, state.m_CurrentRule->getID());
+			return { EMatchStatus::Failure, { span.m_Start, span.m_Start } };
 		}
 
-		return m_Rule->match(state, scopedState, span);
+		if (!state.m_Memo || !m_Rule->isMemoized() || !m_Rule->isReplayable())
+			return m_Rule->match(state, scopedState, span);
+
+		std::uint32_t ruleID = m_Rule->getID();
+		if (auto entry = state.m_Memo->find(ruleID, span))
+			return ReplayEntry(state, scopedState, *entry);
+
+		auto entry  = CaptureEntry(*m_Rule, state, scopedState, span);
+		auto result = entry.m_Result;
+		state.m_Memo->insert(ruleID, span, std::move(entry));
+		return result;
+	}
+
+	void ReferenceMatcher::link(const Lexer& lexer, LinkState& linkState)
+	{
+		linkState.m_Literals.push_back(m_Name);
+		m_Rule = lexer.getRule(m_Name);
+		if (!m_Rule)
+			linkState.m_Errors.push_back(fmt::format("Rule '{}' references non existent rule '{}'", linkState.m_Rule->getName(), m_Name));
+	}
+
+	bool ReferenceMatcher::write(GrammarWriter& writer) const
+	{
+		writer.writeKind(EMatcherKind::Reference);
+		writer.writeString(m_Name);
+		return true;
+	}
+
+	std::unique_ptr<IMatcher> ReferenceMatcher::optimize(OptimizeState& state)
+	{
+		if (!m_Rule || !state.m_Options.m_InlineRules)
+			return nullptr;
+
+		auto matcher = state.inlineRule(*m_Rule);
+		if (!matcher)
+			return nullptr;
+		++state.m_Stats.m_InlinedRules;
+		return std::make_unique<InlineRuleMatcher>(m_Rule, std::move(matcher));
+	}
+
+	std::unique_ptr<IMatcher> ReferenceMatcher::clone() const
+	{
+		auto reference    = std::make_unique<ReferenceMatcher>(m_Name);
+		reference->m_Rule = m_Rule;
+		return reference;
+	}
+
+	InlineRuleMatcher::InlineRuleMatcher(const IRule* rule, std::unique_ptr<IMatcher>&& matcher)
+	    : m_Rule(rule), m_Matcher(std::move(matcher)) {}
+
+	InlineRuleMatcher::InlineRuleMatcher(InlineRuleMatcher&& move) noexcept
+	    : m_Rule(move.m_Rule), m_Matcher(std::move(move.m_Matcher)) {}
+
+	MatchResult InlineRuleMatcher::match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const
+	{
+		// Same as MatcherRule::match for a nodeless rule
+		state.setCurrentRule(m_Rule, span.m_Start);
+		return m_Matcher->match(state, scopedState, span);
+	}
+
+	void InlineRuleMatcher::link(const Lexer& lexer, LinkState& linkState)
+	{
+		m_Matcher->link(lexer, linkState);
+	}
+
+	bool InlineRuleMatcher::write(GrammarWriter& writer) const
+	{
+		writer.writeKind(EMatcherKind::Reference);
+		writer.writeString(m_Rule->getName());
+		return true;
+	}
+
+	std::unique_ptr<IMatcher> InlineRuleMatcher::optimize(OptimizeState& state)
+	{
+		state.m_RuleStack.push_back(m_Rule);
+		state.optimize(m_Matcher);
+		state.m_RuleStack.pop_back();
+		return nullptr;
+	}
+
+	std::unique_ptr<IMatcher> InlineRuleMatcher::clone() const
+	{
+		auto matcher = m_Matcher->clone();
+		if (!matcher)
+			return nullptr;
+		return std::make_unique<InlineRuleMatcher>(m_Rule, std::move(matcher));
+	}
+
+	SharedPrefixMatcher::SharedPrefixMatcher(std::uint32_t prefixID, std::unique_ptr<IMatcher>&& matcher)
+	    : m_PrefixID(prefixID), m_Matcher(std::move(matcher)) {}
+
+	SharedPrefixMatcher::SharedPrefixMatcher(SharedPrefixMatcher&& move) noexcept
+	    : m_PrefixID(move.m_PrefixID), m_Matcher(std::move(move.m_Matcher)) {}
+
+	MatchResult SharedPrefixMatcher::match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const
+	{
+		if (!state.m_Prefixes)
+			return m_Matcher->match(state, scopedState, span);
+
+		if (auto entry = state.m_Prefixes->find(m_PrefixID, span))
+			return ReplayEntry(state, scopedState, *entry);
+
+		auto entry  = CaptureEntry(*m_Matcher, state, scopedState, span);
+		auto result = entry.m_Result;
+		state.m_Prefixes->insert(m_PrefixID, span, std::move(entry));
+		return result;
+	}
+
+	void SharedPrefixMatcher::link(const Lexer& lexer, LinkState& linkState)
+	{
+		m_Matcher->link(lexer, linkState);
+	}
+
+	bool SharedPrefixMatcher::write(GrammarWriter& writer) const
+	{
+		return m_Matcher->write(writer);
+	}
+
+	std::unique_ptr<IMatcher> SharedPrefixMatcher::optimize(OptimizeState& state)
+	{
+		state.optimize(m_Matcher);
+		return nullptr;
+	}
+
+	std::unique_ptr<IMatcher> SharedPrefixMatcher::clone() const
+	{
+		auto matcher = m_Matcher->clone();
+		if (!matcher)
+			return nullptr;
+		return std::make_unique<SharedPrefixMatcher>(m_PrefixID, std::move(matcher));
 	}
 
 	TextMatcher::TextMatcher(const std::string& text)
@@ -441,51 +1163,381 @@ namespace CommonLexer
 	    : m_Text(std::move(text)) {}
 
 	TextMatcher::TextMatcher(TextMatcher&& move) noexcept
-	    : m_Text(std::move(move.m_Text)) {}
+	    : m_Text(std::move(move.m_Text)), m_Segments(std::move(move.m_Segments)) {}
 
-	MatchResult TextMatcher::match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span)
+	MatchResult TextMatcher::match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const
 	{
-		auto itr = span.begin(state.m_Source);
-		auto end = span.end(state.m_Source);
-
-		auto textItr = m_Text.begin();
-		auto textEnd = m_Text.end();
+		std::string      fallback;
+		std::string_view text = state.m_Source->getSpanView(span.m_Start, std::min(span.length(), m_Text.size()), fallback);
 
-		while (textItr != textEnd)
+		std::size_t i = 0;
+		while (i < m_Text.size())
 		{
-			if (itr == end)
+			if (i >= text.size())
 			{
-				scopedState.addMessage(fmt::format("Expected '{}', but got 'EOF'", std::string_view { textItr.operator->(), static_cast<std::size_t>(textEnd - textItr) }), itr, SourceSpan { span.m_Start, itr }, state.m_CurrentRule->getID());
-				return { EMatchStatus::Failure, { span.m_Start, itr } };
+				SourcePoint point = span.m_Start + i;
+				state.markRead(point.m_Index + 1);
+				auto [segmentStart, segmentEnd] = getSegment(i);
+				state.addMessage(scopedState, EMessageKind::ExpectedText, std::string_view { m_Text }.substr(i, segmentEnd - i), point, SourceSpan { span.m_Start + segmentStart, point }, state.m_CurrentRule->getID());
+				return { EMatchStatus::Failure, { span.m_Start, point } };
 			}
 
-			if (*itr != *textItr)
+			if (text[i] != m_Text[i])
 			{
-				scopedState.addMessage(fmt::format("Expected '{}', but got '{}'", *textItr, *itr), itr, SourceSpan { span.m_Start, itr }, state.m_CurrentRule->getID());
-				return { EMatchStatus::Failure, { span.m_Start, itr } };
+				SourcePoint point = span.m_Start + i;
+				state.markRead(point.m_Index + 1);
+				state.addMessage(scopedState, EMessageKind::ExpectedText, std::string_view { m_Text }.substr(i, 1), text[i], point, SourceSpan { span.m_Start + getSegment(i).first, point }, state.m_CurrentRule->getID());
+				return { EMatchStatus::Failure, { span.m_Start, point } };
 			}
 
-			++itr;
-			++textItr;
+			++i;
 		}
-		return { EMatchStatus::Success, { span.m_Start, itr } };
+		state.markRead(span.m_Start + i);
+		return { EMatchStatus::Success, { span.m_Start, span.m_Start + i } };
+	}
+
+	void TextMatcher::link([[maybe_unused]] const Lexer& lexer, LinkState& linkState)
+	{
+		linkState.m_Literals.push_back(m_Text);
+	}
+
+	bool TextMatcher::write(GrammarWriter& writer) const
+	{
+		writer.writeKind(EMatcherKind::Text);
+		writer.writeString(m_Text);
+		return true;
+	}
+
+	std::unique_ptr<IMatcher> TextMatcher::clone() const
+	{
+		auto text        = std::make_unique<TextMatcher>(m_Text);
+		text->m_Segments = m_Segments;
+		return text;
+	}
+
+	void TextMatcher::fuse(const TextMatcher& next, bool groupStart, bool nextGroupStart)
+	{
+		if (m_Segments.empty())
+			m_Segments.push_back({ m_Text.size(), groupStart });
+
+		if (next.m_Segments.empty())
+		{
+			m_Segments.push_back({ m_Text.size() + next.m_Text.size(), nextGroupStart });
+		}
+		else
+		{
+			for (std::size_t i = 0; i < next.m_Segments.size(); ++i)
+				m_Segments.push_back({ m_Text.size() + next.m_Segments[i].m_End, i == 0 ? nextGroupStart : next.m_Segments[i].m_GroupStart });
+		}
+		m_Text += next.m_Text;
+	}
+
+	void TextMatcher::setGroupStart(bool groupStart)
+	{
+		for (auto& segment : m_Segments)
+			segment.m_GroupStart = false;
+		if (!m_Segments.empty())
+			m_Segments.front().m_GroupStart = groupStart;
+	}
+
+	std::size_t TextMatcher::getGroupStart(std::size_t offset) const
+	{
+		std::size_t groupStart = NoGroupStart;
+		std::size_t start      = 0;
+		for (auto& segment : m_Segments)
+		{
+			if (segment.m_GroupStart)
+				groupStart = start;
+			if (segment.m_End > offset)
+				break;
+			start = segment.m_End;
+		}
+		return groupStart;
+	}
+
+	std::pair<std::size_t, std::size_t> TextMatcher::getSegment(std::size_t offset) const
+	{
+		std::size_t start = 0;
+		for (auto& segment : m_Segments)
+		{
+			if (segment.m_End > offset)
+				return { start, segment.m_End };
+			start = segment.m_End;
+		}
+		return { start, m_Text.size() };
+	}
+
+	// Wraps a source iterator and records how far into the span it was dereferenced, comparing equal to the end counts as reading past the last character.
+	template <class Iterator>
+	class ReadTrackingIterator
+	{
+	public:
+		using iterator_category = std::bidirectional_iterator_tag;
+		using value_type        = char;
+		using difference_type   = std::ptrdiff_t;
+		using pointer           = const char*;
+		using reference         = decltype(*std::declval<Iterator>());
+
+	public:
+		ReadTrackingIterator() : m_ReadLength(nullptr) {}
+		ReadTrackingIterator(Iterator itr, Iterator begin, Iterator end, std::ptrdiff_t* readLength) : m_Itr(itr), m_Begin(begin), m_End(end), m_ReadLength(readLength) {}
+
+		reference operator*() const
+		{
+			record(m_Itr - m_Begin + 1);
+			return *m_Itr;
+		}
+
+		ReadTrackingIterator& operator++()
+		{
+			++m_Itr;
+			return *this;
+		}
+		ReadTrackingIterator operator++(int)
+		{
+			auto copy = *this;
+			++m_Itr;
+			return copy;
+		}
+		ReadTrackingIterator& operator--()
+		{
+			--m_Itr;
+			return *this;
+		}
+		ReadTrackingIterator operator--(int)
+		{
+			auto copy = *this;
+			--m_Itr;
+			return copy;
+		}
+
+		bool operator==(const ReadTrackingIterator& other) const
+		{
+			if (m_Itr != other.m_Itr)
+				return false;
+			if (m_Itr == m_End)
+				record(m_End - m_Begin + 1);
+			return true;
+		}
+		bool operator!=(const ReadTrackingIterator& other) const { return !(*this == other); }
+
+		[[nodiscard]] Iterator base() const { return m_Itr; }
+
+	private:
+		void record(std::ptrdiff_t length) const
+		{
+			if (length > *m_ReadLength)
+				*m_ReadLength = length;
+		}
+
+	private:
+		Iterator        m_Itr;
+		Iterator        m_Begin;
+		Iterator        m_End;
+		std::ptrdiff_t* m_ReadLength;
+	};
+
+	RegexProgram::RegexProgram(std::string&& pattern)
+	    : m_Pattern(std::move(pattern)), m_Error(), m_Valid(ValidateRegex(m_Pattern, m_Error)), m_Compiled(false) {}
+
+	const std::regex& RegexProgram::getRegex()
+	{
+		if (m_Compiled.load(std::memory_order_acquire))
+			return m_Regex;
+
+		std::lock_guard lock { m_CompileMutex };
+		if (!m_Compiled.load(std::memory_order_relaxed))
+		{
+			m_Regex.assign(m_Pattern, std::regex_constants::ECMAScript | std::regex_constants::optimize);
+			m_Compiled.store(true, std::memory_order_release);
+		}
+		return m_Regex;
 	}
 
 	RegexMatcher::RegexMatcher(const std::string& regex)
-	    : m_Regex(regex, std::regex_constants::ECMAScript | std::regex_constants::optimize) {}
+	    : m_Program(std::make_shared<RegexProgram>(std::string { regex })) {}
 
 	RegexMatcher::RegexMatcher(std::string&& regex)
-	    : m_Regex(std::move(regex), std::regex_constants::ECMAScript | std::regex_constants::optimize) {}
+	    : m_Program(std::make_shared<RegexProgram>(std::move(regex))) {}
+
+	RegexMatcher::RegexMatcher(std::shared_ptr<RegexProgram> program)
+	    : m_Program(std::move(program)) {}
 
 	RegexMatcher::RegexMatcher(RegexMatcher&& move) noexcept
-	    : m_Regex(std::move(move.m_Regex)) {}
+	    : m_Program(std::move(move.m_Program)) {}
 
-	MatchResult RegexMatcher::match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span)
+	MatchResult RegexMatcher::match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const
 	{
-		std::match_results<SourceIterator> results;
-		if (std::regex_search(span.begin(state.m_Source), span.end(state.m_Source), results, m_Regex, std::regex_constants::match_continuous))
-			return { EMatchStatus::Success, { results[0].first, results[0].second } };
-		scopedState.addMessage("Expected regex to succeed, but failed. Sadly I don't get regex error messages, maybe in the future ;)", span.m_Start, SourceSpan { span.m_Start, span.m_Start }, state.m_CurrentRule->getID());
+		// Lexing an unfinalized lexer ignores the finalize errors, so an invalid pattern simply never matches
+		if (!m_Program->isValid())
+		{
+			state.addMessage(scopedState, EMessageKind::ExpectedRegex, span.m_Start, SourceSpan { span.m_Start, span.m_Start }, state.m_CurrentRule->getID());
+			return { EMatchStatus::Failure, { span.m_Start, span.m_Start } };
+		}
+
+		auto& regex  = m_Program->getRegex();
+		auto  result = VisitSourceSpan(state.m_Source, span, [&](auto begin, auto end, auto toPoint) -> MatchResult {
+			if (state.m_TrackReads)
+			{
+				using Iterator = ReadTrackingIterator<decltype(begin)>;
+
+				std::ptrdiff_t               readLength = 0;
+				std::match_results<Iterator> results;
+				bool                         matched = std::regex_search(Iterator { begin, begin, end, &readLength }, Iterator { end, begin, end, &readLength }, results, regex, std::regex_constants::match_continuous);
+				state.markRead(span.m_Start + static_cast<std::size_t>(readLength));
+				if (matched)
+					return { EMatchStatus::Success, { toPoint(results[0].first.base()), toPoint(results[0].second.base()) } };
+				return { EMatchStatus::Failure, { span.m_Start, span.m_Start } };
+			}
+
+			std::match_results<decltype(begin)> results;
+			if (std::regex_search(begin, end, results, regex, std::regex_constants::match_continuous))
+				return { EMatchStatus::Success, { toPoint(results[0].first), toPoint(results[0].second) } };
+			return { EMatchStatus::Failure, { span.m_Start, span.m_Start } };
+		});
+		if (result.m_Status == EMatchStatus::Success)
+			return result;
+		state.addMessage(scopedState, EMessageKind::ExpectedRegex, span.m_Start, SourceSpan { span.m_Start, span.m_Start }, state.m_CurrentRule->getID());
 		return { EMatchStatus::Failure, { span.m_Start, span.m_Start } };
 	}
+
+	void RegexMatcher::link([[maybe_unused]] const Lexer& lexer, LinkState& linkState)
+	{
+		if (!m_Program->isValid())
+			linkState.m_Errors.push_back(fmt::format("Rule '{}' has invalid regex '{}': {}", linkState.m_Rule->getName(), m_Program->m_Pattern, m_Program->getError()));
+	}
+
+	bool RegexMatcher::write(GrammarWriter& writer) const
+	{
+		writer.writeKind(EMatcherKind::Regex);
+		writer.writeString(m_Program->m_Pattern);
+		return true;
+	}
+
+	std::unique_ptr<IMatcher> RegexMatcher::optimize(OptimizeState& state)
+	{
+		if (!state.m_Options.m_ShareRegexes)
+			return nullptr;
+
+		auto program = state.shareRegex(m_Program);
+		if (program != m_Program)
+		{
+			m_Program = std::move(program);
+			++state.m_Stats.m_SharedRegexes;
+		}
+		return nullptr;
+	}
+
+	std::unique_ptr<IMatcher> RegexMatcher::clone() const
+	{
+		return std::make_unique<RegexMatcher>(m_Program);
+	}
+
+	static std::unique_ptr<IMatcher> ReadMatcher(GrammarReader& reader, std::size_t depth)
+	{
+		// Bounds the recursion for corrupt data, real grammars are nowhere near this deep
+		static constexpr std::size_t MaxDepth = 4096;
+
+		if (depth > MaxDepth)
+		{
+			reader.fail();
+			return nullptr;
+		}
+
+		auto readMatchers = [&]() {
+			std::uint32_t                          count = reader.readU32();
+			std::vector<std::unique_ptr<IMatcher>> matchers;
+			matchers.reserve(std::min<std::size_t>(count, reader.getRemaining()));
+			for (std::uint32_t i = 0; i < count && reader.isValid(); ++i)
+				matchers.push_back(ReadMatcher(reader, depth + 1));
+			return matchers;
+		};
+
+		std::unique_ptr<IMatcher> matcher;
+		switch (reader.readKind())
+		{
+		case EMatcherKind::Combination:
+			matcher = std::make_unique<CombinationMatcher>(readMatchers());
+			break;
+		case EMatcherKind::Or:
+			matcher = std::make_unique<OrMatcher>(readMatchers());
+			break;
+		case EMatcherKind::ChoiceOr:
+		{
+			std::uint8_t choice = reader.readU8();
+			if (choice > static_cast<std::uint8_t>(EChoice::First))
+			{
+				reader.fail();
+				break;
+			}
+			auto orMatcher = std::make_unique<OrMatcher>(readMatchers());
+			orMatcher->setChoice(static_cast<EChoice>(choice));
+			matcher = std::move(orMatcher);
+			break;
+		}
+		case EMatcherKind::Range:
+		{
+			std::size_t lowerBounds = reader.readU64();
+			std::size_t upperBounds = reader.readU64();
+			if (auto child = ReadMatcher(reader, depth + 1))
+				matcher = std::make_unique<RangeMatcher>(std::move(child), lowerBounds, upperBounds);
+			break;
+		}
+		case EMatcherKind::Optional:
+			if (auto child = ReadMatcher(reader, depth + 1))
+				matcher = std::make_unique<OptionalMatcher>(std::move(child));
+			break;
+		case EMatcherKind::Negative:
+			if (auto child = ReadMatcher(reader, depth + 1))
+				matcher = std::make_unique<NegativeMatcher>(std::move(child));
+			break;
+		case EMatcherKind::Space:
+		{
+			bool                forced    = reader.readBool();
+			SpaceDirectionFlags direction = reader.readU8();
+			std::uint8_t        method    = reader.readU8();
+			if (direction.m_Value > ESpaceDirection::Both.m_Value || method > static_cast<std::uint8_t>(ESpaceMethod::Whitespace))
+				reader.fail();
+			else if (auto child = ReadMatcher(reader, depth + 1))
+				matcher = std::make_unique<SpaceMatcher>(std::move(child), forced, direction, static_cast<ESpaceMethod>(method));
+			break;
+		}
+		case EMatcherKind::NamedGroup:
+		{
+			std::string name = reader.readString();
+			if (auto child = ReadMatcher(reader, depth + 1))
+				matcher = std::make_unique<NamedGroupMatcher>(std::move(name), std::move(child));
+			break;
+		}
+		case EMatcherKind::NamedGroupReference:
+			matcher = std::make_unique<NamedGroupReferenceMatcher>(reader.readString());
+			break;
+		case EMatcherKind::Reference:
+			matcher = std::make_unique<ReferenceMatcher>(reader.readString());
+			break;
+		case EMatcherKind::Text:
+			matcher = std::make_unique<TextMatcher>(reader.readString());
+			break;
+		case EMatcherKind::Regex:
+		{
+			auto regex = std::make_unique<RegexMatcher>(reader.readString());
+			if (!regex->getProgram()->isValid())
+				reader.fail();
+			matcher = std::move(regex);
+			break;
+		}
+		default: break;
+		}
+
+		if (!reader.isValid())
+			return nullptr;
+		if (!matcher)
+			reader.fail();
+		return matcher;
+	}
+
+	std::unique_ptr<IMatcher> ReadMatcher(GrammarReader& reader)
+	{
+		return ReadMatcher(reader, 0);
+	}
 } // namespace CommonLexer
\ No newline at end of file
@@ -0,0 +1,97 @@
+#include "CommonLexer/Memo.h"
+
+namespace CommonLexer
+{
+	const MemoEntry* MemoTable::find(std::uint32_t ruleID, SourceSpan span)
+	{
+		auto& entries = m_Entries[ruleID];
+		auto  itr     = entries.find(span.m_Start);
+		if (itr == entries.end() || itr->second.m_Bound != span.m_End)
+		{
+			++m_Stats.m_Misses;
+			return nullptr;
+		}
+		++m_Stats.m_Hits;
+		return &itr->second;
+	}
+
+	void MemoTable::insert(std::uint32_t ruleID, SourceSpan span, MemoEntry&& entry)
+	{
+		entry.m_Bound       = span.m_End;
+		entry.m_MemoryUsage = sizeof(std::size_t) + sizeof(MemoEntry);
+		entry.m_MemoryUsage += entry.m_Nodes.size() * sizeof(StackNode);
+		entry.m_MemoryUsage += entry.m_Messages.size() * sizeof(Message);
+
+		auto& entries = m_Entries[ruleID];
+		auto  itr     = entries.find(span.m_Start);
+		if (itr != entries.end())
+		{
+			m_Stats.m_Memory -= itr->second.m_MemoryUsage;
+			--m_Stats.m_Entries;
+			entries.erase(itr);
+		}
+
+		if (m_Stats.m_Memory + entry.m_MemoryUsage > m_MemoryLimit)
+		{
+			++m_Stats.m_Rejected;
+			return;
+		}
+
+		m_Stats.m_Memory += entry.m_MemoryUsage;
+		++m_Stats.m_Entries;
+		entries.insert({ span.m_Start, std::move(entry) });
+	}
+
+	void MemoTable::clear()
+	{
+		for (auto& entries : m_Entries)
+			entries.clear();
+		m_Stats.m_Entries = 0;
+		m_Stats.m_Memory  = 0;
+	}
+
+	void MemoTable::evictBefore(SourcePoint point)
+	{
+		for (auto& entries : m_Entries)
+		{
+			std::erase_if(entries, [&](const auto& entry) {
+				if (entry.first >= point)
+					return false;
+				m_Stats.m_Memory -= entry.second.m_MemoryUsage;
+				--m_Stats.m_Entries;
+				return true;
+			});
+		}
+	}
+
+	void MemoTable::reset(std::size_t ruleCount)
+	{
+		clear();
+		m_Entries.resize(ruleCount);
+	}
+
+	const MemoEntry* PrefixCache::find(std::uint32_t prefixID, SourceSpan span) const
+	{
+		if (prefixID >= m_Slots.size())
+			return nullptr;
+		auto& slot = m_Slots[prefixID];
+		return slot.m_Entry && slot.m_Start == span.m_Start && slot.m_Entry->m_Bound == span.m_End ? &*slot.m_Entry : nullptr;
+	}
+
+	void PrefixCache::insert(std::uint32_t prefixID, SourceSpan span, MemoEntry&& entry)
+	{
+		if (prefixID >= m_Slots.size())
+			m_Slots.resize(prefixID + 1);
+		entry.m_Bound = span.m_End;
+
+		auto& slot   = m_Slots[prefixID];
+		slot.m_Start = span.m_Start;
+		slot.m_Entry = std::move(entry);
+	}
+
+	void PrefixCache::clear()
+	{
+		for (auto& slot : m_Slots)
+			slot.m_Entry.reset();
+	}
+} // namespace CommonLexer
\ No newline at end of file
@@ -1,5 +1,29 @@
 #include "CommonLexer/Message.h"
 
+#include <fmt/format.h>
+
 namespace CommonLexer
 {
-}
\ No newline at end of file
+	void Message::shift(std::ptrdiff_t offset)
+	{
+		m_Point = m_Point.m_Index + static_cast<std::size_t>(offset);
+		m_Span  = { m_Span.m_Start.m_Index + static_cast<std::size_t>(offset), m_Span.m_End.m_Index + static_cast<std::size_t>(offset) };
+	}
+
+	std::string Message::getMessage() const
+	{
+		std::string_view got = m_GotEOF ? std::string_view { "EOF" } : std::string_view { &m_Got, 1 };
+		switch (m_Kind)
+		{
+		case EMessageKind::Custom: return m_Message;
+		case EMessageKind::ExpectedText: return fmt::format("Expected '{}', but got '{}'", getExpected(), got);
+		case EMessageKind::ExpectedRegex: return "Expected regex to succeed, but failed. Sadly I don't get regex error messages, maybe in the future ;)";
+		case EMessageKind::ExpectedSpace: return fmt::format("Expected space or tab but got '{}'", got);
+		case EMessageKind::ExpectedWhitespace: return fmt::format("Expected space, tab, vertical tab, form feed, carriage return or line feed but got '{}'", got);
+		case EMessageKind::ExpectedMatches: return fmt::format("Expected at least {} matches but only got {} matches", m_ExpectedCount, m_GotCount);
+		case EMessageKind::UnexpectedSequence: return "Did not expect following sequence";
+		case EMessageKind::MissingRule: return fmt::format("Expected non existent rule '{}'", getExpected());
+		default: return {};
+		}
+	}
+} // namespace CommonLexer
\ No newline at end of file
@@ -1,12 +1,20 @@
 #include "CommonLexer/Node.h"
+#include "CommonLexer/Rule.h"
 
 namespace CommonLexer
 {
 	Node::Node(Lex& lex)
-	    : m_Lex(&lex), m_Rule(0U), m_Span({ 0, 0 }) {}
+	    : m_Lex(&lex), m_Rule(InvalidRuleID), m_Span({ 0, 0 }) {}
 	Node::Node(Lex& lex, std::uint32_t rule)
 	    : m_Lex(&lex), m_Rule(rule), m_Span({ 0, 0 }) {}
 
+	void Node::setLex(Lex& lex)
+	{
+		m_Lex = &lex;
+		for (auto& child : m_Children)
+			child.setLex(lex);
+	}
+
 	void Node::setRule(std::uint32_t rule)
 	{
 		m_Rule = rule;
@@ -17,6 +25,13 @@ namespace CommonLexer
 		m_Span = span;
 	}
 
+	void Node::shift(std::ptrdiff_t offset)
+	{
+		m_Span = { m_Span.m_Start.m_Index + static_cast<std::size_t>(offset), m_Span.m_End.m_Index + static_cast<std::size_t>(offset) };
+		for (auto& child : m_Children)
+			child.shift(offset);
+	}
+
 	void Node::addChild(const Node& child)
 	{
 		m_Children.push_back(child);
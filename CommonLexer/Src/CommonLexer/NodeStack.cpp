@@ -0,0 +1,51 @@
+#include "CommonLexer/NodeStack.h"
+#include "CommonLexer/Node.h"
+
+namespace CommonLexer
+{
+	void NodeStack::rollback(std::size_t checkpoint)
+	{
+		m_Nodes.erase(m_Nodes.begin() + checkpoint, m_Nodes.end());
+	}
+
+	std::size_t NodeStack::open(std::uint32_t rule)
+	{
+		m_Nodes.push_back({ { 0, 0 }, rule, 1 });
+		return m_Nodes.size() - 1;
+	}
+
+	void NodeStack::close(std::size_t index, SourceSpan span)
+	{
+		auto& node         = m_Nodes[index];
+		node.m_Span        = span;
+		node.m_SubtreeSize = static_cast<std::uint32_t>(m_Nodes.size() - index);
+	}
+
+	void NodeStack::append(std::span<const StackNode> nodes)
+	{
+		m_Nodes.insert(m_Nodes.end(), nodes.begin(), nodes.end());
+	}
+
+	void NodeStack::erase(std::size_t begin, std::size_t end)
+	{
+		m_Nodes.erase(m_Nodes.begin() + begin, m_Nodes.begin() + end);
+	}
+
+	void NodeStack::build(Node& parent, std::size_t begin) const
+	{
+		build(parent, begin, m_Nodes.size());
+	}
+
+	void NodeStack::build(Node& parent, std::size_t begin, std::size_t end) const
+	{
+		auto& lex = parent.getLex();
+		for (std::size_t i = begin; i < end; i += m_Nodes[i].m_SubtreeSize)
+		{
+			auto& stackNode = m_Nodes[i];
+			Node  node { lex, stackNode.m_Rule };
+			node.setSourceSpan(stackNode.m_Span);
+			build(node, i + 1, i + stackNode.m_SubtreeSize);
+			parent.addChild(std::move(node));
+		}
+	}
+} // namespace CommonLexer
\ No newline at end of file
@@ -0,0 +1,399 @@
+#include "CommonLexer/Optimizer.h"
+#include "CommonLexer/GrammarWriter.h"
+#include "CommonLexer/Lexer.h"
+#include "CommonLexer/Matchers.h"
+#include "CommonLexer/Rules.h"
+
+#include <algorithm>
+
+namespace CommonLexer
+{
+	// Calls visitor with every matcher directly below matcher, references are not followed
+	template <class Visitor>
+	static void VisitChildren(const IMatcher& matcher, Visitor&& visitor)
+	{
+		switch (matcher.getKind())
+		{
+		case EMatcherKind::Combination:
+			for (auto& child : static_cast<const CombinationMatcher&>(matcher).getMatchers())
+				visitor(*child);
+			break;
+		case EMatcherKind::Or:
+			for (auto& child : static_cast<const OrMatcher&>(matcher).getMatchers())
+				visitor(*child);
+			break;
+		case EMatcherKind::Range: visitor(*static_cast<const RangeMatcher&>(matcher).getMatcher()); break;
+		case EMatcherKind::Optional: visitor(*static_cast<const OptionalMatcher&>(matcher).getMatcher()); break;
+		case EMatcherKind::Negative: visitor(*static_cast<const NegativeMatcher&>(matcher).getMatcher()); break;
+		case EMatcherKind::Space: visitor(*static_cast<const SpaceMatcher&>(matcher).getMatcher()); break;
+		case EMatcherKind::NamedGroup: visitor(*static_cast<const NamedGroupMatcher&>(matcher).getMatcher()); break;
+		case EMatcherKind::InlineRule: visitor(*static_cast<const InlineRuleMatcher&>(matcher).getMatcher()); break;
+		case EMatcherKind::SharedPrefix: visitor(*static_cast<const SharedPrefixMatcher&>(matcher).getMatcher()); break;
+		case EMatcherKind::MatcherRule: visitor(*static_cast<const MatcherRule&>(matcher).getMatcher()); break;
+		default: break;
+		}
+	}
+
+	static bool WriteCanonical(const IMatcher& matcher, std::string& canonical)
+	{
+		GrammarWriter writer;
+		if (!matcher.write(writer))
+			return false;
+		canonical.assign(writer.getData().begin(), writer.getData().end());
+		return true;
+	}
+
+	void OptimizeState::optimize(std::unique_ptr<IMatcher>& matcher)
+	{
+		if (auto replacement = matcher->optimize(*this))
+			matcher = std::move(replacement);
+	}
+
+	std::unique_ptr<IMatcher> OptimizeState::inlineRule(const IRule& rule)
+	{
+		if (rule.getKind() != EMatcherKind::MatcherRule)
+			return nullptr;
+
+		// Rules creating nodes need the rule around their matcher, and references to memoized rules replay the memo instead of matching
+		auto& matcherRule = static_cast<const MatcherRule&>(rule);
+		if (matcherRule.createsNode() || (m_Lexer.isMemoizing() && rule.isMemoized() && rule.isReplayable()))
+			return nullptr;
+		if (std::find(m_RuleStack.begin(), m_RuleStack.end(), &rule) != m_RuleStack.end())
+			return nullptr;
+		if (countMatchers(*matcherRule.getMatcher()) > m_Options.m_InlineLimit)
+			return nullptr;
+
+		auto matcher = matcherRule.getMatcher()->clone();
+		if (!matcher)
+			return nullptr;
+
+		m_RuleStack.push_back(&rule);
+		optimize(matcher);
+		m_RuleStack.pop_back();
+		return matcher;
+	}
+
+	std::shared_ptr<RegexProgram> OptimizeState::shareRegex(const std::shared_ptr<RegexProgram>& program)
+	{
+		return m_Regexes.try_emplace(program->m_Pattern, program).first->second;
+	}
+
+	bool OptimizeState::canSkip(const IMatcher& matcher)
+	{
+		switch (matcher.getKind())
+		{
+		case EMatcherKind::Combination: [[fallthrough]];
+		case EMatcherKind::Range: [[fallthrough]];
+		case EMatcherKind::Negative: [[fallthrough]];
+		case EMatcherKind::Space: [[fallthrough]];
+		case EMatcherKind::NamedGroupReference: [[fallthrough]];
+		case EMatcherKind::Text: [[fallthrough]];
+		case EMatcherKind::Regex: return false;
+		case EMatcherKind::Optional: return true;
+		case EMatcherKind::Or:
+			for (auto& alternative : static_cast<const OrMatcher&>(matcher).getMatchers())
+				if (canSkip(*alternative))
+					return true;
+			return false;
+		case EMatcherKind::NamedGroup: return canSkip(*static_cast<const NamedGroupMatcher&>(matcher).getMatcher());
+		case EMatcherKind::InlineRule: return canSkip(*static_cast<const InlineRuleMatcher&>(matcher).getMatcher());
+		case EMatcherKind::SharedPrefix: return canSkip(*static_cast<const SharedPrefixMatcher&>(matcher).getMatcher());
+		case EMatcherKind::Reference:
+		{
+			auto rule = static_cast<const ReferenceMatcher&>(matcher).getRule();
+			return rule && canSkip(*rule);
+		}
+		case EMatcherKind::MatcherRule:
+		{
+			// Recursive rules are assumed to skip until their matcher says otherwise
+			auto rule = static_cast<const IRule*>(&matcher);
+			if (auto itr = m_RuleSkips.find(rule); itr != m_RuleSkips.end())
+				return itr->second != ESkip::Never;
+
+			m_RuleSkips.insert({ rule, ESkip::Visiting });
+			bool skip         = canSkip(*static_cast<const MatcherRule&>(matcher).getMatcher());
+			m_RuleSkips[rule] = skip ? ESkip::Maybe : ESkip::Never;
+			return skip;
+		}
+		case EMatcherKind::CallbackRule: [[fallthrough]];
+		case EMatcherKind::Custom: [[fallthrough]];
+		default: return true;
+		}
+	}
+
+	std::size_t OptimizeState::countMatchers(const IMatcher& matcher) const
+	{
+		std::size_t count = 1;
+		VisitChildren(matcher, [&](const IMatcher& child) { count += countMatchers(child); });
+		return count;
+	}
+
+	bool OptimizeState::isStateless(const IMatcher& matcher)
+	{
+		switch (matcher.getKind())
+		{
+		// Forced spaces report a missing space for the rule they are used in
+		case EMatcherKind::Space:
+		{
+			auto& space = static_cast<const SpaceMatcher&>(matcher);
+			return !space.isForced() && isStateless(*space.getMatcher());
+		}
+		case EMatcherKind::SharedPrefix: return isStateless(*static_cast<const SharedPrefixMatcher&>(matcher).getMatcher());
+		case EMatcherKind::InlineRule:
+		{
+			std::unordered_set<const IRule*> visited;
+			return !readsState(matcher, visited);
+		}
+		case EMatcherKind::Reference:
+		{
+			// Entering a rule sets the rule messages are reported for, so only the named groups and callbacks below it are left
+			auto rule = static_cast<const ReferenceMatcher&>(matcher).getRule();
+			return rule && isStatelessRule(*rule);
+		}
+		default: return false;
+		}
+	}
+
+	bool OptimizeState::isStatelessRule(const IRule& rule)
+	{
+		if (auto itr = m_StatelessRules.find(&rule); itr != m_StatelessRules.end())
+			return itr->second;
+
+		std::unordered_set<const IRule*> visited { &rule };
+		bool                             stateless = !readsState(rule, visited);
+		m_StatelessRules.insert({ &rule, stateless });
+		return stateless;
+	}
+
+	void OptimizeState::findSharedPrefixes()
+	{
+		std::vector<std::string> prefixes;
+		for (std::uint32_t ruleID = 0; ruleID < m_Lexer.getRuleCount(); ++ruleID)
+			if (auto rule = m_Lexer.getRule(ruleID))
+				findSharedPrefixes(*rule, prefixes);
+
+		// IDs are only handed out once the prefixes shared by an earlier optimize have kept theirs
+		for (auto& prefix : prefixes)
+			if (m_SharedPrefixes.try_emplace(prefix, m_PrefixCount).second)
+				++m_PrefixCount;
+	}
+
+	void OptimizeState::findSharedPrefixes(const IMatcher& matcher, std::vector<std::string>& prefixes)
+	{
+		switch (matcher.getKind())
+		{
+		case EMatcherKind::SharedPrefix:
+		{
+			auto&       shared = static_cast<const SharedPrefixMatcher&>(matcher);
+			std::string canonical;
+			if (WriteCanonical(shared, canonical))
+				m_SharedPrefixes.insert_or_assign(std::move(canonical), shared.getPrefixID());
+			m_PrefixCount = std::max(m_PrefixCount, shared.getPrefixID() + 1);
+			break;
+		}
+		case EMatcherKind::Or:
+		{
+			std::vector<std::pair<std::string, const IMatcher*>> leading;
+			for (auto& alternative : static_cast<const OrMatcher&>(matcher).getMatchers())
+			{
+				std::string canonical;
+				if (auto prefix = getLeadingMatcher(*alternative); prefix && WriteCanonical(*prefix, canonical))
+					leading.emplace_back(std::move(canonical), prefix);
+			}
+
+			// Alternatives referencing the same rule reach the same matcher, that is not a shared prefix
+			for (std::size_t i = 0; i < leading.size(); ++i)
+			{
+				auto& [canonical, prefix] = leading[i];
+				bool shared               = false;
+				for (std::size_t j = i + 1; j < leading.size() && !shared; ++j)
+					shared = leading[j].first == canonical && leading[j].second != prefix;
+				if (shared && std::find(prefixes.begin(), prefixes.end(), canonical) == prefixes.end() && isStateless(*prefix))
+					prefixes.push_back(canonical);
+			}
+			break;
+		}
+		default: break;
+		}
+
+		VisitChildren(matcher, [&](const IMatcher& child) { findSharedPrefixes(child, prefixes); });
+	}
+
+	void OptimizeState::sharePrefix(std::unique_ptr<IMatcher>& matcher)
+	{
+		if (m_SharedPrefixes.empty() || matcher->getKind() == EMatcherKind::SharedPrefix)
+			return;
+
+		std::string canonical;
+		if (!WriteCanonical(*matcher, canonical))
+			return;
+		auto itr = m_SharedPrefixes.find(canonical);
+		if (itr == m_SharedPrefixes.end())
+			return;
+
+		matcher = std::make_unique<SharedPrefixMatcher>(itr->second, std::move(matcher));
+		++m_Stats.m_SharedPrefixes;
+	}
+
+	void OptimizeState::analyzeFirstSets()
+	{
+		m_FirstSets.emplace(m_Lexer);
+	}
+
+	std::vector<std::uint64_t> OptimizeState::buildDispatch(const std::vector<std::unique_ptr<IMatcher>>& alternatives)
+	{
+		// The mask has a bit per alternative, and alternatives reading named groups may see what an alternative left out would have set
+		if (!m_FirstSets || alternatives.size() < 2 || alternatives.size() > 64)
+			return {};
+		for (auto& alternative : alternatives)
+			if (readsState(*alternative))
+				return {};
+
+		// An alternative may be left out at a byte it can't start with, as long as the rule it may leave behind is hidden by the next alternative
+		std::vector<FirstSet> sets;
+		std::uint64_t         keep = 0;
+		for (std::size_t i = 0; i < alternatives.size(); ++i)
+		{
+			sets.push_back(m_FirstSets->getMatcherSet(*alternatives[i]));
+			if (sets[i].m_Nullable || i + 1 == alternatives.size() || (setsRule(*alternatives[i]) && !entersRule(*alternatives[i + 1])))
+				keep |= 1ULL << i;
+		}
+
+		std::vector<std::uint64_t> dispatch(256, keep);
+		bool                       skips = false;
+		for (std::size_t byte = 0; byte < 256; ++byte)
+		{
+			for (std::size_t i = 0; i < alternatives.size(); ++i)
+				if (sets[i].m_Bytes.test(byte))
+					dispatch[byte] |= 1ULL << i;
+			skips = skips || dispatch[byte] != (~0ULL >> (64 - alternatives.size()));
+		}
+		if (!skips)
+			return {};
+		return dispatch;
+	}
+
+	const IMatcher* OptimizeState::getLeadingMatcher(const IMatcher& alternative) const
+	{
+		// Every step but the combination enters a rule, so more steps than rules means the references loop
+		const IMatcher* matcher = &alternative;
+		for (std::size_t step = 0; step <= m_Lexer.getRuleCount(); ++step)
+		{
+			switch (matcher->getKind())
+			{
+			case EMatcherKind::Combination:
+			{
+				auto& matchers = static_cast<const CombinationMatcher&>(*matcher).getMatchers();
+				return matchers.empty() ? nullptr : matchers.front().get();
+			}
+			case EMatcherKind::Reference:
+			{
+				auto rule = static_cast<const ReferenceMatcher&>(*matcher).getRule();
+				if (!rule || rule->getKind() != EMatcherKind::MatcherRule)
+					return nullptr;
+				matcher = static_cast<const MatcherRule&>(*rule).getMatcher().get();
+				break;
+			}
+			case EMatcherKind::InlineRule: matcher = static_cast<const InlineRuleMatcher&>(*matcher).getMatcher().get(); break;
+			default: return nullptr;
+			}
+		}
+		return nullptr;
+	}
+
+	bool OptimizeState::readsState(const IMatcher& matcher, std::unordered_set<const IRule*>& visited) const
+	{
+		switch (matcher.getKind())
+		{
+		case EMatcherKind::NamedGroup: [[fallthrough]];
+		case EMatcherKind::NamedGroupReference: [[fallthrough]];
+		case EMatcherKind::CallbackRule: [[fallthrough]];
+		case EMatcherKind::Custom: return true;
+		case EMatcherKind::Reference:
+		{
+			auto rule = static_cast<const ReferenceMatcher&>(matcher).getRule();
+			if (!rule)
+				return true;
+			return visited.insert(rule).second && readsState(*rule, visited);
+		}
+		default:
+		{
+			bool reads = false;
+			VisitChildren(matcher, [&](const IMatcher& child) { reads = reads || readsState(child, visited); });
+			return reads;
+		}
+		}
+	}
+
+	bool OptimizeState::readsState(const IMatcher& matcher)
+	{
+		switch (matcher.getKind())
+		{
+		case EMatcherKind::NamedGroup: [[fallthrough]];
+		case EMatcherKind::NamedGroupReference: [[fallthrough]];
+		case EMatcherKind::CallbackRule: [[fallthrough]];
+		case EMatcherKind::Custom: return true;
+		case EMatcherKind::Reference: return !isStateless(matcher);
+		default:
+		{
+			bool reads = false;
+			VisitChildren(matcher, [&](const IMatcher& child) { reads = reads || readsState(child); });
+			return reads;
+		}
+		}
+	}
+
+	bool OptimizeState::setsRule(const IMatcher& matcher) const
+	{
+		switch (matcher.getKind())
+		{
+		case EMatcherKind::Reference: [[fallthrough]];
+		case EMatcherKind::InlineRule: [[fallthrough]];
+		case EMatcherKind::SharedPrefix: return true;
+		default:
+		{
+			bool sets = false;
+			VisitChildren(matcher, [&](const IMatcher& child) { sets = sets || setsRule(child); });
+			return sets;
+		}
+		}
+	}
+
+	bool OptimizeState::entersRule(const IMatcher& matcher) const
+	{
+		switch (matcher.getKind())
+		{
+		case EMatcherKind::Combination:
+		{
+			auto& matchers = static_cast<const CombinationMatcher&>(matcher).getMatchers();
+			return !matchers.empty() && entersRule(*matchers.front());
+		}
+		case EMatcherKind::Or:
+		{
+			auto& alternatives = static_cast<const OrMatcher&>(matcher).getMatchers();
+			return !alternatives.empty() && entersRule(*alternatives.front());
+		}
+		case EMatcherKind::Range:
+		{
+			auto& range = static_cast<const RangeMatcher&>(matcher);
+			return range.getUpperBounds() > 0 && entersRule(*range.getMatcher());
+		}
+		case EMatcherKind::Optional: return entersRule(*static_cast<const OptionalMatcher&>(matcher).getMatcher());
+		case EMatcherKind::Negative: return entersRule(*static_cast<const NegativeMatcher&>(matcher).getMatcher());
+		case EMatcherKind::Space:
+		{
+			// Forced spaces report a missing space before the matcher is reached
+			auto& space = static_cast<const SpaceMatcher&>(matcher);
+			return !space.isForced() && entersRule(*space.getMatcher());
+		}
+		case EMatcherKind::SharedPrefix: return entersRule(*static_cast<const SharedPrefixMatcher&>(matcher).getMatcher());
+		case EMatcherKind::InlineRule: return true;
+		case EMatcherKind::Reference:
+		{
+			auto rule = static_cast<const ReferenceMatcher&>(matcher).getRule();
+			return rule && rule->getKind() == EMatcherKind::MatcherRule;
+		}
+		default: return false;
+		}
+	}
+} // namespace CommonLexer
\ No newline at end of file
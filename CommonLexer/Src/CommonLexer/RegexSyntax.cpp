@@ -0,0 +1,471 @@
+#include "CommonLexer/RegexSyntax.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+namespace CommonLexer
+{
+	// std::regex refuses patterns whose automaton has more states than this
+	static constexpr std::size_t MaxRegexStates = 100000;
+
+	static constexpr std::array<std::string_view, 15> RegexClassNames { "d", "w", "s", "alnum", "alpha", "blank", "cntrl", "digit", "graph", "lower", "print", "punct", "space", "upper", "xdigit" };
+
+	static bool IsDigit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	static bool IsHexDigit(char c)
+	{
+		return IsDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+	}
+
+	static int HexValue(char c)
+	{
+		if (IsDigit(c))
+			return c - '0';
+		if (c >= 'a' && c <= 'f')
+			return c - 'a' + 10;
+		return c - 'A' + 10;
+	}
+
+	static std::size_t AddStates(std::size_t a, std::size_t b)
+	{
+		return std::min(a + b, MaxRegexStates + 1);
+	}
+
+	static std::size_t MulStates(std::size_t count, std::size_t states)
+	{
+		if (count == 0 || states == 0)
+			return 0;
+		return count > (MaxRegexStates + 1) / states ? MaxRegexStates + 1 : std::min(count * states, MaxRegexStates + 1);
+	}
+
+	// Follows the scanner and compiler of std::regex for the ECMAScript grammar, counting the states the compiled automaton would get
+	class RegexValidator
+	{
+	public:
+		RegexValidator(std::string_view pattern, std::string& error) : m_Pattern(pattern), m_Index(0), m_Error(error), m_GroupCount(1), m_OpenGroups({ 0 }) {}
+
+		bool validate()
+		{
+			std::size_t states = 3;
+			if (!disjunction(states))
+				return false;
+			if (m_Index < m_Pattern.size())
+				return fail("Unmatched ')'");
+			if (states > MaxRegexStates)
+				return fail("Pattern is too complex");
+			return true;
+		}
+
+	private:
+		enum class ETokenKind
+		{
+			Char,
+			Class,
+			Dash,
+			BracketEnd,
+			Invalid
+		};
+
+		struct Token
+		{
+		public:
+			ETokenKind m_Kind;
+			char       m_Value = '\0';
+		};
+
+	private:
+		bool fail(std::string_view reason)
+		{
+			m_Error = reason;
+			return false;
+		}
+
+		[[nodiscard]] bool atEnd() const { return m_Index >= m_Pattern.size(); }
+		[[nodiscard]] char peek() const { return m_Pattern[m_Index]; }
+
+		bool disjunction(std::size_t& states)
+		{
+			if (!alternative(states))
+				return false;
+			while (!atEnd() && peek() == '|')
+			{
+				++m_Index;
+				if (!alternative(states))
+					return false;
+				states = AddStates(states, 2);
+			}
+			return true;
+		}
+
+		bool alternative(std::size_t& states)
+		{
+			states = AddStates(states, 1);
+			while (!atEnd() && peek() != '|' && peek() != ')')
+			{
+				std::size_t termStates   = 0;
+				bool        quantifiable = false;
+				if (!term(termStates, quantifiable))
+					return false;
+				if (quantifiable && !quantifiers(termStates))
+					return false;
+				states = AddStates(states, termStates);
+			}
+			return true;
+		}
+
+		bool term(std::size_t& states, bool& quantifiable)
+		{
+			char c = m_Pattern[m_Index++];
+			switch (c)
+			{
+			case '^': [[fallthrough]];
+			case '$':
+				states = 1;
+				return true;
+			case '*': [[fallthrough]];
+			case '+': [[fallthrough]];
+			case '?': [[fallthrough]];
+			case '{': return fail("Nothing to repeat");
+			case '[':
+				states       = 1;
+				quantifiable = true;
+				return bracket();
+			case '(': return group(states, quantifiable);
+			case '\\': return escape(states, quantifiable);
+			default:
+				states       = 1;
+				quantifiable = true;
+				return true;
+			}
+		}
+
+		bool group(std::size_t& states, bool& quantifiable)
+		{
+			bool capturing = true;
+			bool lookahead = false;
+			if (!atEnd() && peek() == '?')
+			{
+				if (++m_Index == m_Pattern.size())
+					return fail("Unmatched '('");
+				char kind = m_Pattern[m_Index++];
+				if (kind == '=' || kind == '!')
+					lookahead = true;
+				else if (kind != ':')
+					return fail("Invalid '(?' group");
+				capturing = false;
+			}
+
+			if (capturing)
+				m_OpenGroups.push_back(m_GroupCount++);
+
+			std::size_t inner = 0;
+			if (!disjunction(inner))
+				return false;
+			if (atEnd())
+				return fail("Unmatched '('");
+			++m_Index;
+
+			if (capturing)
+				m_OpenGroups.pop_back();
+			states       = AddStates(inner, lookahead ? 2 : capturing ? 2 : 1);
+			quantifiable = !lookahead;
+			return true;
+		}
+
+		bool escape(std::size_t& states, bool& quantifiable)
+		{
+			if (atEnd())
+				return fail("Trailing '\\'");
+
+			states = 1;
+			char c = peek();
+			if (c == 'b' || c == 'B')
+			{
+				++m_Index;
+				return true;
+			}
+
+			quantifiable = true;
+			if (IsDigit(c) && c != '0')
+			{
+				std::size_t index = 0;
+				while (!atEnd() && IsDigit(peek()))
+					index = std::min<std::size_t>(index * 10 + static_cast<std::size_t>(m_Pattern[m_Index++] - '0'), m_GroupCount);
+				if (index >= m_GroupCount)
+					return fail("Back reference to a group that does not exist");
+				if (std::find(m_OpenGroups.begin(), m_OpenGroups.end(), index) != m_OpenGroups.end())
+					return fail("Back reference to a group inside of it");
+				return true;
+			}
+			return escapedChar().m_Kind != ETokenKind::Invalid;
+		}
+
+		// Reads the escape after a backslash that stands for a character or a class, word boundaries and back references are handled by escape
+		Token escapedChar()
+		{
+			char c = m_Pattern[m_Index++];
+			switch (c)
+			{
+			case '0': return { ETokenKind::Char, '\0' };
+			case 'b': return { ETokenKind::Char, '\b' };
+			case 'f': return { ETokenKind::Char, '\f' };
+			case 'n': return { ETokenKind::Char, '\n' };
+			case 'r': return { ETokenKind::Char, '\r' };
+			case 't': return { ETokenKind::Char, '\t' };
+			case 'v': return { ETokenKind::Char, '\v' };
+			case 'd': [[fallthrough]];
+			case 'D': [[fallthrough]];
+			case 's': [[fallthrough]];
+			case 'S': [[fallthrough]];
+			case 'w': [[fallthrough]];
+			case 'W': return { ETokenKind::Class };
+			case 'c':
+				if (atEnd())
+					return invalid("Incomplete '\\c' escape");
+				return { ETokenKind::Char, m_Pattern[m_Index++] };
+			case 'x': [[fallthrough]];
+			case 'u':
+			{
+				std::size_t digits = c == 'x' ? 2 : 4;
+				int         value  = 0;
+				for (std::size_t i = 0; i < digits; ++i)
+				{
+					if (atEnd() || !IsHexDigit(peek()))
+						return invalid(c == 'x' ? "Incomplete '\\x' escape" : "Incomplete '\\u' escape");
+					value = value * 16 + HexValue(m_Pattern[m_Index++]);
+				}
+				return { ETokenKind::Char, static_cast<char>(value) };
+			}
+			default:
+				if (IsDigit(c) || c == 'B')
+					return invalid("Unexpected escape in '[...]'");
+				return { ETokenKind::Char, c };
+			}
+		}
+
+		Token invalid(std::string_view reason)
+		{
+			fail(reason);
+			return { ETokenKind::Invalid };
+		}
+
+		Token bracketToken()
+		{
+			if (atEnd())
+				return invalid("Unmatched '['");
+
+			char c = m_Pattern[m_Index++];
+			switch (c)
+			{
+			case '-': return { ETokenKind::Dash };
+			case ']': return { ETokenKind::BracketEnd };
+			case '\\':
+				if (atEnd())
+					return invalid("Unmatched '['");
+				return escapedChar();
+			case '[':
+			{
+				if (atEnd())
+					return invalid("Unmatched '['");
+				char kind = peek();
+				if (kind != ':' && kind != '.' && kind != '=')
+					return { ETokenKind::Char, c };
+
+				std::size_t start = ++m_Index;
+				while (!atEnd() && peek() != kind)
+					++m_Index;
+				if (m_Index + 1 >= m_Pattern.size() || m_Pattern[m_Index + 1] != ']')
+					return invalid(kind == ':' ? "Unmatched '[:'" : "Unmatched '[.' or '[='");
+				auto name = m_Pattern.substr(start, m_Index - start);
+				m_Index += 2;
+
+				if (kind != ':')
+				{
+					// Only single character collating elements are accepted, std::regex knows a few named ones too
+					if (name.size() != 1)
+						return invalid("Unknown collating element");
+					return kind == '.' ? Token { ETokenKind::Char, name[0] } : Token { ETokenKind::Class };
+				}
+
+				std::string lower { name };
+				for (auto& nameChar : lower)
+					if (nameChar >= 'A' && nameChar <= 'Z')
+						nameChar = static_cast<char>(nameChar - 'A' + 'a');
+				if (std::find(RegexClassNames.begin(), RegexClassNames.end(), lower) == RegexClassNames.end())
+					return invalid("Unknown character class");
+				return { ETokenKind::Class };
+			}
+			default: return { ETokenKind::Char, c };
+			}
+		}
+
+		bool bracket()
+		{
+			if (!atEnd() && peek() == '^')
+				++m_Index;
+
+			// The last single character, which may start a range
+			bool hasLast     = false;
+			bool lastIsClass = false;
+			char last        = '\0';
+
+			Token token = bracketToken();
+			if (token.m_Kind == ETokenKind::Char || token.m_Kind == ETokenKind::Dash)
+			{
+				hasLast = true;
+				last    = token.m_Kind == ETokenKind::Dash ? '-' : token.m_Value;
+				token   = bracketToken();
+			}
+
+			while (true)
+			{
+				switch (token.m_Kind)
+				{
+				case ETokenKind::Invalid: return false;
+				case ETokenKind::BracketEnd: return true;
+				case ETokenKind::Char:
+					hasLast     = true;
+					lastIsClass = false;
+					last        = token.m_Value;
+					break;
+				case ETokenKind::Class:
+					hasLast     = false;
+					lastIsClass = true;
+					break;
+				case ETokenKind::Dash:
+				{
+					Token end = bracketToken();
+					if (end.m_Kind == ETokenKind::Invalid)
+						return false;
+					if (end.m_Kind == ETokenKind::BracketEnd)
+						return true;
+					if (lastIsClass)
+						return fail("Invalid start of '[x-x]' range");
+					if (hasLast)
+					{
+						if (end.m_Kind == ETokenKind::Dash)
+							end.m_Value = '-';
+						else if (end.m_Kind != ETokenKind::Char)
+							return fail("Invalid end of '[x-x]' range");
+						if (last > end.m_Value)
+							return fail("Invalid range in '[...]'");
+						hasLast = false;
+						break;
+					}
+					// A dash that does not continue a range is a literal, and the token after it is handled on its own
+					hasLast = true;
+					last    = '-';
+					token   = end;
+					continue;
+				}
+				}
+				token = bracketToken();
+			}
+		}
+
+		bool quantifiers(std::size_t& states)
+		{
+			while (!atEnd())
+			{
+				char c = peek();
+				if (c == '*' || c == '+')
+				{
+					++m_Index;
+					states = AddStates(states, 1);
+				}
+				else if (c == '?')
+				{
+					++m_Index;
+					states = AddStates(states, 2);
+				}
+				else if (c == '{')
+				{
+					++m_Index;
+					if (!interval(states))
+						return false;
+				}
+				else
+				{
+					break;
+				}
+
+				// A '?' directly after a quantifier makes it lazy
+				if (!atEnd() && peek() == '?')
+					++m_Index;
+			}
+			return true;
+		}
+
+		bool interval(std::size_t& states)
+		{
+			std::size_t min = 0;
+			if (!count(min))
+				return false;
+
+			bool        infinite = false;
+			std::size_t max      = min;
+			if (!atEnd() && peek() == ',')
+			{
+				++m_Index;
+				if (!atEnd() && IsDigit(peek()))
+				{
+					if (!count(max))
+						return false;
+				}
+				else
+				{
+					infinite = true;
+				}
+			}
+			if (atEnd())
+				return fail("Unmatched '{'");
+			if (peek() != '}')
+				return fail("Invalid '{...}' interval");
+			++m_Index;
+			if (!infinite && max < min)
+				return fail("Invalid '{...}' interval");
+
+			// The repeated states are copied for every required and every optional repetition
+			std::size_t repeated = states;
+			states               = AddStates(repeated, 1 + MulStates(min, repeated));
+			if (infinite)
+				states = AddStates(states, repeated + 1);
+			else
+				states = AddStates(states, 1 + MulStates(max - min, repeated + 1));
+			return true;
+		}
+
+		bool count(std::size_t& value)
+		{
+			if (atEnd())
+				return fail("Unmatched '{'");
+			if (!IsDigit(peek()))
+				return fail("Invalid '{...}' interval");
+			value = 0;
+			while (!atEnd() && IsDigit(peek()))
+				value = std::min<std::size_t>(value * 10 + static_cast<std::size_t>(m_Pattern[m_Index++] - '0'), MaxRegexStates + 1);
+			return true;
+		}
+
+	private:
+		std::string_view         m_Pattern;
+		std::size_t              m_Index;
+		std::string&             m_Error;
+		std::size_t              m_GroupCount;
+		std::vector<std::size_t> m_OpenGroups;
+	};
+
+	bool ValidateRegex(std::string_view pattern, std::string& error)
+	{
+		error.clear();
+		RegexValidator validator { pattern, error };
+		return validator.validate();
+	}
+} // namespace CommonLexer
\ No newline at end of file
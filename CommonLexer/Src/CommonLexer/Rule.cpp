@@ -3,8 +3,8 @@
 namespace CommonLexer
 {
 	IRule::IRule(const std::string& name)
-	    : m_Name(name) {}
+	    : m_Name(name), m_ID(InvalidRuleID), m_Memoized(true), m_Replayable(false) {}
 
 	IRule::IRule(std::string&& name)
-	    : m_Name(std::move(name)) {}
+	    : m_Name(std::move(name)), m_ID(InvalidRuleID), m_Memoized(true), m_Replayable(false) {}
 } // namespace CommonLexer
\ No newline at end of file
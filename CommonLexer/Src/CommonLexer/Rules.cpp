@@ -1,5 +1,7 @@
 #include "CommonLexer/Rules.h"
-#include "CommonLexer/Node.h"
+#include "CommonLexer/GrammarWriter.h"
+#include "CommonLexer/NodeStack.h"
+#include "CommonLexer/Optimizer.h"
 
 namespace CommonLexer
 {
@@ -12,20 +14,22 @@ namespace CommonLexer
 	MatcherRule::MatcherRule(MatcherRule&& move) noexcept
 	    : IRule(std::move(move)), m_Matcher(std::move(move.m_Matcher)), m_CreateNode(move.m_CreateNode) {}
 
-	MatchResult MatcherRule::match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span)
+	MatchResult MatcherRule::match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const
 	{
 		state.setCurrentRule(this, span.m_Start);
 		if (m_CreateNode)
 		{
-			Node               currentNode { *state.m_Lex, getID() };
-			MatcherScopedState newScopedState { &currentNode };
+			auto&              nodes = *state.m_Nodes;
+			std::size_t        index = nodes.open(getID());
+			MatcherScopedState newScopedState;
 
+			++state.m_Speculation;
 			auto result = m_Matcher->match(state, newScopedState, span);
+			--state.m_Speculation;
 			if (result.m_Status == EMatchStatus::Success)
-			{
-				currentNode.setSourceSpan(result.m_Span);
-				scopedState.m_ParentNode->addChild(std::move(currentNode));
-			}
+				nodes.close(index, result.m_Span);
+			else
+				nodes.rollback(index);
 			scopedState.addMessages(newScopedState);
 			return result;
 		}
@@ -35,6 +39,25 @@ namespace CommonLexer
 		}
 	}
 
+	void MatcherRule::link(const Lexer& lexer, LinkState& linkState)
+	{
+		m_Matcher->link(lexer, linkState);
+	}
+
+	bool MatcherRule::write(GrammarWriter& writer) const
+	{
+		writer.writeBool(m_CreateNode);
+		return m_Matcher->write(writer);
+	}
+
+	std::unique_ptr<IMatcher> MatcherRule::optimize(OptimizeState& state)
+	{
+		state.m_RuleStack.push_back(this);
+		state.optimize(m_Matcher);
+		state.m_RuleStack.pop_back();
+		return nullptr;
+	}
+
 	CallbackRule::CallbackRule(const std::string& name, Callback&& callback)
 	    : IRule(name), m_Callback(std::move(callback)) {}
 
@@ -44,7 +67,7 @@ namespace CommonLexer
 	CallbackRule::CallbackRule(CallbackRule&& move) noexcept
 	    : IRule(std::move(move)), m_Callback(std::move(move.m_Callback)) {}
 
-	MatchResult CallbackRule::match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span)
+	MatchResult CallbackRule::match(MatcherState& state, MatcherScopedState& scopedState, SourceSpan span) const
 	{
 		return m_Callback(state, scopedState, span);
 	}
@@ -1,17 +1,118 @@
 #include "CommonLexer/Source.h"
 
+#include <algorithm>
+#include <numeric>
+
 namespace CommonLexer
 {
+	static std::size_t UTF8Codepoints(std::string_view str)
+	{
+		std::size_t count = 0;
+		for (char c : str)
+			count += (static_cast<std::uint8_t>(c) & 0b1100'0000U) != 0b1000'0000U;
+		return count;
+	}
+
+	// Visits points in ascending order while walking the lines once, getText is only used for UTF-8 columns
+	template <class GetIndexFromLine, class GetText>
+	static void ResolveLocationsSweep(std::span<const SourcePoint> points, std::span<SourceLocation> locations, bool utf8Columns, GetIndexFromLine&& getIndexFromLine, GetText&& getText)
+	{
+		std::size_t count = std::min(points.size(), locations.size());
+
+		std::vector<std::size_t> order;
+		bool sorted = std::is_sorted(points.begin(), points.begin() + count, [](SourcePoint lhs, SourcePoint rhs) { return lhs.m_Index < rhs.m_Index; });
+		if (!sorted)
+		{
+			order.resize(count);
+			std::iota(order.begin(), order.end(), 0);
+			std::sort(order.begin(), order.end(), [points](std::size_t lhs, std::size_t rhs) { return points[lhs].m_Index < points[rhs].m_Index; });
+		}
+
+		std::size_t line          = 1;
+		std::size_t lineStart     = getIndexFromLine(1);
+		std::size_t nextLineStart = getIndexFromLine(2);
+		if (lineStart == ~0ULL)
+			lineStart = 0;
+
+		std::size_t countedIndex   = lineStart;
+		std::size_t countedColumns = 0;
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			std::size_t pointIndex = sorted ? i : order[i];
+			std::size_t index      = points[pointIndex].m_Index;
+
+			while (nextLineStart != ~0ULL && nextLineStart <= index)
+			{
+				++line;
+				lineStart      = nextLineStart;
+				nextLineStart  = getIndexFromLine(line + 1);
+				countedIndex   = lineStart;
+				countedColumns = 0;
+			}
+
+			auto& location  = locations[pointIndex];
+			location.m_Line = line;
+			if (utf8Columns)
+			{
+				if (index > countedIndex)
+				{
+					countedColumns += UTF8Codepoints(getText(countedIndex, index - countedIndex));
+					countedIndex = index;
+				}
+				location.m_Column = countedColumns + 1;
+			}
+			else
+			{
+				location.m_Column = index - lineStart + 1;
+			}
+		}
+	}
+
+	std::string_view ISource::getSpanView(std::size_t index, std::size_t length, std::string& fallback)
+	{
+		std::size_t size = getSize();
+		if (index >= size)
+			return {};
+
+		if ((index + length) >= size)
+			length = size - index;
+
+		auto chunk = getChunk(index);
+		if (chunk.isContiguous() && chunk.contains(index, length))
+			return chunk.m_Data.substr(index - chunk.m_Start, length);
+
+		fallback = getSpan(index, length);
+		return fallback;
+	}
+
+	void ISource::resolveLocations(std::span<const SourcePoint> points, std::span<SourceLocation> locations, bool utf8Columns)
+	{
+		std::string fallback;
+		ResolveLocationsSweep(
+		    points,
+		    locations,
+		    utf8Columns,
+		    [this](std::size_t line) { return getIndexFromLine(line); },
+		    [this, &fallback](std::size_t index, std::size_t length) { return getSpanView(index, length, fallback); });
+	}
+
+	std::vector<SourceLocation> ISource::resolveLocations(std::span<const SourcePoint> points, bool utf8Columns)
+	{
+		std::vector<SourceLocation> locations(points.size());
+		resolveLocations(points, locations, utf8Columns);
+		return locations;
+	}
+
 	StringSource::StringSource(const std::string& str)
 	    : m_Str(str)
 	{
-		setupLineToIndex();
+		m_LineIndex.build(m_Str);
 	}
 
 	StringSource::StringSource(std::string&& str)
 	    : m_Str(std::move(str))
 	{
-		setupLineToIndex();
+		m_LineIndex.build(m_Str);
 	}
 
 	std::size_t StringSource::getSize()
@@ -21,31 +122,33 @@ namespace CommonLexer
 
 	std::size_t StringSource::getNumLines()
 	{
-		return m_LineToIndex.size();
+		return m_LineIndex.getNumLines();
 	}
 
 	std::size_t StringSource::getIndexFromLine(std::size_t line)
 	{
-		return line > 0 && line <= m_LineToIndex.size() ? m_LineToIndex[line - 1] : ~0ULL;
+		return m_LineIndex.getIndexFromLine(line);
 	}
 
 	std::size_t StringSource::getLineFromIndex(std::size_t index)
 	{
-		for (std::size_t i = m_LineToIndex.size(); i > 0; --i)
-			if (m_LineToIndex[i - 1] <= index)
-				return i;
-		return ~0ULL;
+		return m_LineIndex.getLineFromIndex(index);
 	}
 
 	std::size_t StringSource::getColumnFromIndex(std::size_t index)
 	{
-		std::size_t line = getLineFromIndex(index);
-		if (line == ~0ULL)
-			return 1;
-		std::size_t lineStart = getIndexFromLine(line);
-		if (lineStart == ~0ULL)
-			return 1;
-		return index - lineStart + 1;
+		return m_LineIndex.getColumnFromIndex(index);
+	}
+
+	void StringSource::resolveLocations(std::span<const SourcePoint> points, std::span<SourceLocation> locations, bool utf8Columns)
+	{
+		std::string_view view = m_Str;
+		ResolveLocationsSweep(
+		    points,
+		    locations,
+		    utf8Columns,
+		    [this](std::size_t line) { return m_LineIndex.getIndexFromLine(line); },
+		    [view](std::size_t index, std::size_t length) { return view.substr(std::min(index, view.size()), length); });
 	}
 
 	std::string StringSource::getSpan(std::size_t index, std::size_t length)
@@ -59,6 +162,13 @@ namespace CommonLexer
 		return m_Str.substr(index, length);
 	}
 
+	SourceChunk StringSource::getChunk(std::size_t index)
+	{
+		if (index > m_Str.size())
+			return { index, {} };
+		return { 0, m_Str };
+	}
+
 	std::string StringSource::getLine(std::size_t line)
 	{
 		std::size_t lineStart = getIndexFromLine(line);
@@ -79,11 +189,110 @@ namespace CommonLexer
 		return lns;
 	}
 
-	void StringSource::setupLineToIndex()
+	MappedFileSource::MappedFileSource(const std::filesystem::path& filepath, MappedFileFlags flags)
+	    : m_File(filepath, flags) {}
+
+	bool MappedFileSource::open(const std::filesystem::path& filepath, MappedFileFlags flags)
+	{
+		m_LineIndex.clear();
+		m_LineIndexBuilt.store(false, std::memory_order_relaxed);
+		return m_File.open(filepath, flags);
+	}
+
+	void MappedFileSource::close()
+	{
+		m_LineIndex.clear();
+		m_LineIndexBuilt.store(false, std::memory_order_relaxed);
+		m_File.close();
+	}
+
+	std::size_t MappedFileSource::getSize()
+	{
+		return m_File.getSize();
+	}
+
+	std::size_t MappedFileSource::getNumLines()
+	{
+		return getLineIndex().getNumLines();
+	}
+
+	std::size_t MappedFileSource::getIndexFromLine(std::size_t line)
+	{
+		return getLineIndex().getIndexFromLine(line);
+	}
+
+	std::size_t MappedFileSource::getLineFromIndex(std::size_t index)
+	{
+		return getLineIndex().getLineFromIndex(index);
+	}
+
+	std::size_t MappedFileSource::getColumnFromIndex(std::size_t index)
+	{
+		return getLineIndex().getColumnFromIndex(index);
+	}
+
+	void MappedFileSource::resolveLocations(std::span<const SourcePoint> points, std::span<SourceLocation> locations, bool utf8Columns)
+	{
+		auto&            lineIndex = getLineIndex();
+		std::string_view view      = m_File.getView();
+		ResolveLocationsSweep(
+		    points,
+		    locations,
+		    utf8Columns,
+		    [&lineIndex](std::size_t line) { return lineIndex.getIndexFromLine(line); },
+		    [view](std::size_t index, std::size_t length) { return view.substr(std::min(index, view.size()), length); });
+	}
+
+	std::string MappedFileSource::getSpan(std::size_t index, std::size_t length)
+	{
+		std::string_view view = m_File.getView();
+		if (index >= view.size())
+			return {};
+
+		if ((index + length) >= view.size())
+			length = view.size() - index;
+
+		return std::string { view.substr(index, length) };
+	}
+
+	SourceChunk MappedFileSource::getChunk(std::size_t index)
+	{
+		if (!m_File.getData() || index > m_File.getSize())
+			return { index, {} };
+		return { 0, m_File.getView() };
+	}
+
+	std::string MappedFileSource::getLine(std::size_t line)
+	{
+		std::size_t lineStart = getIndexFromLine(line);
+		if (lineStart == ~0ULL)
+			return {};
+		std::size_t lineEnd = getIndexFromLine(line + 1);
+		if (lineEnd == ~0ULL)
+			lineEnd = m_File.getSize() + 1;
+		return std::string { m_File.getView().substr(lineStart, lineEnd - lineStart - 1) };
+	}
+
+	std::vector<std::string> MappedFileSource::getLines(std::size_t startLine, std::size_t lines)
+	{
+		std::vector<std::string> lns;
+		lns.reserve(lines);
+		for (std::size_t line = startLine, end = startLine + lines; line != end; ++line)
+			lns.push_back(getLine(line));
+		return lns;
+	}
+
+	const LineIndex& MappedFileSource::getLineIndex()
 	{
-		m_LineToIndex.emplace_back(0);
-		for (std::size_t i = 0; i < m_Str.size(); ++i)
-			if (m_Str[i] == '\n')
-				m_LineToIndex.emplace_back(i + 1);
+		if (m_LineIndexBuilt.load(std::memory_order_acquire))
+			return m_LineIndex;
+
+		std::lock_guard lock { m_LineIndexMutex };
+		if (!m_LineIndexBuilt.load(std::memory_order_relaxed))
+		{
+			m_LineIndex.build(m_File.getView());
+			m_LineIndexBuilt.store(true, std::memory_order_release);
+		}
+		return m_LineIndex;
 	}
 } // namespace CommonLexer
\ No newline at end of file
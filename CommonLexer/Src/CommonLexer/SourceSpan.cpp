@@ -13,14 +13,25 @@ namespace CommonLexer
 		return source->getColumnFromIndex(m_Index);
 	}
 
-	void SourceIterator::recache()
+	void SourceIterator::fetch()
 	{
-		if (m_Source && m_CacheOffset >= m_Cache.size())
+		if (!m_Source)
+			return;
+
+		if (m_Point.m_Index - m_CacheStart < m_Cache.size())
+			return;
+
+		auto chunk = m_Source->getChunk(m_Point.m_Index);
+		if (chunk.isContiguous())
 		{
-			std::size_t index = m_Point.m_Index < 128 ? 0 : m_Point.m_Index - 128;
-			m_Cache           = m_Source->getSpan(index, 256);
-			m_CacheOffset     = m_Point.m_Index < 128 ? m_Point.m_Index : 128;
+			m_ChunkStart = chunk.m_Start;
+			m_Chunk      = chunk.m_Data.data();
+			m_ChunkSize  = chunk.m_Data.size();
+			return;
 		}
+
+		m_CacheStart = m_Point.m_Index < 128 ? 0 : m_Point.m_Index - 128;
+		m_Cache      = m_Source->getSpan(m_CacheStart, 256);
 	}
 
 	SourceIterator SourceSpan::begin(ISource* source)
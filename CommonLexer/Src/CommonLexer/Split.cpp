@@ -0,0 +1,68 @@
+#include "CommonLexer/Split.h"
+
+#include <algorithm>
+
+namespace CommonLexer
+{
+	static bool IsWhitespace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+	}
+
+	std::vector<std::size_t> FindSplitPoints(std::string_view text, const SplitOptions& options, std::size_t chunkCount)
+	{
+		std::vector<std::size_t> points;
+
+		std::size_t chunkSize = std::max(text.size() / std::max<std::size_t>(chunkCount, 1), options.m_MinChunkSize);
+		if (chunkSize == 0 || text.size() <= chunkSize)
+			return points;
+
+		std::size_t target     = chunkSize;
+		std::size_t depth      = 0;
+		bool        terminated = false;
+		for (std::size_t i = 0; i < text.size(); ++i)
+		{
+			char c = text[i];
+			if (IsWhitespace(c))
+				continue;
+
+			if (i >= target && depth == 0 && terminated && (!options.m_LineStart || text[i - 1] == '\n'))
+			{
+				if (text.size() - i < options.m_MinChunkSize)
+					break;
+				points.push_back(i);
+				target = i + chunkSize;
+			}
+
+			if (!options.m_LineComment.empty() && text.substr(i, options.m_LineComment.size()) == options.m_LineComment)
+			{
+				auto end = text.find('\n', i);
+				if (end == std::string_view::npos)
+					break;
+				i = end;
+				continue;
+			}
+
+			terminated = options.m_Terminators.find(c) != std::string::npos;
+			if (options.m_Quotes.find(c) != std::string::npos)
+			{
+				// Quotes end at the matching quote or the end of the line, backslashes escape the next character
+				for (++i; i < text.size() && text[i] != c && text[i] != '\n'; ++i)
+				{
+					if (text[i] == '\\')
+						++i;
+				}
+			}
+			else if (options.m_OpenBrackets.find(c) != std::string::npos)
+			{
+				++depth;
+			}
+			else if (options.m_CloseBrackets.find(c) != std::string::npos)
+			{
+				if (depth > 0)
+					--depth;
+			}
+		}
+		return points;
+	}
+} // namespace CommonLexer
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "CommonLexer/ThreadPool.h"
+
+#include <algorithm>
+
+namespace CommonLexer
+{
+	ThreadPool::ThreadPool(std::size_t threadCount)
+	    : m_Stopping(false), m_Queued(0), m_Pending(0), m_NextWorker(0)
+	{
+		if (threadCount == 0)
+			threadCount = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+
+		m_Workers.reserve(threadCount);
+		for (std::size_t i = 0; i < threadCount; ++i)
+			m_Workers.emplace_back(std::make_unique<Worker>());
+		for (std::size_t i = 0; i < threadCount; ++i)
+			m_Workers[i]->m_Thread = std::thread(&ThreadPool::run, this, i);
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard lock { m_Mutex };
+			m_Stopping = true;
+		}
+		m_WorkAvailable.notify_all();
+		for (auto& worker : m_Workers)
+			worker->m_Thread.join();
+	}
+
+	void ThreadPool::submit(std::size_t worker, Task&& task)
+	{
+		++m_Pending;
+		// Counted before the task is visible, otherwise a worker popping it first would wrap the count around
+		{
+			std::lock_guard lock { m_Mutex };
+			++m_Queued;
+		}
+		{
+			auto&           queue = *m_Workers[worker % m_Workers.size()];
+			std::lock_guard lock { queue.m_Mutex };
+			queue.m_Tasks.push_back(std::move(task));
+		}
+		m_WorkAvailable.notify_one();
+	}
+
+	void ThreadPool::submit(Task&& task)
+	{
+		submit(m_NextWorker++, std::move(task));
+	}
+
+	void ThreadPool::wait()
+	{
+		std::unique_lock lock { m_Mutex };
+		m_Idle.wait(lock, [this]() { return m_Pending == 0; });
+	}
+
+	void ThreadPool::run(std::size_t worker)
+	{
+		Task task;
+		while (true)
+		{
+			if (popTask(worker, task))
+			{
+				task(worker);
+				task = nullptr;
+				if (--m_Pending == 0)
+				{
+					std::lock_guard lock { m_Mutex };
+					m_Idle.notify_all();
+				}
+				continue;
+			}
+
+			std::unique_lock lock { m_Mutex };
+			m_WorkAvailable.wait(lock, [this]() { return m_Stopping || m_Queued > 0; });
+			if (m_Stopping && m_Queued == 0)
+				return;
+		}
+	}
+
+	bool ThreadPool::popTask(std::size_t worker, Task& task)
+	{
+		// Own tasks are taken from the back and stolen tasks from the front, so the owner and thieves rarely contend for the same end
+		{
+			auto&           queue = *m_Workers[worker];
+			std::lock_guard lock { queue.m_Mutex };
+			if (!queue.m_Tasks.empty())
+			{
+				task = std::move(queue.m_Tasks.back());
+				queue.m_Tasks.pop_back();
+				--m_Queued;
+				return true;
+			}
+		}
+
+		for (std::size_t i = 1; i < m_Workers.size(); ++i)
+		{
+			auto&           queue = *m_Workers[(worker + i) % m_Workers.size()];
+			std::lock_guard lock { queue.m_Mutex };
+			if (!queue.m_Tasks.empty())
+			{
+				task = std::move(queue.m_Tasks.front());
+				queue.m_Tasks.pop_front();
+				--m_Queued;
+				return true;
+			}
+		}
+		return false;
+	}
+} // namespace CommonLexer
\ No newline at end of file
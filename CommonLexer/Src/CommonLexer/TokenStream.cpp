@@ -0,0 +1,34 @@
+#include "CommonLexer/TokenStream.h"
+
+namespace CommonLexer
+{
+	static void AppendTokens(std::span<const StackNode> nodes, ETokenFilter filter, std::uint32_t depth, std::uint32_t parent, std::vector<Token>& tokens)
+	{
+		for (std::size_t i = 0; i < nodes.size(); i += nodes[i].m_SubtreeSize)
+		{
+			auto& node     = nodes[i];
+			auto  children = nodes.subspan(i + 1, node.m_SubtreeSize - 1);
+			if (filter == ETokenFilter::All || children.empty())
+			{
+				tokens.push_back({ node.m_Span, node.m_Rule, depth, parent });
+				if (!children.empty())
+					AppendTokens(children, filter, depth + 1, static_cast<std::uint32_t>(tokens.size() - 1), tokens);
+			}
+			else
+			{
+				AppendTokens(children, filter, depth + 1, InvalidTokenIndex, tokens);
+			}
+		}
+	}
+
+	void TokenStream::clear()
+	{
+		m_Tokens.clear();
+		m_Messages.clear();
+	}
+
+	void AppendTokens(std::span<const StackNode> nodes, ETokenFilter filter, std::vector<Token>& tokens)
+	{
+		AppendTokens(nodes, filter, 0, InvalidTokenIndex, tokens);
+	}
+} // namespace CommonLexer
\ No newline at end of file
@@ -0,0 +1,498 @@
+#include "GrammarLexer/GrammarCompiler.h"
+#include "CommonLexer/Source.h"
+#include "GrammarLexer/GrammarLexer.h"
+
+#include <fmt/format.h>
+
+#include <charconv>
+#include <utility>
+
+namespace GrammarLexer
+{
+	using namespace CommonLexer;
+
+	// Removes the quotes around a text or regex matcher and resolves its escape sequences, unknown escapes are kept as written so regex escapes survive
+	static std::string Unescape(std::string_view text)
+	{
+		if (text.size() >= 2)
+			text = text.substr(1, text.size() - 2);
+
+		std::string result;
+		result.reserve(text.size());
+		for (std::size_t i = 0; i < text.size(); ++i)
+		{
+			char c = text[i];
+			if (c != '\\' || i + 1 >= text.size())
+			{
+				result += c;
+				continue;
+			}
+
+			switch (char escaped = text[++i])
+			{
+			case '\\': [[fallthrough]];
+			case '"': [[fallthrough]];
+			case '\'': result += escaped; break;
+			case 'n': result += '\n'; break;
+			case 'r': result += '\r'; break;
+			case 't': result += '\t'; break;
+			case '0': result += '\0'; break;
+			default:
+				result += '\\';
+				result += escaped;
+				break;
+			}
+		}
+		return result;
+	}
+
+	void GrammarCompiler::setCallback(const std::string& rule, CallbackRule::Callback&& callback)
+	{
+		m_Callbacks.insert_or_assign(rule, std::move(callback));
+	}
+
+	bool GrammarCompiler::compile(ISource* source, Lexer& lexer)
+	{
+		GrammarLexer grammarLexer;
+		auto         grammar = grammarLexer.lexSource(source);
+		return compile(grammar, lexer);
+	}
+
+	bool GrammarCompiler::compile(const Lex& grammar, Lexer& lexer)
+	{
+		m_Errors.clear();
+		m_Grammar = &grammar;
+		m_Lexer   = &lexer;
+
+		auto grammarLexer = grammar.getLexer();
+		m_Kinds.assign(grammarLexer->getRuleCount(), ENodeKind::Unknown);
+		static const std::unordered_map<std::string_view, ENodeKind> s_Kinds {
+			{ "BlockDeclaration", ENodeKind::BlockDeclaration },
+			{ "OptionDeclaration", ENodeKind::OptionDeclaration },
+			{ "RuleDeclaration", ENodeKind::RuleDeclaration },
+			{ "NodelessRuleDeclaration", ENodeKind::NodelessRuleDeclaration },
+			{ "CallbackRuleDeclaration", ENodeKind::CallbackRuleDeclaration },
+			{ "Identifier", ENodeKind::Identifier },
+			{ "Boolean", ENodeKind::Boolean },
+			{ "Integer", ENodeKind::Integer },
+			{ "Branch", ENodeKind::Branch },
+			{ "CombinationMatcher", ENodeKind::CombinationMatcher },
+			{ "OrMatcher", ENodeKind::OrMatcher },
+			{ "ZeroOrMore", ENodeKind::ZeroOrMore },
+			{ "OneOrMore", ENodeKind::OneOrMore },
+			{ "ExactAmount", ENodeKind::ExactAmount },
+			{ "RangeMatcher", ENodeKind::RangeMatcher },
+			{ "OptionalMatcher", ENodeKind::OptionalMatcher },
+			{ "NegativeMatcher", ENodeKind::NegativeMatcher },
+			{ "LenientSpaceMatcher", ENodeKind::LenientSpaceMatcher },
+			{ "ForcedSpaceMatcher", ENodeKind::ForcedSpaceMatcher },
+			{ "Group", ENodeKind::Group },
+			{ "NamedGroupMatcher", ENodeKind::NamedGroupMatcher },
+			{ "NamedGroupReferenceMatcher", ENodeKind::NamedGroupReferenceMatcher },
+			{ "ReferenceMatcher", ENodeKind::ReferenceMatcher },
+			{ "TextMatcher", ENodeKind::TextMatcher },
+			{ "RegexMatcher", ENodeKind::RegexMatcher }
+		};
+		for (std::uint32_t i = 0; i < m_Kinds.size(); ++i)
+		{
+			auto itr = s_Kinds.find(grammarLexer->getRule(i)->getName());
+			if (itr != s_Kinds.end())
+				m_Kinds[i] = itr->second;
+		}
+
+		for (auto& message : grammar.getMessages())
+		{
+			if (message.getSeverity() != EMessageSeverity::Error)
+				continue;
+
+			auto source = grammar.getSource();
+			auto point  = message.getPoint();
+			m_Errors.push_back(fmt::format("{}:{}: {}", point.getLine(source), point.getColumn(source), message.getMessage()));
+		}
+
+		if (m_Errors.empty())
+		{
+			lexer.clearRules();
+			compileDeclarations(grammar.getRoot(), {});
+			if (m_Errors.empty() && !lexer.finalize())
+				m_Errors.insert(m_Errors.end(), lexer.getFinalizeErrors().begin(), lexer.getFinalizeErrors().end());
+		}
+
+		m_Grammar = nullptr;
+		m_Lexer   = nullptr;
+		return m_Errors.empty();
+	}
+
+	void GrammarCompiler::compileDeclarations(const Node& node, Options options)
+	{
+		for (auto& child : node.getChildren())
+		{
+			switch (getKind(child))
+			{
+			case ENodeKind::BlockDeclaration: compileDeclarations(child, options); break;
+			case ENodeKind::OptionDeclaration: compileOption(child, options); break;
+			case ENodeKind::RuleDeclaration: compileRule(child, options, true); break;
+			case ENodeKind::NodelessRuleDeclaration: compileRule(child, options, false); break;
+			case ENodeKind::CallbackRuleDeclaration: compileCallbackRule(child); break;
+			default: addError(child, "Expected a declaration"); break;
+			}
+		}
+	}
+
+	void GrammarCompiler::compileOption(const Node& node, Options& options)
+	{
+		auto& children = node.getChildren();
+		if (children.size() != 2)
+		{
+			addError(node, "Expected an option name and value");
+			return;
+		}
+
+		std::string name  = getText(children[0]);
+		auto&       value = children[1];
+		std::string text  = getKind(value) == ENodeKind::TextMatcher ? Unescape(getText(value)) : getText(value);
+		if (name == "MainRule")
+		{
+			m_Lexer->setMainRule(text);
+		}
+		else if (name == "Memoization")
+		{
+			// 'true' and 'false' also lex as identifiers, so the text decides
+			if (text == "true" || text == "false")
+				m_Lexer->setMemoization(text == "true");
+			else
+				addError(value, "Memoization expects 'true' or 'false'");
+		}
+		else if (name == "SpaceMethod")
+		{
+			if (text == "Normal")
+				options.m_SpaceMethod = ESpaceMethod::Normal;
+			else if (text == "Whitespace")
+				options.m_SpaceMethod = ESpaceMethod::Whitespace;
+			else
+				addError(value, fmt::format("Unknown space method '{}', expected 'Normal' or 'Whitespace'", text));
+		}
+		else if (name == "SpaceDirection")
+		{
+			if (text == "None")
+				options.m_SpaceDirection = ESpaceDirection::None;
+			else if (text == "Left")
+				options.m_SpaceDirection = ESpaceDirection::Left;
+			else if (text == "Right")
+				options.m_SpaceDirection = ESpaceDirection::Right;
+			else if (text == "Both")
+				options.m_SpaceDirection = ESpaceDirection::Both;
+			else
+				addError(value, fmt::format("Unknown space direction '{}', expected 'None', 'Left', 'Right' or 'Both'", text));
+		}
+		else if (name == "Choice")
+		{
+			if (text == "Longest")
+				options.m_Choice = EChoice::Longest;
+			else if (text == "First")
+				options.m_Choice = EChoice::First;
+			else
+				addError(value, fmt::format("Unknown choice '{}', expected 'Longest' or 'First'", text));
+		}
+		else
+		{
+			addError(children[0], fmt::format("Unknown option '{}'", name));
+		}
+	}
+
+	void GrammarCompiler::compileRule(const Node& node, const Options& options, bool createNode)
+	{
+		auto& children = node.getChildren();
+		if (children.size() != 2)
+		{
+			addError(node, "Expected a rule name and matcher");
+			return;
+		}
+
+		std::string name = getText(children[0]);
+		if (m_Lexer->getRuleID(name) != InvalidRuleID)
+		{
+			addError(children[0], fmt::format("Rule '{}' is declared more than once", name));
+			return;
+		}
+
+		auto matcher = compileMatcher(children[1], options);
+		if (matcher)
+			m_Lexer->registerRule(std::make_unique<MatcherRule>(std::move(name), std::move(matcher), createNode));
+	}
+
+	void GrammarCompiler::compileCallbackRule(const Node& node)
+	{
+		auto& children = node.getChildren();
+		if (children.size() != 1)
+		{
+			addError(node, "Expected a rule name");
+			return;
+		}
+
+		std::string name = getText(children[0]);
+		if (m_Lexer->getRuleID(name) != InvalidRuleID)
+		{
+			addError(children[0], fmt::format("Rule '{}' is declared more than once", name));
+			return;
+		}
+
+		auto itr = m_Callbacks.find(name);
+		if (itr == m_Callbacks.end())
+		{
+			addError(children[0], fmt::format("Callback rule '{}' has no callback", name));
+			return;
+		}
+
+		auto callback = itr->second;
+		m_Lexer->registerRule(std::make_unique<CallbackRule>(std::move(name), std::move(callback)));
+	}
+
+	std::unique_ptr<IMatcher> GrammarCompiler::compileMatcher(const Node& node, const Options& options)
+	{
+		auto& children = node.getChildren();
+
+		auto compileChild = [&](std::size_t index) -> std::unique_ptr<IMatcher> {
+			if (index >= children.size())
+			{
+				addError(node, "Expected a matcher");
+				return nullptr;
+			}
+			return compileMatcher(children[index], options);
+		};
+
+		auto compileCount = [&](std::size_t index) -> std::size_t {
+			if (index >= children.size() || getKind(children[index]) != ENodeKind::Integer)
+			{
+				addError(node, "Expected an integer");
+				return 0;
+			}
+
+			std::string text  = getText(children[index]);
+			std::size_t value = 0;
+			auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+			if (error != std::errc {})
+				addError(children[index], fmt::format("Integer '{}' is out of range", text));
+			return value;
+		};
+
+		auto makeOr = [&](Matchers&& list) {
+			auto matcher = std::make_unique<OrMatcher>(std::move(list));
+			matcher->setChoice(options.m_Choice);
+			return matcher;
+		};
+
+		auto makeList = [](Matchers&& matchers, auto make) -> std::unique_ptr<IMatcher> {
+			for (auto& matcher : matchers)
+				if (!matcher)
+					return nullptr;
+			if (matchers.size() == 1)
+				return std::move(matchers[0]);
+			return make(std::move(matchers));
+		};
+
+		switch (getKind(node))
+		{
+		case ENodeKind::Group: return compileChild(0);
+		case ENodeKind::CombinationMatcher:
+		{
+			Matchers matchers;
+			if (hasBranches(node))
+			{
+				compileAlternatives(node, options, matchers);
+				return makeList(std::move(matchers), makeOr);
+			}
+			compileSequence(node, 0, children.size(), options, matchers);
+			return makeList(std::move(matchers), [](Matchers&& list) { return std::make_unique<CombinationMatcher>(std::move(list)); });
+		}
+		case ENodeKind::Branch: [[fallthrough]];
+		case ENodeKind::OrMatcher:
+		{
+			Matchers matchers;
+			compileAlternatives(node, options, matchers);
+			return makeList(std::move(matchers), makeOr);
+		}
+		case ENodeKind::ZeroOrMore:
+		{
+			auto child = compileChild(0);
+			return child ? std::make_unique<RangeMatcher>(std::move(child)) : nullptr;
+		}
+		case ENodeKind::OneOrMore:
+		{
+			auto child = compileChild(0);
+			return child ? std::make_unique<RangeMatcher>(std::move(child), 1) : nullptr;
+		}
+		case ENodeKind::ExactAmount:
+		{
+			auto        child = compileChild(0);
+			std::size_t count = compileCount(1);
+			if (!child)
+				return nullptr;
+			if (count == 1)
+				return child;
+			return std::make_unique<RangeMatcher>(std::move(child), count, count);
+		}
+		case ENodeKind::RangeMatcher:
+		{
+			auto        child       = compileChild(0);
+			std::size_t lowerBounds = compileCount(1);
+			std::size_t upperBounds = compileCount(2);
+			if (!child)
+				return nullptr;
+			if (lowerBounds > upperBounds)
+			{
+				addError(node, fmt::format("Range {{{}, {}}} can never match", lowerBounds, upperBounds));
+				return nullptr;
+			}
+			if (lowerBounds == 1 && upperBounds == 1)
+				return child;
+			return std::make_unique<RangeMatcher>(std::move(child), lowerBounds, upperBounds);
+		}
+		case ENodeKind::OptionalMatcher:
+		{
+			auto child = compileChild(0);
+			return child ? std::make_unique<OptionalMatcher>(std::move(child)) : nullptr;
+		}
+		case ENodeKind::NegativeMatcher:
+		{
+			auto child = compileChild(0);
+			return child ? std::make_unique<NegativeMatcher>(std::move(child)) : nullptr;
+		}
+		case ENodeKind::LenientSpaceMatcher: [[fallthrough]];
+		case ENodeKind::ForcedSpaceMatcher:
+		{
+			auto child = compileChild(0);
+			if (!child)
+				return nullptr;
+			bool forced = getKind(node) == ENodeKind::ForcedSpaceMatcher;
+			return std::make_unique<SpaceMatcher>(std::move(child), forced, options.m_SpaceDirection, options.m_SpaceMethod);
+		}
+		case ENodeKind::NamedGroupMatcher:
+		{
+			std::string name  = getIdentifier(node);
+			auto        child = compileChild(1);
+			return child ? std::make_unique<NamedGroupMatcher>(std::move(name), std::move(child)) : nullptr;
+		}
+		case ENodeKind::NamedGroupReferenceMatcher: return std::make_unique<NamedGroupReferenceMatcher>(getIdentifier(node));
+		case ENodeKind::ReferenceMatcher: return std::make_unique<ReferenceMatcher>(getIdentifier(node));
+		case ENodeKind::TextMatcher: return std::make_unique<TextMatcher>(Unescape(getText(node)));
+		case ENodeKind::RegexMatcher: return std::make_unique<RegexMatcher>(Unescape(getText(node)));
+		default:
+			addError(node, "Expected a matcher");
+			return nullptr;
+		}
+	}
+
+	void GrammarCompiler::compileSequence(const Node& node, std::size_t begin, std::size_t end, const Options& options, Matchers& matchers)
+	{
+		auto& children = node.getChildren();
+		for (std::size_t i = begin; i < end; ++i)
+		{
+			// Nested combinations are spliced into this one, unless they are really branches
+			auto& child = unwrapGroups(children[i]);
+			if (getKind(child) == ENodeKind::CombinationMatcher && !hasBranches(child))
+				compileSequence(child, 0, child.getChildren().size(), options, matchers);
+			else
+				matchers.push_back(compileMatcher(child, options));
+		}
+	}
+
+	void GrammarCompiler::compileAlternatives(const Node& node, const Options& options, Matchers& matchers)
+	{
+		auto& children = node.getChildren();
+		auto  addAlternative = [&](std::size_t begin, std::size_t end) {
+			if (end - begin > 1)
+			{
+				Matchers sequence;
+				compileSequence(node, begin, end, options, sequence);
+				for (auto& matcher : sequence)
+				{
+					if (!matcher)
+					{
+						matchers.push_back(nullptr);
+						return;
+					}
+				}
+				matchers.push_back(std::make_unique<CombinationMatcher>(std::move(sequence)));
+				return;
+			}
+
+			// Nested ors and branches are spliced into this one
+			auto& child = unwrapGroups(children[begin]);
+			auto  kind  = getKind(child);
+			if (kind == ENodeKind::OrMatcher || kind == ENodeKind::Branch || (kind == ENodeKind::CombinationMatcher && hasBranches(child)))
+				compileAlternatives(child, options, matchers);
+			else
+				matchers.push_back(compileMatcher(child, options));
+		};
+
+		if (getKind(node) != ENodeKind::CombinationMatcher)
+		{
+			for (std::size_t i = 0; i < children.size(); ++i)
+				addAlternative(i, i + 1);
+			return;
+		}
+
+		// Branches separated by ';' are lexed as a combination, the separators are only visible in the gaps between its children
+		std::size_t begin = 0;
+		for (std::size_t i = 1; i < children.size(); ++i)
+		{
+			if (isBranchSeparator(children[i - 1], children[i]))
+			{
+				addAlternative(begin, i);
+				begin = i;
+			}
+		}
+		addAlternative(begin, children.size());
+	}
+
+	void GrammarCompiler::addError(const Node& node, std::string_view error)
+	{
+		auto source = m_Grammar->getSource();
+		auto point  = node.getSpan().m_Start;
+		m_Errors.push_back(fmt::format("{}:{}: {}", point.getLine(source), point.getColumn(source), error));
+	}
+
+	GrammarCompiler::ENodeKind GrammarCompiler::getKind(const Node& node) const
+	{
+		return node.getRule() < m_Kinds.size() ? m_Kinds[node.getRule()] : ENodeKind::Unknown;
+	}
+
+	std::string GrammarCompiler::getText(const Node& node) const
+	{
+		return m_Grammar->getSource()->getSpan(node.getSpan());
+	}
+
+	std::string GrammarCompiler::getIdentifier(const Node& node) const
+	{
+		for (auto& child : node.getChildren())
+			if (getKind(child) == ENodeKind::Identifier)
+				return getText(child);
+		return {};
+	}
+
+	const Node& GrammarCompiler::unwrapGroups(const Node& node) const
+	{
+		const Node* current = &node;
+		while (getKind(*current) == ENodeKind::Group && current->getChildren().size() == 1)
+			current = &current->getChildren()[0];
+		return *current;
+	}
+
+	bool GrammarCompiler::hasBranches(const Node& node) const
+	{
+		auto& children = node.getChildren();
+		for (std::size_t i = 1; i < children.size(); ++i)
+			if (isBranchSeparator(children[i - 1], children[i]))
+				return true;
+		return false;
+	}
+
+	bool GrammarCompiler::isBranchSeparator(const Node& previous, const Node& next) const
+	{
+		SourceSpan gap { previous.getSpan().m_End, next.getSpan().m_Start };
+		if (gap.m_End <= gap.m_Start)
+			return false;
+		return m_Grammar->getSource()->getSpan(gap).find(';') != std::string::npos;
+	}
+} // namespace GrammarLexer
\ No newline at end of file
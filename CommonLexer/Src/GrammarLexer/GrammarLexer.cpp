@@ -9,15 +9,20 @@ namespace GrammarLexer
 		using namespace CommonLexer;
 
 		setMainRule("File");
+		setMemoization(true);
 
+		SplitOptions splitOptions;
+		splitOptions.m_ItemRule = "TopLevelDeclaration";
+		setSplitOptions(splitOptions);
+
+		registerRule(MatcherRule { "File", RangeMatcher(ReferenceMatcher("TopLevelDeclaration")), false });
 		registerRule(MatcherRule {
-		    "File",
-		    RangeMatcher(
-		        SpaceMatcher(
-		            ReferenceMatcher("Declaration"),
-		            false,
-		            ESpaceDirection::Both,
-		            ESpaceMethod::Whitespace)),
+		    "TopLevelDeclaration",
+		    SpaceMatcher(
+		        ReferenceMatcher("Declaration"),
+		        false,
+		        ESpaceDirection::Both,
+		        ESpaceMethod::Whitespace),
 		    false });
 		registerRule(MatcherRule {
 		    "Declaration",
@@ -457,5 +462,10 @@ namespace GrammarLexer
 		                    TextMatcher(":"))))) });
 		registerRule(MatcherRule { "TextMatcher", RegexMatcher("\"(?:[^\"\\\\\n]|\\.|\\\\.)*\"") });
 		registerRule(MatcherRule { "RegexMatcher", RegexMatcher("'(?:[^'\\\\\n]|\\.|\\\\.)*'") });
+
+		// Top level declarations are only ever matched once per position
+		setRuleMemoization("TopLevelDeclaration", false);
+
+		finalize();
 	}
 } // namespace GrammarLexer
\ No newline at end of file
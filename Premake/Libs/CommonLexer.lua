@@ -30,6 +30,9 @@ end
 
 function CommonLexer:setupDep()
 	links({ self.name })
+	filter("system:linux")
+		links({ "pthread" })
+	filter({})
 	sysincludedirs({ self.location .. "/Inc/" })
 	libs.fmt:setupDep()
 end
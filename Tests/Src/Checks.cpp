@@ -0,0 +1,811 @@
+#include "Checks.h"
+
+#include <CommonLexer/BatchLexer.h>
+#include <CommonLexer/GrammarFile.h>
+#include <CommonLexer/LexCache.h>
+#include <CommonLexer/LexEvents.h>
+#include <CommonLexer/LexFile.h>
+#include <CommonLexer/LexSession.h>
+#include <CommonLexer/Lexer.h>
+#include <CommonLexer/Matchers.h>
+#include <CommonLexer/Optimizer.h>
+#include <CommonLexer/Rules.h>
+#include <GrammarLexer/GrammarCompiler.h>
+#include <GrammarLexer/GrammarLexer.h>
+
+#include <fmt/format.h>
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+// Lexes are compared through a description with one line per node in preorder, indented by depth, followed by one line per message
+static void DescribeNode(std::string_view rule, CommonLexer::SourceSpan span, std::size_t depth, std::string& description)
+{
+	description += fmt::format("{}{} {}-{}\n", std::string(depth * 2, ' '), rule, span.m_Start.m_Index, span.m_End.m_Index);
+}
+
+static void DescribeNodes(const CommonLexer::Lexer& lexer, const CommonLexer::Node& node, std::size_t depth, std::string& description)
+{
+	for (auto& child : node.getChildren())
+	{
+		DescribeNode(lexer.getRule(child.getRule())->getName(), child.getSpan(), depth, description);
+		DescribeNodes(lexer, child, depth + 1, description);
+	}
+}
+
+static void DescribeNodes(const CommonLexer::LexView& view, CommonLexer::FlatNode node, std::size_t depth, std::string& description)
+{
+	for (auto child : node.getChildren())
+	{
+		DescribeNode(view.getRuleName(child.getRule()), child.getSpan(), depth, description);
+		DescribeNodes(view, child, depth + 1, description);
+	}
+}
+
+static void DescribeMessage(const CommonLexer::Message& message, std::string& description)
+{
+	auto span = message.getSpan();
+	description += fmt::format("{} {}-{}: {}\n", message.getPoint().m_Index, span.m_Start.m_Index, span.m_End.m_Index, message.getMessage());
+}
+
+static void DescribeMessages(const std::vector<CommonLexer::Message>& messages, std::string& description)
+{
+	for (auto& message : messages)
+		DescribeMessage(message, description);
+}
+
+static std::string DescribeLex(const CommonLexer::Lex& lex)
+{
+	std::string description;
+	DescribeNodes(*lex.getLexer(), lex.getRoot(), 0, description);
+	DescribeMessages(lex.getMessages(), description);
+	return description;
+}
+
+static std::string DescribeView(const CommonLexer::LexView& view)
+{
+	std::string description;
+	auto&       tree = view.getTree();
+	if (!tree.empty())
+		DescribeNodes(view, tree.getRoot(), 0, description);
+	for (std::size_t i = 0; i < view.getMessageCount(); ++i)
+		DescribeMessage(*view.getMessage(i), description);
+	return description;
+}
+
+static void DescribeLeaves(const CommonLexer::Lexer& lexer, const CommonLexer::Node& node, std::size_t depth, std::string& description)
+{
+	for (auto& child : node.getChildren())
+	{
+		if (child.getChildren().empty())
+			DescribeNode(lexer.getRule(child.getRule())->getName(), child.getSpan(), depth, description);
+		DescribeLeaves(lexer, child, depth + 1, description);
+	}
+}
+
+static std::string DescribeTokens(const CommonLexer::Lexer& lexer, const CommonLexer::TokenStream& tokens)
+{
+	std::string description;
+	for (auto& token : tokens.m_Tokens)
+		DescribeNode(lexer.getRule(token.m_Rule)->getName(), token.m_Span, token.m_Depth, description);
+	DescribeMessages(tokens.m_Messages, description);
+	return description;
+}
+
+// Rules only know their span once they exit, so their line is filled in then
+class DescribingSink : public CommonLexer::ILexEventSink
+{
+public:
+	explicit DescribingSink(const CommonLexer::Lexer& lexer) : m_Lexer(&lexer) {}
+
+	virtual void enterRule([[maybe_unused]] std::uint32_t rule, [[maybe_unused]] CommonLexer::SourcePoint start) override
+	{
+		m_OpenRules.push_back(m_Lines.size());
+		m_Lines.emplace_back();
+	}
+
+	virtual void exitRule(std::uint32_t rule, CommonLexer::SourceSpan span) override
+	{
+		std::size_t line = m_OpenRules.back();
+		m_OpenRules.pop_back();
+		DescribeNode(m_Lexer->getRule(rule)->getName(), span, m_OpenRules.size(), m_Lines[line]);
+	}
+
+	virtual void token(std::uint32_t rule, CommonLexer::SourceSpan span) override
+	{
+		m_Lines.emplace_back();
+		DescribeNode(m_Lexer->getRule(rule)->getName(), span, m_OpenRules.size(), m_Lines.back());
+	}
+
+	[[nodiscard]] std::string getDescription() const
+	{
+		std::string description;
+		for (auto& line : m_Lines)
+			description += line;
+		return description;
+	}
+
+private:
+	const CommonLexer::Lexer* m_Lexer;
+
+	std::vector<std::string> m_Lines;
+	std::vector<std::size_t> m_OpenRules;
+};
+
+static CheckResult Compare(std::string name, const std::string& expected, const std::string& got)
+{
+	CheckResult result { std::move(name), {} };
+	if (expected == got)
+		return result;
+
+	std::size_t line      = 0;
+	std::size_t lineStart = 0;
+	for (std::size_t i = 0; i < expected.size() && i < got.size() && expected[i] == got[i]; ++i)
+	{
+		if (expected[i] == '\n')
+		{
+			++line;
+			lineStart = i + 1;
+		}
+	}
+	auto getLine = [lineStart](const std::string& description) {
+		auto end = description.find('\n', lineStart);
+		return description.substr(lineStart, end != std::string::npos ? end - lineStart : std::string::npos);
+	};
+	result.m_Failure = fmt::format("Line {} differs, expected '{}' but got '{}'", line + 1, getLine(expected), getLine(got));
+	return result;
+}
+
+static CheckResult Fail(std::string name, std::string failure)
+{
+	return { std::move(name), std::move(failure) };
+}
+
+static void CheckMemoization(CommonLexer::ISource* source, const std::string& plain, std::vector<CheckResult>& results)
+{
+	{
+		GrammarLexer::GrammarLexer lexer;
+		lexer.setMemoization(true);
+		results.push_back(Compare("Memoization", plain, DescribeLex(lexer.lexSource(source))));
+	}
+	{
+		// Small enough that most entries are rejected
+		GrammarLexer::GrammarLexer lexer;
+		lexer.setMemoization(true, 4096);
+		results.push_back(Compare("Memoization with a memory limit", plain, DescribeLex(lexer.lexSource(source))));
+	}
+}
+
+static std::string DescribeLines(CommonLexer::ISource* source)
+{
+	std::string description = fmt::format("{} bytes, {} lines\n", source->getSize(), source->getNumLines());
+	for (std::size_t i = 0; i < source->getNumLines(); ++i)
+		description += fmt::format("{}: {}\n", source->getIndexFromLine(i), source->getLine(i));
+	return description;
+}
+
+static std::filesystem::path WriteTempFile(std::string_view filename, const std::string& content)
+{
+	std::error_code error;
+	auto            filepath = std::filesystem::temp_directory_path(error) / filename;
+	std::ofstream   file { filepath, std::ios::binary | std::ios::trunc };
+	file.write(content.data(), static_cast<std::streamsize>(content.size()));
+	return filepath;
+}
+
+// The text is written to a file of its own, so the mapped source is checked whatever kind of source the checks were given
+static void CheckMappedFileSource(CommonLexer::ISource* source, const CommonLexer::Lexer& plainLexer, std::vector<CheckResult>& results)
+{
+	std::string content  = source->getCompleteSpan().getSpan(source);
+	auto        filepath = WriteTempFile("CommonLexerTests.grammar", content);
+
+	CommonLexer::StringSource     text { content };
+	CommonLexer::MappedFileSource mapped { filepath };
+	if (!mapped.isOpen())
+	{
+		results.push_back(Fail("Mapped file source", "Mapping the file failed"));
+	}
+	else
+	{
+		results.push_back(Compare("Mapped file source lines", DescribeLines(&text), DescribeLines(&mapped)));
+		results.push_back(Compare("Mapped file source", DescribeLex(plainLexer.lexSource(&text)), DescribeLex(plainLexer.lexSource(&mapped))));
+	}
+	mapped.close();
+	std::error_code error;
+	std::filesystem::remove(filepath, error);
+}
+
+static std::string DescribeLocation(const CommonLexer::SourceLocation& location)
+{
+	return fmt::format("{}:{}\n", location.m_Line, location.m_Column);
+}
+
+static void DescribeNodeLocations(CommonLexer::ISource* source, const CommonLexer::Node& node, std::string& description)
+{
+	auto span = node.getSpan();
+	description += DescribeLocation({ source->getLineFromIndex(span.m_Start), source->getColumnFromIndex(span.m_Start) });
+	description += DescribeLocation({ source->getLineFromIndex(span.m_End), source->getColumnFromIndex(span.m_End) });
+	for (auto& child : node.getChildren())
+		DescribeNodeLocations(source, child, description);
+}
+
+// Resolving all points at once has to agree with looking up each point on its own, in ascending order and in reverse
+static void CheckLocations(CommonLexer::ISource* source, const CommonLexer::Lexer& plainLexer, std::vector<CheckResult>& results)
+{
+	std::vector<CommonLexer::SourcePoint> points;
+	std::string                           expected;
+	for (std::size_t i = 0; i <= source->getSize(); ++i)
+	{
+		points.emplace_back(i);
+		expected += DescribeLocation({ source->getLineFromIndex(i), source->getColumnFromIndex(i) });
+	}
+
+	std::string ascending;
+	for (auto& location : source->resolveLocations(points))
+		ascending += DescribeLocation(location);
+	results.push_back(Compare("Resolved locations", expected, ascending));
+
+	std::vector<CommonLexer::SourcePoint> reversed { points.rbegin(), points.rend() };
+	std::string                           descending;
+	auto                                  locations = source->resolveLocations(reversed);
+	for (auto itr = locations.rbegin(); itr != locations.rend(); ++itr)
+		descending += DescribeLocation(*itr);
+	results.push_back(Compare("Resolved locations in reverse", expected, descending));
+
+	auto        lex = plainLexer.lexSource(source);
+	std::string nodes;
+	DescribeNodeLocations(source, lex.getRoot(), nodes);
+	std::string nodeLocations;
+	for (auto& location : lex.resolveNodeLocations())
+	{
+		nodeLocations += DescribeLocation(location.m_Start);
+		nodeLocations += DescribeLocation(location.m_End);
+	}
+	results.push_back(Compare("Resolved node locations", nodes, nodeLocations));
+}
+
+// A copy of the source with a character inserted at the start of a line in the middle that no declaration can start with
+static std::string BreakSource(CommonLexer::ISource* source)
+{
+	std::string text   = source->getCompleteSpan().getSpan(source);
+	std::size_t middle = text.find('\n', text.size() / 2);
+	text.insert(middle != std::string::npos ? middle + 1 : text.size(), "@");
+	return text;
+}
+
+static void CheckFarthestFailure(CommonLexer::ISource* source, std::vector<CheckResult>& results)
+{
+	CommonLexer::StringSource broken { BreakSource(source) };
+
+	GrammarLexer::GrammarLexer accumulateLexer;
+	accumulateLexer.setMemoization(false);
+	GrammarLexer::GrammarLexer farthestLexer;
+	farthestLexer.setMemoization(false);
+	farthestLexer.setErrorReporting(CommonLexer::EErrorReporting::FarthestFailure);
+	GrammarLexer::GrammarLexer memoLexer;
+	memoLexer.setMemoization(true);
+	memoLexer.setErrorReporting(CommonLexer::EErrorReporting::FarthestFailure);
+
+	// The reporting mode only changes the messages
+	for (auto checked : { source, static_cast<CommonLexer::ISource*>(&broken) })
+	{
+		auto        name       = checked == source ? std::string { "" } : std::string { " of a broken source" };
+		auto        accumulate = accumulateLexer.lexSource(checked);
+		auto        farthest   = farthestLexer.lexSource(checked);
+		std::string expected;
+		std::string got;
+		DescribeNodes(accumulateLexer, accumulate.getRoot(), 0, expected);
+		DescribeNodes(farthestLexer, farthest.getRoot(), 0, got);
+		results.push_back(Compare("Farthest failure tree" + name, expected, got));
+	}
+
+	auto  accumulate = accumulateLexer.lexSource(&broken);
+	auto  farthest   = farthestLexer.lexSource(&broken);
+	auto& messages   = farthest.getMessages();
+	if (messages.empty())
+	{
+		results.push_back(Fail("Farthest failure", "The broken source lexed without messages"));
+		return;
+	}
+
+	auto point = messages.front().getPoint();
+	for (auto& message : messages)
+	{
+		if (message.getPoint() != point)
+		{
+			results.push_back(Fail("Farthest failure", fmt::format("Messages at {} and {}, all of them have to be at the farthest point", point.m_Index, message.getPoint().m_Index)));
+			return;
+		}
+	}
+	for (auto& message : accumulate.getMessages())
+	{
+		if (message.getPoint() > point)
+		{
+			results.push_back(Fail("Farthest failure", fmt::format("Accumulated a message at {}, past the farthest failure at {}", message.getPoint().m_Index, point.m_Index)));
+			return;
+		}
+	}
+	results.push_back({ "Farthest failure", {} });
+
+	// Replayed memo entries have to record their failures again
+	results.push_back(Compare("Farthest failure with memoization", DescribeLex(farthest), DescribeLex(memoLexer.lexSource(&broken))));
+}
+
+// Registering a rule again replaces it in place, so references to it match the latest rule and the rule count stays the same
+static void CheckDuplicateRules(std::vector<CheckResult>& results)
+{
+	using namespace CommonLexer;
+	StringSource source { "ab" };
+
+	Lexer expectedLexer;
+	expectedLexer.setMainRule("Main");
+	expectedLexer.registerRule(MatcherRule { "Main", CombinationMatcher(ReferenceMatcher("A"), TextMatcher("b")) });
+	expectedLexer.registerRule(MatcherRule { "A", TextMatcher("a") });
+
+	Lexer lexer;
+	lexer.setMainRule("Main");
+	lexer.registerRule(MatcherRule { "Main", CombinationMatcher(ReferenceMatcher("A"), TextMatcher("b")) });
+	lexer.registerRule(MatcherRule { "A", TextMatcher("b") });
+	lexer.registerRule(MatcherRule { "A", TextMatcher("a") });
+	if (lexer.getRuleCount() != expectedLexer.getRuleCount())
+	{
+		results.push_back(Fail("Duplicate rules", fmt::format("Registered {} rules instead of {}", lexer.getRuleCount(), expectedLexer.getRuleCount())));
+		return;
+	}
+	results.push_back(Compare("Duplicate rules", DescribeLex(expectedLexer.lexSource(&source)), DescribeLex(lexer.lexSource(&source))));
+}
+
+// Every source of a batch has to lex like it does on its own, files that can't be opened get a message instead of a lex
+static void CheckBatch(CommonLexer::ISource* source, const CommonLexer::Lexer& plainLexer, std::vector<CheckResult>& results)
+{
+	std::string               content = source->getCompleteSpan().getSpan(source);
+	CommonLexer::StringSource broken { BreakSource(source) };
+	CommonLexer::StringSource empty { "" };
+	CommonLexer::ISource*     sources[] { source, &broken, &empty, source };
+
+	std::string expected;
+	for (auto batchSource : sources)
+		expected += DescribeLex(plainLexer.lexSource(batchSource));
+
+	CommonLexer::BatchLexer batch { plainLexer, 4 };
+	std::string             got;
+	for (auto& lex : batch.lexSources(sources).m_Lexes)
+		got += DescribeLex(lex);
+	results.push_back(Compare("Batch sources", expected, got));
+
+	std::filesystem::path filepaths[] { WriteTempFile("CommonLexerTests.grammar", content), WriteTempFile("CommonLexerTests.broken.grammar", broken.getCompleteSpan().getSpan(&broken)), {} };
+	filepaths[2] = filepaths[0].parent_path() / "CommonLexerTests.missing.grammar";
+
+	auto result = batch.lexFiles(filepaths);
+	if (result.m_Lexes.size() != 3 || result.m_Lexes[2].getMessages().empty())
+	{
+		results.push_back(Fail("Batch files", "The missing file did not get a message"));
+	}
+	else
+	{
+		std::string expectedFiles = DescribeLex(plainLexer.lexSource(source)) + DescribeLex(plainLexer.lexSource(&broken));
+		results.push_back(Compare("Batch files", expectedFiles, DescribeLex(result.m_Lexes[0]) + DescribeLex(result.m_Lexes[1])));
+	}
+	// Unmaps the files before they are removed
+	result = {};
+
+	std::error_code error;
+	for (auto& filepath : filepaths)
+		std::filesystem::remove(filepath, error);
+}
+
+// Small chunks so even short sources are split, a broken source has to fall back to a serial lex
+static void CheckSplit(CommonLexer::ISource* source, const CommonLexer::Lexer& plainLexer, const std::string& plain, std::vector<CheckResult>& results)
+{
+	GrammarLexer::GrammarLexer lexer;
+	lexer.setMemoization(false);
+	auto splitOptions           = lexer.getSplitOptions();
+	splitOptions.m_MinChunkSize = 64;
+	lexer.setSplitOptions(splitOptions);
+	CommonLexer::BatchLexer batch { lexer, 4 };
+	results.push_back(Compare("Split lexing", plain, DescribeLex(batch.lexSplit(source))));
+
+	CommonLexer::StringSource broken { BreakSource(source) };
+	results.push_back(Compare("Split lexing of a broken source", DescribeLex(plainLexer.lexSource(&broken)), DescribeLex(batch.lexSplit(&broken))));
+}
+
+static void CheckRelex(CommonLexer::ISource* source, const CommonLexer::Lexer& plainLexer, std::vector<CheckResult>& results)
+{
+	GrammarLexer::GrammarLexer lexer;
+	CommonLexer::LexSession    session { lexer };
+
+	std::string text = source->getCompleteSpan().getSpan(source);
+	auto        lex  = session.lexIncremental(source);
+	results.push_back(Compare("Incremental lexing", DescribeLex(plainLexer.lexSource(source)), DescribeLex(lex)));
+
+	// Each version is destroyed once the next one is relexed, the lex must not refer to it anymore
+	std::unique_ptr<CommonLexer::StringSource> version;
+
+	auto applyEdit = [&](std::string name, CommonLexer::TextEdit edit, std::string_view insertion) {
+		text.replace(edit.m_Start, edit.m_OldLength, insertion);
+		auto edited = std::make_unique<CommonLexer::StringSource>(text);
+		lex         = session.relex(std::move(lex), edited.get(), { &edit, 1 });
+		version     = std::move(edited);
+		results.push_back(Compare(std::move(name), DescribeLex(plainLexer.lexSource(version.get())), DescribeLex(lex)));
+	};
+
+	constexpr std::string_view Insertion = "Inserted: \"a\", Identifier;\n";
+
+	std::size_t middle = text.find('\n', text.size() / 2);
+	middle             = middle != std::string::npos ? middle + 1 : text.size();
+	applyEdit("Relex after an insertion", { middle, 0, Insertion.size() }, Insertion);
+
+	std::size_t firstLine = text.find('\n');
+	firstLine             = firstLine != std::string::npos ? firstLine + 1 : text.size();
+	applyEdit("Relex after removing the first line", { 0, firstLine, 0 }, {});
+
+	// Breaks the inserted rule, so the relex has to report the same messages as a plain lex
+	std::size_t inserted = text.find(Insertion);
+	if (inserted != std::string::npos)
+		applyEdit("Relex after an error", { inserted + Insertion.size() - 2, 1, 0 }, {});
+}
+
+// All tokens are the nodes in preorder, the leaves only the nodes without children, each at the depth of its node
+static void CheckTokens(CommonLexer::ISource* source, const CommonLexer::Lexer& plainLexer, const std::string& plain, std::vector<CheckResult>& results)
+{
+	CommonLexer::LexSession  session { plainLexer };
+	CommonLexer::TokenStream tokens;
+	session.lexTokens(source, tokens, CommonLexer::ETokenFilter::All);
+	results.push_back(Compare("Tokens", plain, DescribeTokens(plainLexer, tokens)));
+
+	auto        lex = plainLexer.lexSource(source);
+	std::string leaves;
+	DescribeLeaves(plainLexer, lex.getRoot(), 0, leaves);
+	DescribeMessages(lex.getMessages(), leaves);
+	session.lexTokens(source, tokens, CommonLexer::ETokenFilter::Leaves);
+	results.push_back(Compare("Leaf tokens", leaves, DescribeTokens(plainLexer, tokens)));
+}
+
+// The events of a lex describe the same nodes as the tree, since the sink fills in the line of each rule when it exits
+static void CheckEvents(CommonLexer::ISource* source, const CommonLexer::Lexer& plainLexer, const std::string& plain, std::vector<CheckResult>& results)
+{
+	CommonLexer::LexSession session { plainLexer };
+	DescribingSink          sink { plainLexer };
+	auto                    messages    = session.lexEvents(source, sink);
+	auto                    description = sink.getDescription();
+	DescribeMessages(messages, description);
+	results.push_back(Compare("Events", plain, description));
+}
+
+// Messages read with the lexer borrow their text from it, so they have to stay valid after the view is closed
+static void CheckLexFile(CommonLexer::ISource* source, const CommonLexer::Lexer& plainLexer, std::vector<CheckResult>& results)
+{
+	std::error_code error;
+	auto            filepath = std::filesystem::temp_directory_path(error) / "CommonLexerTests.clex";
+
+	CommonLexer::StringSource broken { BreakSource(source) };
+	for (auto checked : { source, static_cast<CommonLexer::ISource*>(&broken) })
+	{
+		auto name     = checked == source ? std::string { "Lex file" } : std::string { "Lex file of a broken source" };
+		auto lex      = plainLexer.lexSource(checked);
+		auto expected = DescribeLex(lex);
+
+		CommonLexer::LexView view;
+		if (!CommonLexer::WriteLexFile(lex, filepath))
+		{
+			results.push_back(Fail(name, "Writing the lex file failed"));
+			continue;
+		}
+		if (!view.open(filepath))
+		{
+			results.push_back(Fail(name, "Opening the lex file failed"));
+			continue;
+		}
+		results.push_back(Compare(name, expected, DescribeView(view)));
+
+		std::vector<CommonLexer::Message> messages;
+		for (std::size_t i = 0; i < view.getMessageCount(); ++i)
+		{
+			if (auto message = view.getMessage(i, &plainLexer))
+				messages.push_back(std::move(*message));
+		}
+		view.close();
+
+		std::string expectedMessages;
+		std::string gotMessages;
+		DescribeMessages(lex.getMessages(), expectedMessages);
+		DescribeMessages(messages, gotMessages);
+		results.push_back(Compare(name + " messages", expectedMessages, gotMessages));
+
+		bool closedIsEmpty = view.getSourceSize() == 0 && view.getRuleCount() == 0 && view.getMessageCount() == 0 && view.getRuleName(0).empty() && !view.getMessage(0);
+		results.push_back(closedIsEmpty ? CheckResult { name + " closed", {} } : Fail(name + " closed", "A closed view still has content"));
+	}
+	std::filesystem::remove(filepath, error);
+}
+
+static void CheckCache(CommonLexer::ISource* source, const CommonLexer::Lexer& plainLexer, const std::string& plain, std::vector<CheckResult>& results)
+{
+	std::error_code              error;
+	CommonLexer::LexCacheOptions options;
+	options.m_Directory = std::filesystem::temp_directory_path(error) / "CommonLexerTests";
+	std::filesystem::remove_all(options.m_Directory, error);
+
+	{
+		CommonLexer::LexCache cache { plainLexer, options };
+		if (!cache.isEnabled())
+		{
+			results.push_back(Fail("Lex cache", "The cache is disabled for the grammar lexer"));
+			return;
+		}
+
+		results.push_back(Compare("Lex cache miss", plain, DescribeLex(cache.lexSource(source))));
+		auto hit = cache.lexSource(source);
+		if (cache.getStats().m_MemoryHits != 1)
+			results.push_back(Fail("Lex cache memory hit", "The second lex was not a memory hit"));
+		else
+			results.push_back(Compare("Lex cache memory hit", plain, DescribeLex(hit)));
+	}
+
+	{
+		CommonLexer::LexCache cache { plainLexer, options };
+		auto                  hit = cache.lexSource(source);
+		if (cache.getStats().m_DiskHits != 1)
+			results.push_back(Fail("Lex cache disk hit", "A new cache did not load the lex from disk"));
+		else
+			results.push_back(Compare("Lex cache disk hit", plain, DescribeLex(hit)));
+	}
+
+	// A corrupted file is a miss and is overwritten with the lex
+	for (auto& entry : std::filesystem::directory_iterator { options.m_Directory, error })
+	{
+		std::fstream file { entry.path(), std::ios::binary | std::ios::in | std::ios::out };
+		file.seekg(-1, std::ios::end);
+		char last = static_cast<char>(file.get());
+		file.seekp(-1, std::ios::end);
+		file.put(static_cast<char>(~last));
+	}
+
+	{
+		CommonLexer::LexCache cache { plainLexer, options };
+		auto                  miss  = cache.lexSource(source);
+		auto                  stats = cache.getStats();
+		if (stats.m_DiskHits != 0 || stats.m_Misses != 1)
+			results.push_back(Fail("Lex cache corrupted file", "A corrupted file was not a miss"));
+		else
+			results.push_back(Compare("Lex cache corrupted file", plain, DescribeLex(miss)));
+	}
+
+	{
+		CommonLexer::LexCache cache { plainLexer, options };
+		auto                  hit = cache.lexSource(source);
+		if (cache.getStats().m_DiskHits != 1)
+			results.push_back(Fail("Lex cache overwritten file", "The corrupted file was not overwritten"));
+		else
+			results.push_back(Compare("Lex cache overwritten file", plain, DescribeLex(hit)));
+	}
+
+	std::filesystem::remove_all(options.m_Directory, error);
+}
+
+// Reading a written grammar has to give a lexer that lexes the same and writes the same canonical form
+static void CheckGrammarFile(CommonLexer::ISource* source, const CommonLexer::Lexer& plainLexer, const std::string& plain, std::vector<CheckResult>& results)
+{
+	std::vector<char> data;
+	if (!CommonLexer::WriteGrammar(plainLexer, data))
+	{
+		results.push_back(Fail("Grammar file", "Writing the grammar failed"));
+		return;
+	}
+
+	CommonLexer::Lexer lexer;
+	if (!CommonLexer::ReadGrammar(lexer, data))
+	{
+		results.push_back(Fail("Grammar file", "Reading the grammar failed"));
+		return;
+	}
+	results.push_back(Compare("Grammar file", plain, DescribeLex(lexer.lexSource(source))));
+
+	std::vector<char> rewritten;
+	if (!CommonLexer::WriteGrammar(lexer, rewritten) || rewritten != data)
+		results.push_back(Fail("Grammar file rewrite", "Writing the read grammar gave another canonical form"));
+	else
+		results.push_back({ "Grammar file rewrite", {} });
+}
+
+// Patterns std::regex rejects have to fail finalize and reading instead of aborting when they are compiled
+static void CheckInvalidRegexes(std::vector<CheckResult>& results)
+{
+	using namespace CommonLexer;
+	for (std::string pattern : { "[z-a]", "(a", "a)", "a{2,1}", "*a", "[a", "\\" })
+	{
+		auto name = fmt::format("Invalid regex '{}'", pattern);
+
+		Lexer lexer;
+		lexer.setMainRule("Main");
+		lexer.registerRule(MatcherRule { "Main", RegexMatcher(pattern) });
+		if (lexer.finalize())
+		{
+			results.push_back(Fail(name, "Finalizing did not fail"));
+			continue;
+		}
+
+		std::vector<char> data;
+		Lexer             readLexer;
+		if (!WriteGrammar(lexer, data))
+			results.push_back(Fail(name, "Writing the grammar failed"));
+		else if (ReadGrammar(readLexer, data))
+			results.push_back(Fail(name, "Reading the grammar did not fail"));
+		else
+			results.push_back({ name, {} });
+	}
+}
+
+// Lenient spaces at the end of a rule add the whitespace after it to the node, the grammar file has them after the identifier of
+// ReferenceMatcher where GrammarLexer has none, so nodes are compared without their trailing whitespace
+static void DescribeTrimmedNodes(const CommonLexer::Lexer& lexer, CommonLexer::ISource* source, const CommonLexer::Node& node, std::size_t depth, std::string& description)
+{
+	for (auto& child : node.getChildren())
+	{
+		auto span = child.getSpan();
+		auto text = source->getSpan(span);
+		auto end  = text.find_last_not_of(" \t\n\v\f\r");
+
+		span.m_End = span.m_Start.m_Index + (end != std::string::npos ? end + 1 : 0);
+		DescribeNode(lexer.getRule(child.getRule())->getName(), span, depth, description);
+		DescribeTrimmedNodes(lexer, source, child, depth + 1, description);
+	}
+}
+
+static std::string DescribeTrimmedLex(const CommonLexer::Lex& lex)
+{
+	std::string description;
+	DescribeTrimmedNodes(*lex.getLexer(), lex.getSource(), lex.getRoot(), 0, description);
+	DescribeMessages(lex.getMessages(), description);
+	return description;
+}
+
+// CommonLexer.grammar describes GrammarLexer, so the lexer compiled from it has to lex like the hand written one
+static void CheckGrammarCompiler(CommonLexer::ISource* source, const CommonLexer::Lexer& plainLexer, std::vector<CheckResult>& results)
+{
+	CommonLexer::MappedFileSource grammar { "CommonLexer.grammar" };
+	if (!grammar.isOpen())
+	{
+		results.push_back(Fail("Grammar compiler", "Failed to open 'CommonLexer.grammar'"));
+		return;
+	}
+
+	CommonLexer::Lexer            lexer;
+	GrammarLexer::GrammarCompiler compiler;
+	lexer.setMemoization(false);
+	if (!compiler.compile(&grammar, lexer))
+	{
+		auto& errors = compiler.getErrors();
+		results.push_back(Fail("Grammar compiler", errors.empty() ? std::string { "Compiling failed" } : errors.front()));
+		return;
+	}
+
+	CommonLexer::StringSource broken { BreakSource(source) };
+	results.push_back(Compare("Grammar compiler", DescribeTrimmedLex(plainLexer.lexSource(source)), DescribeTrimmedLex(lexer.lexSource(source))));
+	results.push_back(Compare("Grammar compiler on a broken source", DescribeTrimmedLex(plainLexer.lexSource(&broken)), DescribeTrimmedLex(lexer.lexSource(&broken))));
+}
+
+static std::string LexOptimized(CommonLexer::ISource* source, const CommonLexer::OptimizeOptions& options, bool memoize)
+{
+	GrammarLexer::GrammarLexer lexer;
+	lexer.setMemoization(memoize);
+	lexer.optimize(options);
+	return DescribeLex(lexer.lexSource(source));
+}
+
+// Options with every pass but one turned off
+static CommonLexer::OptimizeOptions OnlyPass(bool CommonLexer::OptimizeOptions::*pass)
+{
+	CommonLexer::OptimizeOptions options;
+	options.m_Flatten            = false;
+	options.m_InlineRules        = false;
+	options.m_FuseTexts          = false;
+	options.m_ShareRegexes       = false;
+	options.m_SharePrefixes      = false;
+	options.m_DispatchFirstBytes = false;
+	options.*pass                = true;
+	return options;
+}
+
+static void CheckOptimizer(CommonLexer::ISource* source, const CommonLexer::Lexer& plainLexer, const std::string& plain, std::vector<CheckResult>& results)
+{
+	results.push_back(Compare("Optimizer", plain, LexOptimized(source, {}, false)));
+	results.push_back(Compare("Optimizer with memoization", plain, LexOptimized(source, {}, true)));
+	results.push_back(Compare("Flattening", plain, LexOptimized(source, OnlyPass(&CommonLexer::OptimizeOptions::m_Flatten), false)));
+	results.push_back(Compare("Inlining", plain, LexOptimized(source, OnlyPass(&CommonLexer::OptimizeOptions::m_InlineRules), false)));
+	results.push_back(Compare("Text fusion", plain, LexOptimized(source, OnlyPass(&CommonLexer::OptimizeOptions::m_FuseTexts), false)));
+	results.push_back(Compare("Shared regexes", plain, LexOptimized(source, OnlyPass(&CommonLexer::OptimizeOptions::m_ShareRegexes), false)));
+	results.push_back(Compare("Shared prefixes", plain, LexOptimized(source, OnlyPass(&CommonLexer::OptimizeOptions::m_SharePrefixes), false)));
+	results.push_back(Compare("Shared prefixes with memoization", plain, LexOptimized(source, OnlyPass(&CommonLexer::OptimizeOptions::m_SharePrefixes), true)));
+	results.push_back(Compare("First byte dispatch", plain, LexOptimized(source, OnlyPass(&CommonLexer::OptimizeOptions::m_DispatchFirstBytes), false)));
+	results.push_back(Compare("First byte dispatch with memoization", plain, LexOptimized(source, OnlyPass(&CommonLexer::OptimizeOptions::m_DispatchFirstBytes), true)));
+
+	CommonLexer::StringSource broken { BreakSource(source) };
+	results.push_back(Compare("Optimizer on a broken source", DescribeLex(plainLexer.lexSource(&broken)), LexOptimized(&broken, {}, false)));
+}
+
+// EChoice::First only has to lex the same when no or prefers a shorter alternative
+static void CheckFirstChoice(CommonLexer::ISource* source, const CommonLexer::Lexer& plainLexer, const std::string& plain, std::vector<CheckResult>& results)
+{
+	CommonLexer::LexSession session { plainLexer };
+	auto                    divergences = session.findChoiceDivergences(source);
+
+	GrammarLexer::GrammarLexer lexer;
+	lexer.setMemoization(false);
+	lexer.setChoice(CommonLexer::EChoice::First);
+	auto first = DescribeLex(lexer.lexSource(source));
+	if (divergences.empty())
+		results.push_back(Compare("First choice", plain, first));
+	else if (first == plain)
+		results.push_back(Fail("First choice", fmt::format("{} ors prefer a shorter alternative first, but the lex did not change", divergences.size())));
+	else
+		results.push_back({ "First choice", {} });
+}
+
+// A memo replay of A has to set the named group g again, otherwise the reference in the second alternative sees the group D set
+static void RegisterNamedGroupRules(CommonLexer::Lexer& lexer)
+{
+	using namespace CommonLexer;
+	lexer.setMainRule("Main");
+	lexer.registerRule(MatcherRule { "Main", OrMatcher(CombinationMatcher(ReferenceMatcher("A"), TextMatcher("-"), ReferenceMatcher("D"), TextMatcher("#")), CombinationMatcher(ReferenceMatcher("A"), TextMatcher("-"), NamedGroupReferenceMatcher("g"))) });
+	lexer.registerRule(MatcherRule { "A", NamedGroupMatcher("g", RegexMatcher("[a-z]+")) });
+	lexer.registerRule(MatcherRule { "D", NamedGroupMatcher("g", RegexMatcher("[a-z]")) });
+}
+
+static void CheckNamedGroups(std::vector<CheckResult>& results)
+{
+	CommonLexer::StringSource source { "ab-ab" };
+
+	CommonLexer::Lexer plainLexer;
+	RegisterNamedGroupRules(plainLexer);
+	auto plainLex = plainLexer.lexSource(&source);
+	auto plain    = DescribeLex(plainLex);
+	if (plainLex.getRoot().getChildren().empty() || plainLex.getRoot().getChildren()[0].getSpan().m_End != source.getSize())
+	{
+		results.push_back(Fail("Named groups", "The named group reference did not match the whole source"));
+		return;
+	}
+
+	CommonLexer::Lexer memoLexer;
+	RegisterNamedGroupRules(memoLexer);
+	memoLexer.setMemoization(true);
+	results.push_back(Compare("Named groups with memoization", plain, DescribeLex(memoLexer.lexSource(&source))));
+
+	CommonLexer::Lexer optimizedLexer;
+	RegisterNamedGroupRules(optimizedLexer);
+	optimizedLexer.setMemoization(true);
+	optimizedLexer.optimize();
+	results.push_back(Compare("Named groups with memoization and optimizer", plain, DescribeLex(optimizedLexer.lexSource(&source))));
+}
+
+std::vector<CheckResult> RunChecks(CommonLexer::ISource* source)
+{
+	std::vector<CheckResult> results;
+
+	GrammarLexer::GrammarLexer plainLexer;
+	plainLexer.setMemoization(false);
+	auto plain = DescribeLex(plainLexer.lexSource(source));
+
+	CheckMemoization(source, plain, results);
+	CheckMappedFileSource(source, plainLexer, results);
+	CheckLocations(source, plainLexer, results);
+	CheckFarthestFailure(source, results);
+	CheckDuplicateRules(results);
+	CheckBatch(source, plainLexer, results);
+	CheckSplit(source, plainLexer, plain, results);
+	CheckRelex(source, plainLexer, results);
+	CheckTokens(source, plainLexer, plain, results);
+	CheckEvents(source, plainLexer, plain, results);
+	CheckLexFile(source, plainLexer, results);
+	CheckCache(source, plainLexer, plain, results);
+	CheckGrammarFile(source, plainLexer, plain, results);
+	CheckInvalidRegexes(results);
+	CheckGrammarCompiler(source, plainLexer, results);
+	CheckOptimizer(source, plainLexer, plain, results);
+	CheckFirstChoice(source, plainLexer, plain, results);
+	CheckNamedGroups(results);
+	return results;
+}
\ No newline at end of file
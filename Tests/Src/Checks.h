@@ -0,0 +1,17 @@
+#pragma once
+
+#include <CommonLexer/Source.h>
+
+#include <string>
+#include <vector>
+
+struct CheckResult
+{
+public:
+	std::string m_Name;
+	// Empty when the check passed, otherwise the first difference to the expected lex
+	std::string m_Failure;
+};
+
+// Lexes source with every feature of the lexer and compares each result against a plain lex without memoization, optimizations or splitting
+std::vector<CheckResult> RunChecks(CommonLexer::ISource* source);
\ No newline at end of file
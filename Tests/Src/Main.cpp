@@ -1,3 +1,5 @@
+#include "Checks.h"
+
 #include <CommonCLI/Colors.h>
 #include <CommonCLI/Core.h>
 #include <CommonCLI/KeyValue/KVHandler.h>
@@ -12,7 +14,6 @@
 #include <fmt/format.h>
 
 #include <chrono>
-#include <fstream>
 #include <iostream>
 #include <regex>
 #include <sstream>
@@ -45,7 +46,7 @@ std::string EscapeString(const std::string& str)
 	return std::regex_replace(str, std::regex { "\"" }, "\\\"");
 }
 
-void PrintMessage(const CommonLexer::Message& message, CommonLexer::ISource* source)
+void PrintMessage(const CommonLexer::Message& message, CommonLexer::ISource* source, const CommonLexer::SourceLocation* locations)
 {
 	std::ostringstream str;
 	switch (message.getSeverity())
@@ -57,18 +58,17 @@ void PrintMessage(const CommonLexer::Message& message, CommonLexer::ISource* sou
 		str << CommonCLI::Colors::Error << "CommonLexer Error ";
 		break;
 	}
-	auto point       = message.getPoint();
-	auto pointLine   = point.getLine(source);
-	auto pointColumn = point.getColumn(source);
+	auto pointLine   = locations[0].m_Line;
+	auto pointColumn = locations[0].m_Column;
 	str << '(' << pointLine << ':' << pointColumn << "): ";
 	str << message.getMessage() << ANSI::GraphicsForegroundDefault << '\n';
 
 	auto span        = message.getSpan();
 	auto lines       = source->getLines(span);
-	auto beginLine   = span.m_Start.getLine(source);
-	auto beginColumn = span.m_Start.getColumn(source);
-	auto endLine     = span.m_End.getLine(source);
-	auto endColumn   = span.m_End.getColumn(source);
+	auto beginLine   = locations[1].m_Line;
+	auto beginColumn = locations[1].m_Column;
+	auto endLine     = locations[2].m_Line;
+	auto endColumn   = locations[2].m_Column;
 	for (std::size_t i = 0; i < lines.size(); ++i)
 	{
 		std::string ln   = std::to_string(beginLine + i) + ": ";
@@ -112,7 +112,24 @@ void PrintMessage(const CommonLexer::Message& message, CommonLexer::ISource* sou
 	std::cout << str.str();
 }
 
-void PrintLexNode(const CommonLexer::Node& node, std::vector<std::vector<std::string>>& lines, std::vector<bool>& layers, bool end = true)
+void PrintMessages(const std::vector<CommonLexer::Message>& messages, CommonLexer::ISource* source)
+{
+	std::vector<CommonLexer::SourcePoint> points;
+	points.reserve(messages.size() * 3);
+	for (auto& message : messages)
+	{
+		auto span = message.getSpan();
+		points.push_back(message.getPoint());
+		points.push_back(span.m_Start);
+		points.push_back(span.m_End);
+	}
+
+	auto locations = source->resolveLocations(points);
+	for (std::size_t i = 0; i < messages.size(); ++i)
+		PrintMessage(messages[i], source, &locations[i * 3]);
+}
+
+void PrintLexNode(const CommonLexer::Node& node, const std::vector<CommonLexer::NodeLocation>& locations, std::size_t& index, std::vector<std::vector<std::string>>& lines, std::vector<bool>& layers, bool end = true)
 {
 	{
 		std::vector<std::string> line;
@@ -138,10 +155,11 @@ void PrintLexNode(const CommonLexer::Node& node, std::vector<std::vector<std::st
 		line.push_back(str.str());
 		str = {};
 
-		auto beginLine   = span.m_Start.getLine(node.getLex().getSource());
-		auto beginColumn = span.m_Start.getColumn(node.getLex().getSource());
-		auto endLine     = span.m_End.getLine(node.getLex().getSource());
-		auto endColumn   = span.m_End.getColumn(node.getLex().getSource());
+		auto& location    = locations[index++];
+		auto  beginLine   = location.m_Start.m_Line;
+		auto  beginColumn = location.m_Start.m_Column;
+		auto  endLine     = location.m_End.m_Line;
+		auto  endColumn   = location.m_End.m_Column;
 		str << '(' << beginLine << ':' << beginColumn << " -> " << endLine << ':' << endColumn << ')';
 		line.push_back(str.str());
 		str = {};
@@ -160,7 +178,7 @@ void PrintLexNode(const CommonLexer::Node& node, std::vector<std::vector<std::st
 
 	auto& children = node.getChildren();
 	for (std::size_t i = 0; i < children.size(); ++i)
-		PrintLexNode(children[i], lines, layers, i >= children.size() - 1);
+		PrintLexNode(children[i], locations, index, lines, layers, i >= children.size() - 1);
 
 	layers.pop_back();
 }
@@ -169,7 +187,9 @@ void PrintLex(const CommonLexer::Lex& lex)
 {
 	std::vector<std::vector<std::string>> lines;
 	std::vector<bool>                     layers;
-	PrintLexNode(lex.getRoot(), lines, layers);
+	auto                                  locations = lex.resolveNodeLocations();
+	std::size_t                           index     = 0;
+	PrintLexNode(lex.getRoot(), locations, index, lines, layers);
 
 	std::vector<std::size_t> sizes;
 	for (auto& line : lines)
@@ -224,16 +244,12 @@ int main(int argc, char** argv)
 	if (exit)
 		return 1;
 
-	std::ifstream stream { "CommonLexer.grammar", std::ios::ate };
-	std::string   str;
-	if (stream)
+	CommonLexer::MappedFileSource source { "CommonLexer.grammar" };
+	if (!source.isOpen())
 	{
-		str.resize(stream.tellg());
-		stream.seekg(0);
-		stream.read(str.data(), str.size());
-		stream.close();
+		std::cerr << "Failed to open 'CommonLexer.grammar'\n";
+		return 1;
 	}
-	CommonLexer::StringSource source { std::move(str) };
 
 	GrammarLexer::GrammarLexer lexer;
 
@@ -241,10 +257,25 @@ int main(int argc, char** argv)
 	auto lex   = lexer.lexSource(&source);
 	auto end   = std::chrono::high_resolution_clock::now();
 	if (!lex.getMessages().empty())
-		for (auto& message : lex.getMessages())
-			PrintMessage(message, &source);
+		PrintMessages(lex.getMessages(), &source);
 
 	PrintLex(lex);
 
 	std::cout << fmt::format("\nTime: {}\n", std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(end - start));
+
+	std::cout << '\n';
+	std::size_t failed = 0;
+	for (auto& check : RunChecks(&source))
+	{
+		if (check.m_Failure.empty())
+		{
+			std::cout << CommonCLI::Colors::Note << "Passed " << check.m_Name << ANSI::GraphicsForegroundDefault << '\n';
+		}
+		else
+		{
+			std::cout << CommonCLI::Colors::Error << "Failed " << check.m_Name << ": " << check.m_Failure << ANSI::GraphicsForegroundDefault << '\n';
+			++failed;
+		}
+	}
+	return failed > 0 ? 1 : 0;
 }
\ No newline at end of file